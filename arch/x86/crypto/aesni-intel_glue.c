@@ -791,6 +791,11 @@ static int generic_gcmaes_set_authsize(struct crypto_aead *tfm,
 	return 0;
 }
 
+/*
+ * The gcmaes_* helpers below must be called between kernel_fpu_begin() and
+ * kernel_fpu_end(), so that a batch of requests only pays for saving and
+ * restoring the FPU state once.
+ */
 static int gcmaes_crypt_by_sg(bool enc, struct aead_request *req,
 			      unsigned int assoclen, u8 *hash_subkey,
 			      u8 *iv, void *aes_ctx)
@@ -837,7 +842,6 @@ static int gcmaes_crypt_by_sg(bool enc, struct aead_request *req,
 		scatterwalk_start(&dst_sg_walk, dst_sg);
 	}
 
-	kernel_fpu_begin();
 	aesni_gcm_init(aes_ctx, &data, iv,
 		hash_subkey, assoc, assoclen);
 	if (req->src != req->dst) {
@@ -883,7 +887,6 @@ static int gcmaes_crypt_by_sg(bool enc, struct aead_request *req,
 		}
 	}
 	aesni_gcm_finalize(aes_ctx, &data, authTag, auth_tag_len);
-	kernel_fpu_end();
 
 	if (!assocmem)
 		scatterwalk_unmap(assoc);
@@ -956,11 +959,9 @@ static int gcmaes_encrypt(struct aead_request *req, unsigned int assoclen,
 		dst = src;
 	}
 
-	kernel_fpu_begin();
 	aesni_gcm_enc_tfm(aes_ctx, &data, dst, src, req->cryptlen, iv,
 			  hash_subkey, assoc, assoclen,
 			  dst + req->cryptlen, auth_tag_len);
-	kernel_fpu_end();
 
 	/* The authTag (aka the Integrity Check Value) needs to be written
 	 * back to the packet. */
@@ -1030,11 +1031,9 @@ static int gcmaes_decrypt(struct aead_request *req, unsigned int assoclen,
 	}
 
 
-	kernel_fpu_begin();
 	aesni_gcm_dec_tfm(aes_ctx, &data, dst, src, tempCipherLen, iv,
 			  hash_subkey, assoc, assoclen,
 			  authTag, auth_tag_len);
-	kernel_fpu_end();
 
 	/* Compare generated tag with passed in tag. */
 	retval = crypto_memneq(src + tempCipherLen, authTag, auth_tag_len) ?
@@ -1058,7 +1057,7 @@ static int gcmaes_decrypt(struct aead_request *req, unsigned int assoclen,
 
 }
 
-static int helper_rfc4106_encrypt(struct aead_request *req)
+static int __helper_rfc4106_encrypt(struct aead_request *req)
 {
 	struct crypto_aead *tfm = crypto_aead_reqtfm(req);
 	struct aesni_rfc4106_gcm_ctx *ctx = aesni_rfc4106_gcm_ctx_get(tfm);
@@ -1084,7 +1083,7 @@ static int helper_rfc4106_encrypt(struct aead_request *req)
 			      aes_ctx);
 }
 
-static int helper_rfc4106_decrypt(struct aead_request *req)
+static int __helper_rfc4106_decrypt(struct aead_request *req)
 {
 	__be32 counter = cpu_to_be32(1);
 	struct crypto_aead *tfm = crypto_aead_reqtfm(req);
@@ -1111,6 +1110,65 @@ static int helper_rfc4106_decrypt(struct aead_request *req)
 			      aes_ctx);
 }
 
+static int gcmaes_crypt_fpu(int (*crypt)(struct aead_request *req),
+			    struct aead_request *req)
+{
+	int ret;
+
+	kernel_fpu_begin();
+	ret = crypt(req);
+	kernel_fpu_end();
+
+	return ret;
+}
+
+/*
+ * Bound the time spent with preemption disabled when a batch carries a lot
+ * of data: the FPU is released and taken again after this many bytes.
+ */
+#define GCMAES_BATCH_FPU_BYTES	(64 * 1024)
+
+static void gcmaes_crypt_batch(int (*crypt)(struct aead_request *req),
+			       struct aead_request **reqs, int *err,
+			       unsigned int nreqs)
+{
+	unsigned int i, bytes = 0;
+
+	kernel_fpu_begin();
+	for (i = 0; i < nreqs; i++) {
+		if (bytes >= GCMAES_BATCH_FPU_BYTES) {
+			kernel_fpu_end();
+			kernel_fpu_begin();
+			bytes = 0;
+		}
+		err[i] = crypt(reqs[i]);
+		bytes += reqs[i]->cryptlen;
+	}
+	kernel_fpu_end();
+}
+
+static int helper_rfc4106_encrypt(struct aead_request *req)
+{
+	return gcmaes_crypt_fpu(__helper_rfc4106_encrypt, req);
+}
+
+static int helper_rfc4106_decrypt(struct aead_request *req)
+{
+	return gcmaes_crypt_fpu(__helper_rfc4106_decrypt, req);
+}
+
+static void helper_rfc4106_encrypt_batch(struct aead_request **reqs, int *err,
+					 unsigned int nreqs)
+{
+	gcmaes_crypt_batch(__helper_rfc4106_encrypt, reqs, err, nreqs);
+}
+
+static void helper_rfc4106_decrypt_batch(struct aead_request **reqs, int *err,
+					 unsigned int nreqs)
+{
+	gcmaes_crypt_batch(__helper_rfc4106_decrypt, reqs, err, nreqs);
+}
+
 static int gcmaes_wrapper_encrypt(struct aead_request *req)
 {
 	struct crypto_aead *tfm = crypto_aead_reqtfm(req);
@@ -1142,6 +1200,57 @@ static int gcmaes_wrapper_decrypt(struct aead_request *req)
 
 	return crypto_aead_decrypt(req);
 }
+
+/*
+ * All requests of a batch go either to the internal implementation, which
+ * then holds the FPU across the whole batch, or through cryptd.
+ */
+static struct crypto_aead *gcmaes_wrapper_batch_tfm(struct aead_request **reqs,
+						     unsigned int nreqs)
+{
+	struct crypto_aead *tfm = crypto_aead_reqtfm(reqs[0]);
+	struct cryptd_aead **ctx = crypto_aead_ctx(tfm);
+	struct cryptd_aead *cryptd_tfm = *ctx;
+	unsigned int i;
+
+	tfm = &cryptd_tfm->base;
+	if (irq_fpu_usable() && (!in_atomic() ||
+				 !cryptd_aead_queued(cryptd_tfm)))
+		tfm = cryptd_aead_child(cryptd_tfm);
+
+	for (i = 0; i < nreqs; i++)
+		aead_request_set_tfm(reqs[i], tfm);
+
+	return tfm;
+}
+
+static void gcmaes_wrapper_encrypt_batch(struct aead_request **reqs, int *err,
+					 unsigned int nreqs)
+{
+	unsigned int i;
+	int ret;
+
+	gcmaes_wrapper_batch_tfm(reqs, nreqs);
+
+	ret = crypto_aead_encrypt_batch(reqs, err, nreqs);
+	if (ret)
+		for (i = 0; i < nreqs; i++)
+			err[i] = ret;
+}
+
+static void gcmaes_wrapper_decrypt_batch(struct aead_request **reqs, int *err,
+					 unsigned int nreqs)
+{
+	unsigned int i;
+	int ret;
+
+	gcmaes_wrapper_batch_tfm(reqs, nreqs);
+
+	ret = crypto_aead_decrypt_batch(reqs, err, nreqs);
+	if (ret)
+		for (i = 0; i < nreqs; i++)
+			err[i] = ret;
+}
 #endif
 
 static struct crypto_alg aesni_algs[] = { {
@@ -1280,7 +1389,7 @@ static int generic_gcmaes_set_key(struct crypto_aead *aead, const u8 *key,
 	       rfc4106_set_hash_subkey(ctx->hash_subkey, key, key_len);
 }
 
-static int generic_gcmaes_encrypt(struct aead_request *req)
+static int __generic_gcmaes_encrypt(struct aead_request *req)
 {
 	struct crypto_aead *tfm = crypto_aead_reqtfm(req);
 	struct generic_gcmaes_ctx *ctx = generic_gcmaes_ctx_get(tfm);
@@ -1295,7 +1404,7 @@ static int generic_gcmaes_encrypt(struct aead_request *req)
 			      aes_ctx);
 }
 
-static int generic_gcmaes_decrypt(struct aead_request *req)
+static int __generic_gcmaes_decrypt(struct aead_request *req)
 {
 	__be32 counter = cpu_to_be32(1);
 	struct crypto_aead *tfm = crypto_aead_reqtfm(req);
@@ -1310,6 +1419,28 @@ static int generic_gcmaes_decrypt(struct aead_request *req)
 			      aes_ctx);
 }
 
+static int generic_gcmaes_encrypt(struct aead_request *req)
+{
+	return gcmaes_crypt_fpu(__generic_gcmaes_encrypt, req);
+}
+
+static int generic_gcmaes_decrypt(struct aead_request *req)
+{
+	return gcmaes_crypt_fpu(__generic_gcmaes_decrypt, req);
+}
+
+static void generic_gcmaes_encrypt_batch(struct aead_request **reqs, int *err,
+					 unsigned int nreqs)
+{
+	gcmaes_crypt_batch(__generic_gcmaes_encrypt, reqs, err, nreqs);
+}
+
+static void generic_gcmaes_decrypt_batch(struct aead_request **reqs, int *err,
+					 unsigned int nreqs)
+{
+	gcmaes_crypt_batch(__generic_gcmaes_decrypt, reqs, err, nreqs);
+}
+
 static int generic_gcmaes_init(struct crypto_aead *aead)
 {
 	struct cryptd_aead *cryptd_tfm;
@@ -1339,6 +1470,8 @@ static struct aead_alg aesni_aead_algs[] = { {
 	.setauthsize		= common_rfc4106_set_authsize,
 	.encrypt		= helper_rfc4106_encrypt,
 	.decrypt		= helper_rfc4106_decrypt,
+	.encrypt_batch		= helper_rfc4106_encrypt_batch,
+	.decrypt_batch		= helper_rfc4106_decrypt_batch,
 	.ivsize			= GCM_RFC4106_IV_SIZE,
 	.maxauthsize		= 16,
 	.base = {
@@ -1357,6 +1490,8 @@ static struct aead_alg aesni_aead_algs[] = { {
 	.setauthsize		= gcmaes_wrapper_set_authsize,
 	.encrypt		= gcmaes_wrapper_encrypt,
 	.decrypt		= gcmaes_wrapper_decrypt,
+	.encrypt_batch		= gcmaes_wrapper_encrypt_batch,
+	.decrypt_batch		= gcmaes_wrapper_decrypt_batch,
 	.ivsize			= GCM_RFC4106_IV_SIZE,
 	.maxauthsize		= 16,
 	.base = {
@@ -1373,6 +1508,8 @@ static struct aead_alg aesni_aead_algs[] = { {
 	.setauthsize		= generic_gcmaes_set_authsize,
 	.encrypt		= generic_gcmaes_encrypt,
 	.decrypt		= generic_gcmaes_decrypt,
+	.encrypt_batch		= generic_gcmaes_encrypt_batch,
+	.decrypt_batch		= generic_gcmaes_decrypt_batch,
 	.ivsize			= GCM_AES_IV_SIZE,
 	.maxauthsize		= 16,
 	.base = {
@@ -1392,6 +1529,8 @@ static struct aead_alg aesni_aead_algs[] = { {
 	.setauthsize		= gcmaes_wrapper_set_authsize,
 	.encrypt		= gcmaes_wrapper_encrypt,
 	.decrypt		= gcmaes_wrapper_decrypt,
+	.encrypt_batch		= gcmaes_wrapper_encrypt_batch,
+	.decrypt_batch		= gcmaes_wrapper_decrypt_batch,
 	.ivsize			= GCM_AES_IV_SIZE,
 	.maxauthsize		= 16,
 	.base = {
@@ -87,6 +87,95 @@ int crypto_aead_setauthsize(struct crypto_aead *tfm, unsigned int authsize)
 }
 EXPORT_SYMBOL_GPL(crypto_aead_setauthsize);
 
+static int crypto_aead_check_batch(struct aead_request **reqs,
+				   unsigned int nreqs)
+{
+	struct crypto_aead *aead;
+	unsigned int i;
+
+	if (!nreqs)
+		return 0;
+
+	aead = crypto_aead_reqtfm(reqs[0]);
+	for (i = 1; i < nreqs; i++)
+		if (crypto_aead_reqtfm(reqs[i]) != aead)
+			return -EINVAL;
+
+	if (crypto_aead_get_flags(aead) & CRYPTO_TFM_NEED_KEY)
+		return -ENOKEY;
+
+	return 0;
+}
+
+int crypto_aead_encrypt_batch(struct aead_request **reqs, int *err,
+			      unsigned int nreqs)
+{
+	struct aead_alg *alg;
+	unsigned int i;
+	int ret;
+
+	ret = crypto_aead_check_batch(reqs, nreqs);
+	if (ret || !nreqs)
+		return ret;
+
+	alg = crypto_aead_alg(crypto_aead_reqtfm(reqs[0]));
+	if (alg->encrypt_batch) {
+		alg->encrypt_batch(reqs, err, nreqs);
+		return 0;
+	}
+
+	for (i = 0; i < nreqs; i++)
+		err[i] = alg->encrypt(reqs[i]);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(crypto_aead_encrypt_batch);
+
+int crypto_aead_decrypt_batch(struct aead_request **reqs, int *err,
+			      unsigned int nreqs)
+{
+	struct crypto_aead *aead;
+	struct aead_alg *alg;
+	unsigned int i, n;
+	int ret;
+
+	ret = crypto_aead_check_batch(reqs, nreqs);
+	if (ret || !nreqs)
+		return ret;
+
+	aead = crypto_aead_reqtfm(reqs[0]);
+	alg = crypto_aead_alg(aead);
+
+	/*
+	 * Requests too short to carry a tag are failed here, so that the
+	 * algorithm only ever sees well-formed ones. Runs of valid requests
+	 * are handed to the algorithm together.
+	 */
+	for (i = 0; i < nreqs; i += n) {
+		if (reqs[i]->cryptlen < crypto_aead_authsize(aead)) {
+			err[i] = -EINVAL;
+			n = 1;
+			continue;
+		}
+
+		for (n = 1; i + n < nreqs; n++)
+			if (reqs[i + n]->cryptlen < crypto_aead_authsize(aead))
+				break;
+
+		if (alg->decrypt_batch) {
+			alg->decrypt_batch(reqs + i, err + i, n);
+		} else {
+			unsigned int j;
+
+			for (j = i; j < i + n; j++)
+				err[j] = alg->decrypt(reqs[j]);
+		}
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(crypto_aead_decrypt_batch);
+
 static void crypto_aead_exit_tfm(struct crypto_tfm *tfm)
 {
 	struct crypto_aead *aead = __crypto_aead_cast(tfm);
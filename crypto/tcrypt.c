@@ -158,16 +158,28 @@ struct test_mb_aead_data {
 };
 
 static int do_mult_aead_op(struct test_mb_aead_data *data, int enc,
-				u32 num_mb, int *rc)
+				u32 num_mb, int *rc, struct aead_request **reqs)
 {
 	int i, err = 0;
 
-	/* Fire up a bunch of concurrent requests */
-	for (i = 0; i < num_mb; i++) {
+	/* Fire up a bunch of concurrent requests, in one call if batched */
+	if (reqs) {
 		if (enc == ENCRYPT)
-			rc[i] = crypto_aead_encrypt(data[i].req);
+			err = crypto_aead_encrypt_batch(reqs, rc, num_mb);
 		else
-			rc[i] = crypto_aead_decrypt(data[i].req);
+			err = crypto_aead_decrypt_batch(reqs, rc, num_mb);
+
+		if (err) {
+			pr_info("batched submission error %d\n", err);
+			return err;
+		}
+	} else {
+		for (i = 0; i < num_mb; i++) {
+			if (enc == ENCRYPT)
+				rc[i] = crypto_aead_encrypt(data[i].req);
+			else
+				rc[i] = crypto_aead_decrypt(data[i].req);
+		}
 	}
 
 	/* Wait for all requests to finish */
@@ -184,7 +196,8 @@ static int do_mult_aead_op(struct test_mb_aead_data *data, int enc,
 }
 
 static int test_mb_aead_jiffies(struct test_mb_aead_data *data, int enc,
-				int blen, int secs, u32 num_mb)
+				int blen, int secs, u32 num_mb,
+				struct aead_request **reqs)
 {
 	unsigned long start, end;
 	int bcount;
@@ -197,7 +210,7 @@ static int test_mb_aead_jiffies(struct test_mb_aead_data *data, int enc,
 
 	for (start = jiffies, end = start + secs * HZ, bcount = 0;
 	     time_before(jiffies, end); bcount++) {
-		ret = do_mult_aead_op(data, enc, num_mb, rc);
+		ret = do_mult_aead_op(data, enc, num_mb, rc, reqs);
 		if (ret)
 			goto out;
 	}
@@ -211,7 +224,7 @@ out:
 }
 
 static int test_mb_aead_cycles(struct test_mb_aead_data *data, int enc,
-			       int blen, u32 num_mb)
+			       int blen, u32 num_mb, struct aead_request **reqs)
 {
 	unsigned long cycles = 0;
 	int ret = 0;
@@ -224,7 +237,7 @@ static int test_mb_aead_cycles(struct test_mb_aead_data *data, int enc,
 
 	/* Warm-up run. */
 	for (i = 0; i < 4; i++) {
-		ret = do_mult_aead_op(data, enc, num_mb, rc);
+		ret = do_mult_aead_op(data, enc, num_mb, rc, reqs);
 		if (ret)
 			goto out;
 	}
@@ -234,7 +247,7 @@ static int test_mb_aead_cycles(struct test_mb_aead_data *data, int enc,
 		cycles_t start, end;
 
 		start = get_cycles();
-		ret = do_mult_aead_op(data, enc, num_mb, rc);
+		ret = do_mult_aead_op(data, enc, num_mb, rc, reqs);
 		end = get_cycles();
 
 		if (ret)
@@ -254,9 +267,11 @@ out:
 static void test_mb_aead_speed(const char *algo, int enc, int secs,
 			       struct aead_speed_template *template,
 			       unsigned int tcount, u8 authsize,
-			       unsigned int aad_size, u8 *keysize, u32 num_mb)
+			       unsigned int aad_size, u8 *keysize, u32 num_mb,
+			       bool batch)
 {
 	struct test_mb_aead_data *data;
+	struct aead_request **reqs = NULL;
 	struct crypto_aead *tfm;
 	unsigned int i, j, iv_len;
 	const char *key;
@@ -285,6 +300,12 @@ static void test_mb_aead_speed(const char *algo, int enc, int secs,
 	if (!data)
 		goto out_free_iv;
 
+	if (batch) {
+		reqs = kcalloc(num_mb, sizeof(*reqs), GFP_KERNEL);
+		if (!reqs)
+			goto out_free_data;
+	}
+
 	tfm = crypto_alloc_aead(algo, 0, 0);
 	if (IS_ERR(tfm)) {
 		pr_err("failed to load transform for %s: %ld\n",
@@ -324,6 +345,8 @@ static void test_mb_aead_speed(const char *algo, int enc, int secs,
 				aead_request_free(data[i].req);
 			goto out_free_xoutbuf;
 		}
+		if (reqs)
+			reqs[i] = data[i].req;
 	}
 
 	for (i = 0; i < num_mb; ++i) {
@@ -333,7 +356,8 @@ static void test_mb_aead_speed(const char *algo, int enc, int secs,
 					  crypto_req_done, &data[i].wait);
 	}
 
-	pr_info("\ntesting speed of multibuffer %s (%s) %s\n", algo,
+	pr_info("\ntesting speed of %s %s (%s) %s\n",
+		batch ? "batched" : "multibuffer", algo,
 		get_driver_name(crypto_aead, tfm), e);
 
 	i = 0;
@@ -417,10 +441,10 @@ static void test_mb_aead_speed(const char *algo, int enc, int secs,
 
 			if (secs)
 				ret = test_mb_aead_jiffies(data, enc, *b_size,
-							   secs, num_mb);
+							   secs, num_mb, reqs);
 			else
 				ret = test_mb_aead_cycles(data, enc, *b_size,
-							  num_mb);
+							  num_mb, reqs);
 
 			if (ret) {
 				pr_err("%s() failed return code=%d\n", e, ret);
@@ -447,6 +471,7 @@ out_free_xbuf:
 out_free_tfm:
 	crypto_free_aead(tfm);
 out_free_data:
+	kfree(reqs);
 	kfree(data);
 out_free_iv:
 	kfree(iv);
@@ -2245,29 +2270,64 @@ static int do_test(const char *alg, u32 type, u32 mask, int m, u32 num_mb)
 
 	case 215:
 		test_mb_aead_speed("rfc4106(gcm(aes))", ENCRYPT, sec, NULL,
-				   0, 16, 16, aead_speed_template_20, num_mb);
+				   0, 16, 16, aead_speed_template_20, num_mb,
+				   false);
 		test_mb_aead_speed("gcm(aes)", ENCRYPT, sec, NULL, 0, 16, 8,
-				   speed_template_16_24_32, num_mb);
+				   speed_template_16_24_32, num_mb, false);
 		test_mb_aead_speed("rfc4106(gcm(aes))", DECRYPT, sec, NULL,
-				   0, 16, 16, aead_speed_template_20, num_mb);
+				   0, 16, 16, aead_speed_template_20, num_mb,
+				   false);
 		test_mb_aead_speed("gcm(aes)", DECRYPT, sec, NULL, 0, 16, 8,
-				   speed_template_16_24_32, num_mb);
+				   speed_template_16_24_32, num_mb, false);
 		break;
 
 	case 216:
 		test_mb_aead_speed("rfc4309(ccm(aes))", ENCRYPT, sec, NULL, 0,
-				   16, 16, aead_speed_template_19, num_mb);
+				   16, 16, aead_speed_template_19, num_mb,
+				   false);
 		test_mb_aead_speed("rfc4309(ccm(aes))", DECRYPT, sec, NULL, 0,
-				   16, 16, aead_speed_template_19, num_mb);
+				   16, 16, aead_speed_template_19, num_mb,
+				   false);
 		break;
 
 	case 217:
 		test_mb_aead_speed("rfc7539esp(chacha20,poly1305)", ENCRYPT,
 				   sec, NULL, 0, 16, 8, aead_speed_template_36,
-				   num_mb);
+				   num_mb, false);
+		test_mb_aead_speed("rfc7539esp(chacha20,poly1305)", DECRYPT,
+				   sec, NULL, 0, 16, 8, aead_speed_template_36,
+				   num_mb, false);
+		break;
+
+	case 218:
+		test_mb_aead_speed("rfc4106(gcm(aes))", ENCRYPT, sec, NULL,
+				   0, 16, 16, aead_speed_template_20, num_mb,
+				   true);
+		test_mb_aead_speed("gcm(aes)", ENCRYPT, sec, NULL, 0, 16, 8,
+				   speed_template_16_24_32, num_mb, true);
+		test_mb_aead_speed("rfc4106(gcm(aes))", DECRYPT, sec, NULL,
+				   0, 16, 16, aead_speed_template_20, num_mb,
+				   true);
+		test_mb_aead_speed("gcm(aes)", DECRYPT, sec, NULL, 0, 16, 8,
+				   speed_template_16_24_32, num_mb, true);
+		break;
+
+	case 219:
+		test_mb_aead_speed("rfc4309(ccm(aes))", ENCRYPT, sec, NULL, 0,
+				   16, 16, aead_speed_template_19, num_mb,
+				   true);
+		test_mb_aead_speed("rfc4309(ccm(aes))", DECRYPT, sec, NULL, 0,
+				   16, 16, aead_speed_template_19, num_mb,
+				   true);
+		break;
+
+	case 220:
+		test_mb_aead_speed("rfc7539esp(chacha20,poly1305)", ENCRYPT,
+				   sec, NULL, 0, 16, 8, aead_speed_template_36,
+				   num_mb, true);
 		test_mb_aead_speed("rfc7539esp(chacha20,poly1305)", DECRYPT,
 				   sec, NULL, 0, 16, 8, aead_speed_template_36,
-				   num_mb);
+				   num_mb, true);
 		break;
 
 	case 300:
@@ -1977,6 +1977,26 @@ static blk_status_t btrfs_submit_bio_done(void *private_data, struct bio *bio,
 	return ret;
 }
 
+/*
+ * Data writes up to this size are checksummed at submission when crc32c is
+ * accelerated, which is quicker than the round trip through the workers.
+ * The checksumming itself is the same per-sector crc32c either way, only
+ * the context it runs in differs.
+ */
+#define BTRFS_INLINE_CSUM_MAX		SZ_64K
+
+static bool btrfs_async_csum(struct btrfs_inode *bi, struct bio *bio)
+{
+	struct btrfs_fs_info *fs_info = bi->root->fs_info;
+
+	if (atomic_read(&bi->sync_writers))
+		return false;
+	if (test_bit(BTRFS_FS_CSUM_IMPL_FAST, &fs_info->flags) &&
+	    bio->bi_iter.bi_size <= BTRFS_INLINE_CSUM_MAX)
+		return false;
+	return true;
+}
+
 /*
  * extent_io.c submission hook. This does the right thing for csum calculation
  * on write, or reading the csums from the tree before a read.
@@ -1993,7 +2013,11 @@ static blk_status_t btrfs_submit_bio_done(void *private_data, struct bio *bio,
  *    c-2) if root is reloc root:	sync submit
  *         (only in case of buffered IO)
  *
- *    c-3) otherwise:			async submit
+ *    c-3) if bio is small and crc32c	sync submit
+ *         is accelerated:
+ *         (BTRFS_INLINE_CSUM_MAX)
+ *
+ *    c-4) otherwise:			async submit
  */
 static blk_status_t btrfs_submit_bio_hook(void *private_data, struct bio *bio,
 				 int mirror_num, unsigned long bio_flags,
@@ -2005,7 +2029,7 @@ static blk_status_t btrfs_submit_bio_hook(void *private_data, struct bio *bio,
 	enum btrfs_wq_endio_type metadata = BTRFS_WQ_ENDIO_DATA;
 	blk_status_t ret = 0;
 	int skip_sum;
-	int async = !atomic_read(&BTRFS_I(inode)->sync_writers);
+	int async = btrfs_async_csum(BTRFS_I(inode), bio);
 
 	skip_sum = BTRFS_I(inode)->flags & BTRFS_INODE_NODATASUM;
 
@@ -8259,7 +8283,7 @@ static inline blk_status_t btrfs_submit_dio_bio(struct bio *bio,
 
 	/* Check btrfs_submit_bio_hook() for rules about async submit. */
 	if (async_submit)
-		async_submit = !atomic_read(&BTRFS_I(inode)->sync_writers);
+		async_submit = btrfs_async_csum(BTRFS_I(inode), bio);
 
 	if (!write) {
 		ret = btrfs_bio_wq_end_io(fs_info, bio, BTRFS_WQ_ENDIO_DATA);
@@ -5,93 +5,53 @@
 
 #include <linux/sched.h>
 #include <linux/pagemap.h>
-#include <linux/spinlock.h>
+#include <linux/rwsem.h>
 #include <linux/page-flags.h>
 #include <asm/bug.h>
 #include "ctree.h"
 #include "extent_io.h"
 #include "locking.h"
 
+/*
+ * Extent buffer locking
+ *
+ * The tree locks are plain rw_semaphores.  Writers spin on the owner while
+ * it is running and queued readers are woken as a batch, so a lock that is
+ * only held for a few instructions costs about as much as the rwlock we
+ * used to take in "spinning" mode, while a holder that needs to sleep (to
+ * read a block, allocate memory or wait for a transaction) no longer has to
+ * hand over to the separate blocking counters and wait queues first.  The
+ * blocking helpers are kept as no-ops for now, so callers can keep their
+ * annotations of the places that may sleep.
+ *
+ * Going through the semaphore makes every tree lock visible to lockdep and
+ * to /proc/lock_stat under the per-tree, per-level classes set up by
+ * btrfs_set_buffer_lockdep_class().  Callers that lock another buffer of
+ * the same level, like a sibling or the result of a COW, pass the matching
+ * enum btrfs_lock_nesting so lockdep can tell the two apart.
+ */
+
 static void btrfs_assert_tree_read_locked(struct extent_buffer *eb);
 
 /*
- * if we currently have a spinning reader or writer lock
- * (indicated by the rw flag) this will bump the count
- * of blocking holders and drop the spinlock.
+ * The tree locks can be held while sleeping, so there is nothing to do to
+ * go from spinning to blocking or back.
  */
 void btrfs_set_lock_blocking_rw(struct extent_buffer *eb, int rw)
 {
-	/*
-	 * no lock is required.  The lock owner may change if
-	 * we have a read lock, but it won't change to or away
-	 * from us.  If we have the write lock, we are the owner
-	 * and it'll never change.
-	 */
-	if (eb->lock_nested && current->pid == eb->lock_owner)
-		return;
-	if (rw == BTRFS_WRITE_LOCK) {
-		if (atomic_read(&eb->blocking_writers) == 0) {
-			WARN_ON(atomic_read(&eb->spinning_writers) != 1);
-			atomic_dec(&eb->spinning_writers);
-			btrfs_assert_tree_locked(eb);
-			atomic_inc(&eb->blocking_writers);
-			write_unlock(&eb->lock);
-		}
-	} else if (rw == BTRFS_READ_LOCK) {
-		btrfs_assert_tree_read_locked(eb);
-		atomic_inc(&eb->blocking_readers);
-		WARN_ON(atomic_read(&eb->spinning_readers) == 0);
-		atomic_dec(&eb->spinning_readers);
-		read_unlock(&eb->lock);
-	}
 }
 
-/*
- * if we currently have a blocking lock, take the spinlock
- * and drop our blocking count
- */
 void btrfs_clear_lock_blocking_rw(struct extent_buffer *eb, int rw)
 {
-	/*
-	 * no lock is required.  The lock owner may change if
-	 * we have a read lock, but it won't change to or away
-	 * from us.  If we have the write lock, we are the owner
-	 * and it'll never change.
-	 */
-	if (eb->lock_nested && current->pid == eb->lock_owner)
-		return;
-
-	if (rw == BTRFS_WRITE_LOCK_BLOCKING) {
-		BUG_ON(atomic_read(&eb->blocking_writers) != 1);
-		write_lock(&eb->lock);
-		WARN_ON(atomic_read(&eb->spinning_writers));
-		atomic_inc(&eb->spinning_writers);
-		/* atomic_dec_and_test implies a barrier */
-		if (atomic_dec_and_test(&eb->blocking_writers))
-			cond_wake_up_nomb(&eb->write_lock_wq);
-	} else if (rw == BTRFS_READ_LOCK_BLOCKING) {
-		BUG_ON(atomic_read(&eb->blocking_readers) == 0);
-		read_lock(&eb->lock);
-		atomic_inc(&eb->spinning_readers);
-		/* atomic_dec_and_test implies a barrier */
-		if (atomic_dec_and_test(&eb->blocking_readers))
-			cond_wake_up_nomb(&eb->read_lock_wq);
-	}
 }
 
 /*
- * take a spinning read lock.  This will wait for any blocking
- * writers
+ * take a read lock, waiting for the writer if there is one
  */
-void btrfs_tree_read_lock(struct extent_buffer *eb)
+void btrfs_tree_read_lock_nested(struct extent_buffer *eb,
+				 enum btrfs_lock_nesting nest)
 {
-again:
-	BUG_ON(!atomic_read(&eb->blocking_writers) &&
-	       current->pid == eb->lock_owner);
-
-	read_lock(&eb->lock);
-	if (atomic_read(&eb->blocking_writers) &&
-	    current->pid == eb->lock_owner) {
+	if (eb->lock_owner == current->pid) {
 		/*
 		 * This extent is already write-locked by our thread. We allow
 		 * an additional read lock to be added because it's for the same
@@ -100,84 +60,53 @@ again:
 		 */
 		BUG_ON(eb->lock_nested);
 		eb->lock_nested = 1;
-		read_unlock(&eb->lock);
 		return;
 	}
-	if (atomic_read(&eb->blocking_writers)) {
-		read_unlock(&eb->lock);
-		wait_event(eb->write_lock_wq,
-			   atomic_read(&eb->blocking_writers) == 0);
-		goto again;
-	}
+	down_read_nested(&eb->lock, nest);
 	atomic_inc(&eb->read_locks);
-	atomic_inc(&eb->spinning_readers);
+}
+
+void btrfs_tree_read_lock(struct extent_buffer *eb)
+{
+	btrfs_tree_read_lock_nested(eb, BTRFS_NESTING_NORMAL);
 }
 
 /*
- * take a spinning read lock.
+ * take a read lock only if that can be done without waiting.
  * returns 1 if we get the read lock and 0 if we don't
- * this won't wait for blocking writers
  */
 int btrfs_tree_read_lock_atomic(struct extent_buffer *eb)
 {
-	if (atomic_read(&eb->blocking_writers))
-		return 0;
-
-	read_lock(&eb->lock);
-	if (atomic_read(&eb->blocking_writers)) {
-		read_unlock(&eb->lock);
-		return 0;
-	}
-	atomic_inc(&eb->read_locks);
-	atomic_inc(&eb->spinning_readers);
-	return 1;
+	return btrfs_try_tree_read_lock(eb);
 }
 
 /*
  * returns 1 if we get the read lock and 0 if we don't
- * this won't wait for blocking writers
+ * this won't wait for writers
  */
 int btrfs_try_tree_read_lock(struct extent_buffer *eb)
 {
-	if (atomic_read(&eb->blocking_writers))
-		return 0;
-
-	if (!read_trylock(&eb->lock))
-		return 0;
-
-	if (atomic_read(&eb->blocking_writers)) {
-		read_unlock(&eb->lock);
+	if (!down_read_trylock(&eb->lock))
 		return 0;
-	}
 	atomic_inc(&eb->read_locks);
-	atomic_inc(&eb->spinning_readers);
 	return 1;
 }
 
 /*
- * returns 1 if we get the read lock and 0 if we don't
- * this won't wait for blocking writers or readers
+ * returns 1 if we get the write lock and 0 if we don't
+ * this won't wait for readers or writers
  */
 int btrfs_try_tree_write_lock(struct extent_buffer *eb)
 {
-	if (atomic_read(&eb->blocking_writers) ||
-	    atomic_read(&eb->blocking_readers))
-		return 0;
-
-	write_lock(&eb->lock);
-	if (atomic_read(&eb->blocking_writers) ||
-	    atomic_read(&eb->blocking_readers)) {
-		write_unlock(&eb->lock);
+	if (!down_write_trylock(&eb->lock))
 		return 0;
-	}
 	atomic_inc(&eb->write_locks);
-	atomic_inc(&eb->spinning_writers);
 	eb->lock_owner = current->pid;
 	return 1;
 }
 
 /*
- * drop a spinning read lock
+ * drop a read lock
  */
 void btrfs_tree_read_unlock(struct extent_buffer *eb)
 {
@@ -192,88 +121,41 @@ void btrfs_tree_read_unlock(struct extent_buffer *eb)
 		return;
 	}
 	btrfs_assert_tree_read_locked(eb);
-	WARN_ON(atomic_read(&eb->spinning_readers) == 0);
-	atomic_dec(&eb->spinning_readers);
 	atomic_dec(&eb->read_locks);
-	read_unlock(&eb->lock);
+	up_read(&eb->lock);
 }
 
-/*
- * drop a blocking read lock
- */
 void btrfs_tree_read_unlock_blocking(struct extent_buffer *eb)
 {
-	/*
-	 * if we're nested, we have the write lock.  No new locking
-	 * is needed as long as we are the lock owner.
-	 * The write unlock will do a barrier for us, and the lock_nested
-	 * field only matters to the lock owner.
-	 */
-	if (eb->lock_nested && current->pid == eb->lock_owner) {
-		eb->lock_nested = 0;
-		return;
-	}
-	btrfs_assert_tree_read_locked(eb);
-	WARN_ON(atomic_read(&eb->blocking_readers) == 0);
-	/* atomic_dec_and_test implies a barrier */
-	if (atomic_dec_and_test(&eb->blocking_readers))
-		cond_wake_up_nomb(&eb->read_lock_wq);
-	atomic_dec(&eb->read_locks);
+	btrfs_tree_read_unlock(eb);
 }
 
 /*
- * take a spinning write lock.  This will wait for both
- * blocking readers or writers
+ * take a write lock, waiting for all readers and writers
  */
-void btrfs_tree_lock(struct extent_buffer *eb)
+void btrfs_tree_lock_nested(struct extent_buffer *eb,
+			    enum btrfs_lock_nesting nest)
 {
 	WARN_ON(eb->lock_owner == current->pid);
-again:
-	wait_event(eb->read_lock_wq, atomic_read(&eb->blocking_readers) == 0);
-	wait_event(eb->write_lock_wq, atomic_read(&eb->blocking_writers) == 0);
-	write_lock(&eb->lock);
-	if (atomic_read(&eb->blocking_readers)) {
-		write_unlock(&eb->lock);
-		wait_event(eb->read_lock_wq,
-			   atomic_read(&eb->blocking_readers) == 0);
-		goto again;
-	}
-	if (atomic_read(&eb->blocking_writers)) {
-		write_unlock(&eb->lock);
-		wait_event(eb->write_lock_wq,
-			   atomic_read(&eb->blocking_writers) == 0);
-		goto again;
-	}
-	WARN_ON(atomic_read(&eb->spinning_writers));
-	atomic_inc(&eb->spinning_writers);
+	down_write_nested(&eb->lock, nest);
 	atomic_inc(&eb->write_locks);
 	eb->lock_owner = current->pid;
 }
 
+void btrfs_tree_lock(struct extent_buffer *eb)
+{
+	btrfs_tree_lock_nested(eb, BTRFS_NESTING_NORMAL);
+}
+
 /*
- * drop a spinning or a blocking write lock.
+ * drop a write lock
  */
 void btrfs_tree_unlock(struct extent_buffer *eb)
 {
-	int blockers = atomic_read(&eb->blocking_writers);
-
-	BUG_ON(blockers > 1);
-
 	btrfs_assert_tree_locked(eb);
 	eb->lock_owner = 0;
 	atomic_dec(&eb->write_locks);
-
-	if (blockers) {
-		WARN_ON(atomic_read(&eb->spinning_writers));
-		atomic_dec(&eb->blocking_writers);
-		/* Use the lighter barrier after atomic */
-		smp_mb__after_atomic();
-		cond_wake_up_nomb(&eb->write_lock_wq);
-	} else {
-		WARN_ON(atomic_read(&eb->spinning_writers) != 1);
-		atomic_dec(&eb->spinning_writers);
-		write_unlock(&eb->lock);
-	}
+	up_write(&eb->lock);
 }
 
 void btrfs_assert_tree_locked(struct extent_buffer *eb)
@@ -11,10 +11,35 @@
 #define BTRFS_WRITE_LOCK_BLOCKING 3
 #define BTRFS_READ_LOCK_BLOCKING 4
 
+/*
+ * Lockdep subclasses for locking a tree block while another one of the
+ * same level (and so the same lock class) is already held.
+ */
+enum btrfs_lock_nesting {
+	BTRFS_NESTING_NORMAL,
+	/* the copy made while COWing a locked block */
+	BTRFS_NESTING_COW,
+	/* the left or right sibling of a locked block */
+	BTRFS_NESTING_LEFT,
+	BTRFS_NESTING_RIGHT,
+	/* the copy made while COWing one of those siblings */
+	BTRFS_NESTING_LEFT_COW,
+	BTRFS_NESTING_RIGHT_COW,
+	/* the new block a locked one is split into */
+	BTRFS_NESTING_SPLIT,
+	/* a new root added above (or copied from) a locked one */
+	BTRFS_NESTING_NEW_ROOT,
+	BTRFS_NESTING_MAX,
+};
+
 void btrfs_tree_lock(struct extent_buffer *eb);
+void btrfs_tree_lock_nested(struct extent_buffer *eb,
+			    enum btrfs_lock_nesting nest);
 void btrfs_tree_unlock(struct extent_buffer *eb);
 
 void btrfs_tree_read_lock(struct extent_buffer *eb);
+void btrfs_tree_read_lock_nested(struct extent_buffer *eb,
+				 enum btrfs_lock_nesting nest);
 void btrfs_tree_read_unlock(struct extent_buffer *eb);
 void btrfs_tree_read_unlock_blocking(struct extent_buffer *eb);
 void btrfs_set_lock_blocking_rw(struct extent_buffer *eb, int rw);
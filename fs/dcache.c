@@ -119,6 +119,13 @@ struct dentry_stat_t dentry_stat = {
 
 static DEFINE_PER_CPU(long, nr_dentry);
 static DEFINE_PER_CPU(long, nr_dentry_unused);
+static DEFINE_PER_CPU(long, nr_dentry_negative);
+
+/*
+ * Cap on the unused negative dentries a single superblock keeps around,
+ * 0 for no limit. Sized in dcache_init() to let them take ~1/16 of RAM.
+ */
+unsigned long sysctl_negative_dentry_limit __read_mostly;
 
 #if defined(CONFIG_SYSCTL) && defined(CONFIG_PROC_FS)
 
@@ -152,11 +159,22 @@ static long get_nr_dentry_unused(void)
 	return sum < 0 ? 0 : sum;
 }
 
+static long get_nr_dentry_negative(void)
+{
+	int i;
+	long sum = 0;
+
+	for_each_possible_cpu(i)
+		sum += per_cpu(nr_dentry_negative, i);
+	return sum < 0 ? 0 : sum;
+}
+
 int proc_nr_dentry(struct ctl_table *table, int write, void __user *buffer,
 		   size_t *lenp, loff_t *ppos)
 {
 	dentry_stat.nr_dentry = get_nr_dentry();
 	dentry_stat.nr_unused = get_nr_dentry_unused();
+	dentry_stat.nr_negative = get_nr_dentry_negative();
 	return proc_doulongvec_minmax(table, write, buffer, lenp, ppos);
 }
 #endif
@@ -311,6 +329,21 @@ void release_dentry_name_snapshot(struct name_snapshot *name)
 }
 EXPORT_SYMBOL(release_dentry_name_snapshot);
 
+/*
+ * Negative dentries sitting on the LRU are counted both globally and per
+ * superblock, the latter so that a single filesystem being probed for
+ * names that do not exist cannot fill the dcache with them. The counts
+ * follow the DCACHE_LRU_LIST bit and the dentry type, under d_lock.
+ */
+#define d_flags_negative(flags) \
+	(((flags) & DCACHE_ENTRY_TYPE) == DCACHE_MISS_TYPE)
+
+static void d_lru_count_negative(struct dentry *dentry, long nr)
+{
+	this_cpu_add(nr_dentry_negative, nr);
+	percpu_counter_add(&dentry->d_sb->s_nr_dentry_negative, nr);
+}
+
 static inline void __d_set_inode_and_type(struct dentry *dentry,
 					  struct inode *inode,
 					  unsigned type_flags)
@@ -319,6 +352,10 @@ static inline void __d_set_inode_and_type(struct dentry *dentry,
 
 	dentry->d_inode = inode;
 	flags = READ_ONCE(dentry->d_flags);
+	if ((flags & DCACHE_LRU_LIST) &&
+	    d_flags_negative(flags) != d_flags_negative(type_flags))
+		d_lru_count_negative(dentry,
+				     d_flags_negative(type_flags) ? 1 : -1);
 	flags &= ~(DCACHE_ENTRY_TYPE | DCACHE_FALLTHRU);
 	flags |= type_flags;
 	WRITE_ONCE(dentry->d_flags, flags);
@@ -328,6 +365,8 @@ static inline void __d_clear_type_and_inode(struct dentry *dentry)
 {
 	unsigned flags = READ_ONCE(dentry->d_flags);
 
+	if ((flags & DCACHE_LRU_LIST) && !d_flags_negative(flags))
+		d_lru_count_negative(dentry, 1);
 	flags &= ~(DCACHE_ENTRY_TYPE | DCACHE_FALLTHRU);
 	WRITE_ONCE(dentry->d_flags, flags);
 	dentry->d_inode = NULL;
@@ -383,7 +422,8 @@ static void dentry_unlink_inode(struct dentry * dentry)
  * on the shrink list (ie not on the superblock LRU list).
  *
  * The per-cpu "nr_dentry_unused" counters are updated with
- * the DCACHE_LRU_LIST bit.
+ * the DCACHE_LRU_LIST bit, and so are the negative dentry
+ * counts for negative dentries.
  *
  * These helper functions make sure we always follow the
  * rules. d_lock must be held by the caller.
@@ -394,6 +434,8 @@ static void d_lru_add(struct dentry *dentry)
 	D_FLAG_VERIFY(dentry, 0);
 	dentry->d_flags |= DCACHE_LRU_LIST;
 	this_cpu_inc(nr_dentry_unused);
+	if (d_is_negative(dentry))
+		d_lru_count_negative(dentry, 1);
 	WARN_ON_ONCE(!list_lru_add(&dentry->d_sb->s_dentry_lru, &dentry->d_lru));
 }
 
@@ -402,6 +444,8 @@ static void d_lru_del(struct dentry *dentry)
 	D_FLAG_VERIFY(dentry, DCACHE_LRU_LIST);
 	dentry->d_flags &= ~DCACHE_LRU_LIST;
 	this_cpu_dec(nr_dentry_unused);
+	if (d_is_negative(dentry))
+		d_lru_count_negative(dentry, -1);
 	WARN_ON_ONCE(!list_lru_del(&dentry->d_sb->s_dentry_lru, &dentry->d_lru));
 }
 
@@ -411,6 +455,8 @@ static void d_shrink_del(struct dentry *dentry)
 	list_del_init(&dentry->d_lru);
 	dentry->d_flags &= ~(DCACHE_SHRINK_LIST | DCACHE_LRU_LIST);
 	this_cpu_dec(nr_dentry_unused);
+	if (d_is_negative(dentry))
+		d_lru_count_negative(dentry, -1);
 }
 
 static void d_shrink_add(struct dentry *dentry, struct list_head *list)
@@ -419,6 +465,8 @@ static void d_shrink_add(struct dentry *dentry, struct list_head *list)
 	list_add(&dentry->d_lru, list);
 	dentry->d_flags |= DCACHE_SHRINK_LIST | DCACHE_LRU_LIST;
 	this_cpu_inc(nr_dentry_unused);
+	if (d_is_negative(dentry))
+		d_lru_count_negative(dentry, 1);
 }
 
 /*
@@ -432,6 +480,8 @@ static void d_lru_isolate(struct list_lru_one *lru, struct dentry *dentry)
 	D_FLAG_VERIFY(dentry, DCACHE_LRU_LIST);
 	dentry->d_flags &= ~DCACHE_LRU_LIST;
 	this_cpu_dec(nr_dentry_unused);
+	if (d_is_negative(dentry))
+		d_lru_count_negative(dentry, -1);
 	list_lru_isolate(lru, &dentry->d_lru);
 }
 
@@ -569,6 +619,8 @@ static void __dentry_kill(struct dentry *dentry)
 	this_cpu_dec(nr_dentry);
 	if (dentry->d_op && dentry->d_op->d_release)
 		dentry->d_op->d_release(dentry);
+	if (dentry->d_flags & DCACHE_PATH_CACHED)
+		path_cache_forget(dentry);
 
 	spin_lock(&dentry->d_lock);
 	if (dentry->d_flags & DCACHE_SHRINK_LIST) {
@@ -619,6 +671,33 @@ static inline struct dentry *lock_parent(struct dentry *dentry)
 	return __lock_parent(dentry);
 }
 
+static inline bool negative_dentries_over_limit(struct super_block *sb,
+						unsigned long limit)
+{
+	return limit &&
+	       percpu_counter_read_positive(&sb->s_nr_dentry_negative) > limit;
+}
+
+/*
+ * Past the limit, kick the background pruning of the superblock's oldest
+ * negative dentries. Only when it falls far behind do we stop caching the
+ * new ones outright, since those are the likeliest to be looked up again.
+ */
+static bool retain_negative_dentry(struct dentry *dentry)
+{
+	struct super_block *sb = dentry->d_sb;
+	unsigned long limit = READ_ONCE(sysctl_negative_dentry_limit);
+
+	if (likely(!negative_dentries_over_limit(sb, limit)))
+		return true;
+
+	if ((sb->s_flags & SB_ACTIVE) && !work_pending(&sb->s_negative_prune_work))
+		schedule_work(&sb->s_negative_prune_work);
+
+	return percpu_counter_read_positive(&sb->s_nr_dentry_negative) / 2 <=
+	       limit;
+}
+
 static inline bool retain_dentry(struct dentry *dentry)
 {
 	WARN_ON(d_in_lookup(dentry));
@@ -634,6 +713,10 @@ static inline bool retain_dentry(struct dentry *dentry)
 		if (dentry->d_op->d_delete(dentry))
 			return false;
 	}
+
+	if (unlikely(d_is_negative(dentry)) && !retain_negative_dentry(dentry))
+		return false;
+
 	/* retain; LRU fodder */
 	dentry->d_lockref.count--;
 	if (unlikely(!(dentry->d_flags & DCACHE_LRU_LIST)))
@@ -1109,7 +1192,8 @@ static enum lru_status dentry_lru_isolate(struct list_head *item,
 	/*
 	 * Referenced dentries are still in use. If they have active
 	 * counts, just remove them from the LRU. Otherwise give them
-	 * another pass through the LRU.
+	 * another pass through the LRU, unless they are negative ones
+	 * of a superblock that already has too many of those.
 	 */
 	if (dentry->d_lockref.count) {
 		d_lru_isolate(lru, dentry);
@@ -1117,7 +1201,10 @@ static enum lru_status dentry_lru_isolate(struct list_head *item,
 		return LRU_REMOVED;
 	}
 
-	if (dentry->d_flags & DCACHE_REFERENCED) {
+	if ((dentry->d_flags & DCACHE_REFERENCED) &&
+	    !(d_is_negative(dentry) &&
+	      negative_dentries_over_limit(dentry->d_sb,
+				READ_ONCE(sysctl_negative_dentry_limit)))) {
 		dentry->d_flags &= ~DCACHE_REFERENCED;
 		spin_unlock(&dentry->d_lock);
 
@@ -1202,20 +1289,83 @@ static enum lru_status dentry_lru_isolate_shrink(struct list_head *item,
  */
 void shrink_dcache_sb(struct super_block *sb)
 {
-	long freed;
-
 	do {
 		LIST_HEAD(dispose);
 
-		freed = list_lru_walk(&sb->s_dentry_lru,
+		list_lru_walk(&sb->s_dentry_lru,
 			dentry_lru_isolate_shrink, &dispose, 1024);
-
-		this_cpu_sub(nr_dentry_unused, freed);
 		shrink_dentry_list(&dispose);
 	} while (list_lru_count(&sb->s_dentry_lru) > 0);
 }
 EXPORT_SYMBOL(shrink_dcache_sb);
 
+static enum lru_status dentry_negative_lru_isolate(struct list_head *item,
+		struct list_lru_one *lru, spinlock_t *lru_lock, void *arg)
+{
+	struct list_head *freeable = arg;
+	struct dentry	*dentry = container_of(item, struct dentry, d_lru);
+
+	if (!spin_trylock(&dentry->d_lock))
+		return LRU_SKIP;
+
+	if (dentry->d_lockref.count) {
+		d_lru_isolate(lru, dentry);
+		spin_unlock(&dentry->d_lock);
+		return LRU_REMOVED;
+	}
+
+	/*
+	 * Positive dentries are left for the shrinker to age, rotating
+	 * them just keeps the walk moving. Negative ones that were looked
+	 * up again since the last pass get a second chance, as usual.
+	 */
+	if (!d_is_negative(dentry)) {
+		spin_unlock(&dentry->d_lock);
+		return LRU_ROTATE;
+	}
+	if (dentry->d_flags & DCACHE_REFERENCED) {
+		dentry->d_flags &= ~DCACHE_REFERENCED;
+		spin_unlock(&dentry->d_lock);
+		return LRU_ROTATE;
+	}
+
+	d_lru_shrink_move(lru, dentry, freeable);
+	spin_unlock(&dentry->d_lock);
+
+	return LRU_REMOVED;
+}
+
+/*
+ * Queued by retain_negative_dentry() once a superblock caches more unused
+ * negative dentries than sysctl_negative_dentry_limit allows. Walks the
+ * LRU from its cold end and frees negative dentries until we are back
+ * under 7/8 of the limit, so that we don't get requeued right away.
+ */
+void prune_negative_dentries_work(struct work_struct *work)
+{
+	struct super_block *sb = container_of(work, struct super_block,
+					      s_negative_prune_work);
+	unsigned long limit = READ_ONCE(sysctl_negative_dentry_limit);
+	unsigned long scan;
+
+	if (!limit || !trylock_super(sb))
+		return;
+
+	limit -= limit >> 3;
+	scan = list_lru_count(&sb->s_dentry_lru);
+	while (scan && negative_dentries_over_limit(sb, limit)) {
+		unsigned long nr = min(scan, 1024UL);
+		LIST_HEAD(dispose);
+
+		list_lru_walk(&sb->s_dentry_lru, dentry_negative_lru_isolate,
+			      &dispose, nr);
+		shrink_dentry_list(&dispose);
+		scan -= nr;
+		cond_resched();
+	}
+	up_read(&sb->s_umount);
+}
+
 /**
  * enum d_walk_ret - action to talke during tree walk
  * @D_WALK_CONTINUE:	contrinue walk
@@ -3146,6 +3296,9 @@ static void __init dcache_init(void)
 		SLAB_RECLAIM_ACCOUNT|SLAB_PANIC|SLAB_MEM_SPREAD|SLAB_ACCOUNT,
 		d_iname);
 
+	sysctl_negative_dentry_limit = mult_frac(totalram_pages, PAGE_SIZE / 16,
+						 sizeof(struct dentry));
+
 	/* Hash may have been set up in dcache_init_early */
 	if (!hashdist)
 		return;
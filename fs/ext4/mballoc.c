@@ -688,23 +688,40 @@ static void ext4_mb_mark_free_simple(struct super_block *sb,
 
 /*
  * Cache the order of the largest free extent we have available in this block
- * group.
+ * group, and keep the group on the s_mb_largest_free_orders list for that
+ * order so that the allocator can find groups with a large enough free extent
+ * without scanning them all.  Called with the group locked.
  */
 static void
 mb_set_largest_free_order(struct super_block *sb, struct ext4_group_info *grp)
 {
-	int i;
-	int bits;
-
-	grp->bb_largest_free_order = -1; /* uninit */
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int i, new_order = -1;
 
-	bits = sb->s_blocksize_bits + 1;
-	for (i = bits; i >= 0; i--) {
+	for (i = MB_NUM_ORDERS(sb) - 1; i >= 0; i--) {
 		if (grp->bb_counters[i] > 0) {
-			grp->bb_largest_free_order = i;
+			new_order = i;
 			break;
 		}
 	}
+
+	if (new_order == grp->bb_largest_free_order)
+		return;
+
+	if (grp->bb_largest_free_order >= 0) {
+		write_lock(&sbi->s_mb_largest_free_orders_locks[
+					      grp->bb_largest_free_order]);
+		list_del_init(&grp->bb_largest_free_order_node);
+		write_unlock(&sbi->s_mb_largest_free_orders_locks[
+					      grp->bb_largest_free_order]);
+	}
+	grp->bb_largest_free_order = new_order;
+	if (new_order >= 0) {
+		write_lock(&sbi->s_mb_largest_free_orders_locks[new_order]);
+		list_add_tail(&grp->bb_largest_free_order_node,
+			      &sbi->s_mb_largest_free_orders[new_order]);
+		write_unlock(&sbi->s_mb_largest_free_orders_locks[new_order]);
+	}
 }
 
 static noinline_for_stack
@@ -755,7 +772,8 @@ void ext4_mb_generate_buddy(struct super_block *sb,
 	}
 	mb_set_largest_free_order(sb, grp);
 
-	clear_bit(EXT4_GROUP_INFO_NEED_INIT_BIT, &(grp->bb_state));
+	if (test_and_clear_bit(EXT4_GROUP_INFO_NEED_INIT_BIT, &(grp->bb_state)))
+		atomic_dec(&sbi->s_mb_uninit_groups);
 
 	period = get_cycles() - period;
 	spin_lock(&sbi->s_bal_lock);
@@ -1665,10 +1683,12 @@ static void ext4_mb_use_best_found(struct ext4_allocation_context *ac,
 	get_page(ac->ac_buddy_page);
 	/* store last allocated for subsequent stream allocation */
 	if (ac->ac_flags & EXT4_MB_STREAM_ALLOC) {
-		spin_lock(&sbi->s_md_lock);
-		sbi->s_mb_last_group = ac->ac_f_ex.fe_group;
-		sbi->s_mb_last_start = ac->ac_f_ex.fe_start;
-		spin_unlock(&sbi->s_md_lock);
+		struct ext4_mb_stream_goal *goal;
+
+		/* only a hint, a migrated or racing writer is harmless */
+		goal = raw_cpu_ptr(sbi->s_mb_stream_goal);
+		WRITE_ONCE(goal->group, ac->ac_f_ex.fe_group);
+		WRITE_ONCE(goal->start, ac->ac_f_ex.fe_start);
 	}
 }
 
@@ -2095,11 +2115,153 @@ static int ext4_mb_good_group(struct ext4_allocation_context *ac,
 	return 0;
 }
 
+static inline ext4_group_t
+next_linear_group(ext4_group_t group, ext4_group_t ngroups)
+{
+	/*
+	 * Artificially restricted ngroups for non-extent
+	 * files makes group > ngroups possible on first loop.
+	 */
+	return group + 1 >= ngroups ? 0 : group + 1;
+}
+
+static inline bool
+ext4_mb_should_optimize_scan(struct ext4_allocation_context *ac)
+{
+	if (!EXT4_SB(ac->ac_sb)->s_mb_optimize_scan)
+		return false;
+	if (ac->ac_criteria >= 2)
+		return false;
+	/* the order lists span all groups, not just the blockfile ones */
+	return ext4_test_inode_flag(ac->ac_inode, EXT4_INODE_EXTENTS);
+}
+
+/*
+ * Find a group that suits criteria @cr on the s_mb_largest_free_orders
+ * lists, starting with the groups whose largest free extent is of @order.
+ * The search resumes right after the group picked last during this pass,
+ * the scan of that one and of those before it did not work out.  Should
+ * the last pick have moved to another list meanwhile, its old list is
+ * searched again from the start.
+ */
+static struct ext4_group_info *
+ext4_mb_find_group_by_order(struct ext4_allocation_context *ac,
+			    int order, int cr)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(ac->ac_sb);
+	struct ext4_group_info *grp, *last = ac->ac_last_pick;
+	struct ext4_group_info *found = NULL;
+	struct list_head *head;
+
+	if (last)
+		order = max(order, ac->ac_last_pick_order);
+
+	for (; order < MB_NUM_ORDERS(ac->ac_sb) && !found; order++) {
+		head = &sbi->s_mb_largest_free_orders[order];
+		if (list_empty(head))
+			continue;
+		read_lock(&sbi->s_mb_largest_free_orders_locks[order]);
+		/* only on this list if its order and node agree */
+		if (last && last->bb_largest_free_order == order &&
+		    !list_empty(&last->bb_largest_free_order_node))
+			grp = last;
+		else
+			grp = list_entry(head, struct ext4_group_info,
+					 bb_largest_free_order_node);
+		list_for_each_entry_continue(grp, head,
+					     bb_largest_free_order_node) {
+			/* ext4_mb_good_group() must not sleep to init it */
+			if (EXT4_MB_GRP_NEED_INIT(grp))
+				continue;
+			if (sbi->s_mb_stats)
+				atomic_inc(&sbi->s_bal_cX_groups_considered[cr]);
+			if (ext4_mb_good_group(ac, grp->bb_group, cr) > 0) {
+				found = grp;
+				break;
+			}
+		}
+		read_unlock(&sbi->s_mb_largest_free_orders_locks[order]);
+		last = NULL;
+	}
+
+	if (found) {
+		ac->ac_last_pick = found;
+		ac->ac_last_pick_order = order - 1;
+	}
+	return found;
+}
+
+/*
+ * Groups whose buddy was never generated are on none of the order lists,
+ * which right after mount is most of them.  Hand those to the caller in
+ * order from the goal, ext4_mb_good_group() initializes them and puts
+ * them on the lists.
+ */
+static bool ext4_mb_next_uninit_group(struct ext4_allocation_context *ac,
+				      ext4_group_t *group, ext4_group_t ngroups)
+{
+	struct super_block *sb = ac->ac_sb;
+
+	if (!atomic_read(&EXT4_SB(sb)->s_mb_uninit_groups))
+		return false;
+
+	while (ac->ac_uninit_left) {
+		ext4_group_t g = ac->ac_uninit_next;
+
+		ac->ac_uninit_next = next_linear_group(g, ngroups);
+		ac->ac_uninit_left--;
+		if (g < ngroups &&
+		    EXT4_MB_GRP_NEED_INIT(ext4_get_group_info(sb, g))) {
+			*group = g;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Pick the group to look at next.  For criteria 0 and 1 that is, after the
+ * few groups following the goal, a group known to have a large enough free
+ * extent, then a group not initialized yet.  If there is none, *@new_cr is
+ * bumped so that the caller moves on to the next criteria right away
+ * instead of scanning every group.
+ */
+static void ext4_mb_choose_next_group(struct ext4_allocation_context *ac,
+		int *new_cr, ext4_group_t *group, ext4_group_t ngroups)
+{
+	struct ext4_group_info *grp;
+	int order;
+
+	*new_cr = ac->ac_criteria;
+	if (!ext4_mb_should_optimize_scan(ac) ||
+	    ac->ac_groups_linear_remaining) {
+		if (ac->ac_groups_linear_remaining)
+			ac->ac_groups_linear_remaining--;
+		*group = next_linear_group(*group, ngroups);
+		return;
+	}
+
+	/*
+	 * An unaligned free extent of len blocks may only hold buddy
+	 * chunks of half that order, let ext4_mb_good_group() judge.
+	 */
+	if (*new_cr == 0)
+		order = ac->ac_2order;
+	else
+		order = max(fls(ac->ac_g_ex.fe_len) - 2, 0);
+
+	grp = ext4_mb_find_group_by_order(ac, order, *new_cr);
+	if (grp)
+		*group = grp->bb_group;
+	else if (!ext4_mb_next_uninit_group(ac, group, ngroups))
+		*new_cr = *new_cr + 1;
+}
+
 static noinline_for_stack int
 ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 {
 	ext4_group_t ngroups, group, i;
-	int cr;
+	int cr, new_cr;
 	int err = 0, first_err = 0;
 	struct ext4_sb_info *sbi;
 	struct super_block *sb;
@@ -2145,13 +2307,13 @@ ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 							   sb->s_blocksize_bits + 2);
 	}
 
-	/* if stream allocation is enabled, use global goal */
+	/* if stream allocation is enabled, continue this CPU's stream */
 	if (ac->ac_flags & EXT4_MB_STREAM_ALLOC) {
-		/* TBD: may be hot point */
-		spin_lock(&sbi->s_md_lock);
-		ac->ac_g_ex.fe_group = sbi->s_mb_last_group;
-		ac->ac_g_ex.fe_start = sbi->s_mb_last_start;
-		spin_unlock(&sbi->s_md_lock);
+		struct ext4_mb_stream_goal *goal;
+
+		goal = raw_cpu_ptr(sbi->s_mb_stream_goal);
+		ac->ac_g_ex.fe_group = READ_ONCE(goal->group);
+		ac->ac_g_ex.fe_start = READ_ONCE(goal->start);
 	}
 
 	/* Let's just scan groups to find more-less suitable blocks */
@@ -2168,10 +2330,21 @@ repeat:
 		 * from the goal value specified
 		 */
 		group = ac->ac_g_ex.fe_group;
+		ac->ac_groups_linear_remaining = sbi->s_mb_max_linear_groups;
+		ac->ac_last_pick = NULL;
+		ac->ac_uninit_next = group;
+		ac->ac_uninit_left = ngroups;
 
-		for (i = 0; i < ngroups; group++, i++) {
+		for (i = 0, new_cr = cr; i < ngroups; i++,
+		     ext4_mb_choose_next_group(ac, &new_cr, &group, ngroups)) {
 			int ret = 0;
 			cond_resched();
+			if (new_cr != cr) {
+				if (sbi->s_mb_stats)
+					atomic_inc(&sbi->s_bal_cX_failed[cr]);
+				cr = new_cr;
+				goto repeat;
+			}
 			/*
 			 * Artificially restricted ngroups for non-extent
 			 * files makes group > ngroups possible on first loop.
@@ -2180,6 +2353,8 @@ repeat:
 				group = 0;
 
 			/* This now checks without needing the buddy page */
+			if (sbi->s_mb_stats)
+				atomic_inc(&sbi->s_bal_cX_groups_considered[cr]);
 			ret = ext4_mb_good_group(ac, group, cr);
 			if (ret <= 0) {
 				if (!first_err)
@@ -2221,6 +2396,12 @@ repeat:
 			if (ac->ac_status != AC_STATUS_CONTINUE)
 				break;
 		}
+		if (sbi->s_mb_stats) {
+			if (ac->ac_status == AC_STATUS_FOUND)
+				atomic_inc(&sbi->s_bal_cX_hits[cr]);
+			else if (ac->ac_status == AC_STATUS_CONTINUE)
+				atomic_inc(&sbi->s_bal_cX_failed[cr]);
+		}
 	}
 
 	if (ac->ac_b_ex.fe_len > 0 && ac->ac_status != AC_STATUS_FOUND &&
@@ -2339,6 +2520,53 @@ const struct seq_operations ext4_mb_seq_groups_ops = {
 	.show   = ext4_mb_seq_groups_show,
 };
 
+int ext4_seq_mb_stats_show(struct seq_file *seq, void *offset)
+{
+	struct super_block *sb = seq->private;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int cr;
+
+	seq_puts(seq, "mballoc:\n");
+	if (!sbi->s_mb_stats) {
+		seq_puts(seq, "\tmb stats collection turned off.\n");
+		seq_puts(seq, "\tTo enable, please write \"1\" to sysfs file mb_stats.\n");
+		return 0;
+	}
+	seq_printf(seq, "\treqs: %u\n", atomic_read(&sbi->s_bal_reqs));
+	seq_printf(seq, "\tsuccess: %u\n", atomic_read(&sbi->s_bal_success));
+	seq_printf(seq, "\tallocated: %u\n",
+		   atomic_read(&sbi->s_bal_allocated));
+	seq_printf(seq, "\tgroups_scanned: %u\n",
+		   atomic_read(&sbi->s_bal_groups_scanned));
+	seq_printf(seq, "\textents_scanned: %u\n",
+		   atomic_read(&sbi->s_bal_ex_scanned));
+	seq_printf(seq, "\toptimize_scan: %u\n", sbi->s_mb_optimize_scan);
+
+	for (cr = 0; cr < 4; cr++) {
+		seq_printf(seq, "\tcr%d_stats:\n", cr);
+		seq_printf(seq, "\t\thits: %u\n",
+			   atomic_read(&sbi->s_bal_cX_hits[cr]));
+		seq_printf(seq, "\t\tgroups_considered: %u\n",
+			   atomic_read(&sbi->s_bal_cX_groups_considered[cr]));
+		seq_printf(seq, "\t\tuseless_loops: %u\n",
+			   atomic_read(&sbi->s_bal_cX_failed[cr]));
+	}
+
+	seq_printf(seq, "\tgoal_hits: %u\n", atomic_read(&sbi->s_bal_goals));
+	seq_printf(seq, "\t2^n_hits: %u\n", atomic_read(&sbi->s_bal_2orders));
+	seq_printf(seq, "\tbreaks: %u\n", atomic_read(&sbi->s_bal_breaks));
+	seq_printf(seq, "\tlost: %u\n", atomic_read(&sbi->s_mb_lost_chunks));
+	seq_printf(seq, "\tbuddies_generated: %lu\n",
+		   sbi->s_mb_buddies_generated);
+	seq_printf(seq, "\tbuddies_time_used: %llu\n",
+		   sbi->s_mb_generation_time);
+	seq_printf(seq, "\tpreallocated: %u\n",
+		   atomic_read(&sbi->s_mb_preallocated));
+	seq_printf(seq, "\tdiscarded: %u\n",
+		   atomic_read(&sbi->s_mb_discarded));
+	return 0;
+}
+
 static struct kmem_cache *get_groupinfo_cache(int blocksize_bits)
 {
 	int cache_index = blocksize_bits - EXT4_MIN_BLOCK_LOG_SIZE;
@@ -2420,6 +2648,7 @@ int ext4_mb_add_groupinfo(struct super_block *sb, ext4_group_t group,
 	}
 	set_bit(EXT4_GROUP_INFO_NEED_INIT_BIT,
 		&(meta_group_info[i]->bb_state));
+	atomic_inc(&sbi->s_mb_uninit_groups);
 
 	/*
 	 * initialize bb_free to be able to skip
@@ -2435,9 +2664,11 @@ int ext4_mb_add_groupinfo(struct super_block *sb, ext4_group_t group,
 	}
 
 	INIT_LIST_HEAD(&meta_group_info[i]->bb_prealloc_list);
+	INIT_LIST_HEAD(&meta_group_info[i]->bb_largest_free_order_node);
 	init_rwsem(&meta_group_info[i]->alloc_sem);
 	meta_group_info[i]->bb_free_root = RB_ROOT;
 	meta_group_info[i]->bb_largest_free_order = -1;  /* uninit */
+	meta_group_info[i]->bb_group = group;
 
 #ifdef DOUBLE_CHECK
 	{
@@ -2607,6 +2838,29 @@ int ext4_mb_init(struct super_block *sb)
 		i++;
 	} while (i <= sb->s_blocksize_bits + 1);
 
+	i = MB_NUM_ORDERS(sb) * sizeof(struct list_head);
+	sbi->s_mb_largest_free_orders = kmalloc(i, GFP_KERNEL);
+	if (!sbi->s_mb_largest_free_orders) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	i = MB_NUM_ORDERS(sb) * sizeof(rwlock_t);
+	sbi->s_mb_largest_free_orders_locks = kmalloc(i, GFP_KERNEL);
+	if (!sbi->s_mb_largest_free_orders_locks) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < MB_NUM_ORDERS(sb); i++) {
+		INIT_LIST_HEAD(&sbi->s_mb_largest_free_orders[i]);
+		rwlock_init(&sbi->s_mb_largest_free_orders_locks[i]);
+	}
+
+	sbi->s_mb_stream_goal = alloc_percpu(struct ext4_mb_stream_goal);
+	if (!sbi->s_mb_stream_goal) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
 	spin_lock_init(&sbi->s_md_lock);
 	spin_lock_init(&sbi->s_bal_lock);
 	sbi->s_mb_free_pending = 0;
@@ -2617,6 +2871,8 @@ int ext4_mb_init(struct super_block *sb)
 	sbi->s_mb_stats = MB_DEFAULT_STATS;
 	sbi->s_mb_stream_request = MB_DEFAULT_STREAM_THRESHOLD;
 	sbi->s_mb_order2_reqs = MB_DEFAULT_ORDER2_REQS;
+	sbi->s_mb_optimize_scan = 1;
+	sbi->s_mb_max_linear_groups = MB_DEFAULT_MAX_LINEAR_GROUPS;
 	/*
 	 * The default group preallocation is 512, which for 4k block
 	 * sizes translates to 2 megabytes.  However for bigalloc file
@@ -2669,6 +2925,12 @@ out_free_locality_groups:
 	free_percpu(sbi->s_locality_groups);
 	sbi->s_locality_groups = NULL;
 out:
+	free_percpu(sbi->s_mb_stream_goal);
+	sbi->s_mb_stream_goal = NULL;
+	kfree(sbi->s_mb_largest_free_orders);
+	sbi->s_mb_largest_free_orders = NULL;
+	kfree(sbi->s_mb_largest_free_orders_locks);
+	sbi->s_mb_largest_free_orders_locks = NULL;
 	kfree(sbi->s_mb_offsets);
 	sbi->s_mb_offsets = NULL;
 	kfree(sbi->s_mb_maxs);
@@ -2723,6 +2985,8 @@ int ext4_mb_release(struct super_block *sb)
 	}
 	kfree(sbi->s_mb_offsets);
 	kfree(sbi->s_mb_maxs);
+	kfree(sbi->s_mb_largest_free_orders);
+	kfree(sbi->s_mb_largest_free_orders_locks);
 	iput(sbi->s_buddy_cache);
 	if (sbi->s_mb_stats) {
 		ext4_msg(sb, KERN_INFO,
@@ -2749,6 +3013,7 @@ int ext4_mb_release(struct super_block *sb)
 	}
 
 	free_percpu(sbi->s_locality_groups);
+	free_percpu(sbi->s_mb_stream_goal);
 
 	return 0;
 }
@@ -3260,6 +3525,7 @@ static void ext4_mb_collect_stats(struct ext4_allocation_context *ac)
 		if (ac->ac_b_ex.fe_len >= ac->ac_o_ex.fe_len)
 			atomic_inc(&sbi->s_bal_success);
 		atomic_add(ac->ac_found, &sbi->s_bal_ex_scanned);
+		atomic_add(ac->ac_groups_scanned, &sbi->s_bal_groups_scanned);
 		if (ac->ac_g_ex.fe_start == ac->ac_b_ex.fe_start &&
 				ac->ac_g_ex.fe_group == ac->ac_b_ex.fe_group)
 			atomic_inc(&sbi->s_bal_goals);
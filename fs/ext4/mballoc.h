@@ -77,6 +77,28 @@ do {									\
  */
 #define MB_DEFAULT_GROUP_PREALLOC	512
 
+/*
+ * with mb_optimize_scan, this many groups following the goal are still
+ * scanned in order before the free extent order lists are consulted, to
+ * keep allocations close to the goal when that is cheap
+ */
+#define MB_DEFAULT_MAX_LINEAR_GROUPS	4
+
+/*
+ * Number of buddy orders, from single clusters up to a whole bitmap block
+ */
+#define MB_NUM_ORDERS(sb)		((sb)->s_blocksize_bits + 2)
+
+
+/*
+ * Where the last stream allocation on this CPU ended, so that the next one
+ * continues from there.  Per CPU, so that concurrent streaming writers
+ * neither bounce a global goal nor all pile into the same group.
+ */
+struct ext4_mb_stream_goal {
+	ext4_group_t			group;
+	ext4_grpblk_t			start;
+};
 
 struct ext4_free_data {
 	/* this links the free block information from sb_info */
@@ -162,6 +184,13 @@ struct ext4_allocation_context {
 	struct ext4_free_extent ac_f_ex;
 
 	__u16 ac_groups_scanned;
+	__u16 ac_groups_linear_remaining;
+	/* where the last group taken from the order lists came from */
+	struct ext4_group_info *ac_last_pick;
+	int ac_last_pick_order;
+	/* scan position for groups that still need their buddy generated */
+	ext4_group_t ac_uninit_next;
+	ext4_group_t ac_uninit_left;
 	__u16 ac_found;
 	__u16 ac_tail;
 	__u16 ac_buddy;
@@ -1443,6 +1443,8 @@ int f2fs_write_checkpoint(struct f2fs_sb_info *sbi, struct cp_control *cpc)
 	ckpt_ver = cur_cp_version(ckpt);
 	ckpt->checkpoint_ver = cpu_to_le64(++ckpt_ver);
 
+	f2fs_flush_stream_summaries(sbi);
+
 	/* write cached NAT/SIT entries to NAT/SIT area */
 	f2fs_flush_nat_entries(sbi, cpc);
 	f2fs_flush_sit_entries(sbi, cpc);
@@ -181,7 +181,8 @@ bool f2fs_need_SSR(struct f2fs_sb_info *sbi)
 		return true;
 
 	return free_sections(sbi) <= (node_secs + 2 * dent_secs + imeta_secs +
-			SM_I(sbi)->min_ssr_sections + reserved_sections(sbi));
+			SM_I(sbi)->min_ssr_sections + reserved_sections(sbi) +
+			stream_sections(sbi));
 }
 
 void f2fs_register_inmem_page(struct inode *inode, struct page *page)
@@ -2116,11 +2117,12 @@ skip_left:
 		if (go_left && zoneno == 0)
 			goto got_it;
 	}
-	for (i = 0; i < NR_CURSEG_TYPE; i++)
-		if (CURSEG_I(sbi, i)->zone == zoneno)
+	for (i = 0; i < NR_CURSEG(sbi); i++)
+		if (CURSEG_I(sbi, i)->segno != NULL_SEGNO &&
+				CURSEG_I(sbi, i)->zone == zoneno)
 			break;
 
-	if (i < NR_CURSEG_TYPE) {
+	if (i < NR_CURSEG(sbi)) {
 		/* zone is in user, try another */
 		if (go_left)
 			hint = zoneno * sbi->secs_per_zone - 1;
@@ -2151,21 +2153,23 @@ static void reset_curseg(struct f2fs_sb_info *sbi, int type, int modified)
 
 	sum_footer = &(curseg->sum_blk->footer);
 	memset(sum_footer, 0, sizeof(struct summary_footer));
-	if (IS_DATASEG(type))
+	if (IS_DATASEG(curseg->seg_type))
 		SET_SUM_TYPE(sum_footer, SUM_TYPE_DATA);
-	if (IS_NODESEG(type))
+	if (IS_NODESEG(curseg->seg_type))
 		SET_SUM_TYPE(sum_footer, SUM_TYPE_NODE);
-	__set_sit_entry_type(sbi, type, curseg->segno, modified);
+	__set_sit_entry_type(sbi, curseg->seg_type, curseg->segno, modified);
 }
 
 static unsigned int __get_next_segno(struct f2fs_sb_info *sbi, int type)
 {
+	int seg_type = CURSEG_I(sbi, type)->seg_type;
+
 	/* if segs_per_sec is large than 1, we need to keep original policy. */
 	if (sbi->segs_per_sec != 1)
 		return CURSEG_I(sbi, type)->segno;
 
 	if (test_opt(sbi, NOHEAP) &&
-		(type == CURSEG_HOT_DATA || IS_NODESEG(type)))
+		(seg_type == CURSEG_HOT_DATA || IS_NODESEG(seg_type)))
 		return 0;
 
 	if (SIT_I(sbi)->last_victim[ALLOC_NEXT])
@@ -2188,15 +2192,20 @@ static void new_curseg(struct f2fs_sb_info *sbi, int type, bool new_sec)
 	unsigned int segno = curseg->segno;
 	int dir = ALLOC_LEFT;
 
-	write_sum_page(sbi, curseg->sum_blk,
-				GET_SUM_BLOCK(sbi, segno));
-	if (type == CURSEG_WARM_DATA || type == CURSEG_COLD_DATA)
+	if (segno != NULL_SEGNO)
+		write_sum_page(sbi, curseg->sum_blk,
+					GET_SUM_BLOCK(sbi, segno));
+	if (curseg->seg_type == CURSEG_WARM_DATA ||
+			curseg->seg_type == CURSEG_COLD_DATA)
 		dir = ALLOC_RIGHT;
 
 	if (test_opt(sbi, NOHEAP))
 		dir = ALLOC_RIGHT;
 
 	segno = __get_next_segno(sbi, type);
+	/* a data stream opening its first segment starts near stream 0 */
+	if (segno == NULL_SEGNO)
+		segno = CURSEG_I(sbi, curseg->seg_type)->segno;
 	get_new_segment(sbi, &segno, new_sec, dir);
 	curseg->next_segno = segno;
 	reset_curseg(sbi, type, 1);
@@ -2274,6 +2283,9 @@ static int get_ssr_segment(struct f2fs_sb_info *sbi, int type)
 	int i, cnt;
 	bool reversed = false;
 
+	/* victims are picked by temperature, whichever stream asks */
+	type = curseg->seg_type;
+
 	/* f2fs_need_SSR() already forces to do this */
 	if (v_ops->get_victim(sbi, &segno, BG_GC, type, SSR)) {
 		curseg->next_segno = segno;
@@ -2352,6 +2364,26 @@ void f2fs_allocate_new_segments(struct f2fs_sb_info *sbi)
 	up_write(&SIT_I(sbi)->sentry_lock);
 }
 
+/*
+ * Only stream 0 of each log is recorded in the checkpoint, so write the
+ * summaries of the other data streams to the SSA, for the SIT and SSA on
+ * disk to agree about the segments they have open.
+ */
+void f2fs_flush_stream_summaries(struct f2fs_sb_info *sbi)
+{
+	int i;
+
+	for (i = NR_CURSEG_TYPE; i < NR_CURSEG(sbi); i++) {
+		struct curseg_info *curseg = CURSEG_I(sbi, i);
+
+		mutex_lock(&curseg->curseg_mutex);
+		if (curseg->segno != NULL_SEGNO)
+			write_sum_page(sbi, curseg->sum_blk,
+					GET_SUM_BLOCK(sbi, curseg->segno));
+		mutex_unlock(&curseg->curseg_mutex);
+	}
+}
+
 static const struct segment_allocation default_salloc_ops = {
 	.allocate_segment = allocate_segment_by_default,
 };
@@ -2692,19 +2724,50 @@ static int __get_segment_type(struct f2fs_io_info *fio)
 	return type;
 }
 
+/*
+ * With data_streams=N, data is written to N logs per temperature and the
+ * log is picked by the CPU the writer runs on, so writers on different
+ * CPUs stop queueing up on one curseg_mutex and fill segments of their
+ * own.  Stream 0 is the log recorded in the checkpoint, the others only
+ * live in memory: they open their first segment on first use and their
+ * summaries are written out by f2fs_flush_stream_summaries() at
+ * checkpoint time, so after a crash their segments are just dirty ones.
+ * Once free space gets tight enough for SSR, everything goes back to
+ * stream 0 so the extra logs don't eat the segments GC needs.
+ */
+static int __get_data_stream(struct f2fs_sb_info *sbi, int type)
+{
+	unsigned int streams = F2FS_OPTION(sbi).data_streams;
+	unsigned int stream;
+
+	if (streams <= 1 || !IS_DATASEG(type) || f2fs_need_SSR(sbi))
+		return type;
+
+	stream = raw_smp_processor_id() % streams;
+	if (!stream)
+		return type;
+	return CURSEG_STREAM(type, stream);
+}
+
 void f2fs_allocate_data_block(struct f2fs_sb_info *sbi, struct page *page,
 		block_t old_blkaddr, block_t *new_blkaddr,
 		struct f2fs_summary *sum, int type,
 		struct f2fs_io_info *fio, bool add_list)
 {
 	struct sit_info *sit_i = SIT_I(sbi);
-	struct curseg_info *curseg = CURSEG_I(sbi, type);
+	struct curseg_info *curseg;
+
+	type = __get_data_stream(sbi, type);
+	curseg = CURSEG_I(sbi, type);
 
 	down_read(&SM_I(sbi)->curseg_lock);
 
 	mutex_lock(&curseg->curseg_mutex);
 	down_write(&sit_i->sentry_lock);
 
+	if (unlikely(curseg->segno == NULL_SEGNO))
+		sit_i->s_ops->allocate_segment(sbi, type, true);
+
 	*new_blkaddr = NEXT_FREE_BLKADDR(sbi, curseg);
 
 	f2fs_wait_discard_bio(sbi, *new_blkaddr);
@@ -2889,11 +2952,11 @@ static inline int __f2fs_get_curseg(struct f2fs_sb_info *sbi,
 {
 	int i;
 
-	for (i = CURSEG_HOT_DATA; i < NO_CHECK_TYPE; i++) {
+	for (i = 0; i < NR_CURSEG(sbi); i++) {
 		if (CURSEG_I(sbi, i)->segno == segno)
-			break;
+			return i;
 	}
-	return i;
+	return -1;
 }
 
 void f2fs_do_replace_block(struct f2fs_sb_info *sbi, struct f2fs_summary *sum,
@@ -2920,19 +2983,22 @@ void f2fs_do_replace_block(struct f2fs_sb_info *sbi, struct f2fs_summary *sum,
 				type = CURSEG_COLD_DATA;
 			else
 				type = CURSEG_WARM_DATA;
+		} else if (IS_CURSEG(sbi, segno)) {
+			/* the segment may be open in another data stream */
+			type = __f2fs_get_curseg(sbi, segno);
 		}
 	} else {
 		if (IS_CURSEG(sbi, segno)) {
 			/* se->type is volatile as SSR allocation */
 			type = __f2fs_get_curseg(sbi, segno);
-			f2fs_bug_on(sbi, type == NO_CHECK_TYPE);
+			f2fs_bug_on(sbi, type < 0);
 		} else {
 			type = CURSEG_WARM_DATA;
 		}
 	}
 
-	f2fs_bug_on(sbi, !IS_DATASEG(type));
 	curseg = CURSEG_I(sbi, type);
+	f2fs_bug_on(sbi, !IS_DATASEG(curseg->seg_type));
 
 	mutex_lock(&curseg->curseg_mutex);
 	down_write(&sit_i->sentry_lock);
@@ -3653,14 +3719,14 @@ static int build_curseg(struct f2fs_sb_info *sbi)
 	struct curseg_info *array;
 	int i;
 
-	array = f2fs_kzalloc(sbi, array_size(NR_CURSEG_TYPE, sizeof(*array)),
+	array = f2fs_kzalloc(sbi, array_size(NR_CURSEG(sbi), sizeof(*array)),
 			     GFP_KERNEL);
 	if (!array)
 		return -ENOMEM;
 
 	SM_I(sbi)->curseg_array = array;
 
-	for (i = 0; i < NR_CURSEG_TYPE; i++) {
+	for (i = 0; i < NR_CURSEG(sbi); i++) {
 		mutex_init(&array[i].curseg_mutex);
 		array[i].sum_blk = f2fs_kzalloc(sbi, PAGE_SIZE, GFP_KERNEL);
 		if (!array[i].sum_blk)
@@ -3672,6 +3738,8 @@ static int build_curseg(struct f2fs_sb_info *sbi)
 			return -ENOMEM;
 		array[i].segno = NULL_SEGNO;
 		array[i].next_blkoff = 0;
+		array[i].seg_type = i < NR_CURSEG_TYPE ? i :
+				(i - NR_CURSEG_TYPE) % NR_CURSEG_DATA_TYPE;
 	}
 	return restore_curseg_summaries(sbi);
 }
@@ -4020,7 +4088,7 @@ static void destroy_curseg(struct f2fs_sb_info *sbi)
 	if (!array)
 		return;
 	SM_I(sbi)->curseg_array = NULL;
-	for (i = 0; i < NR_CURSEG_TYPE; i++) {
+	for (i = 0; i < NR_CURSEG(sbi); i++) {
 		kfree(array[i].sum_blk);
 		kfree(array[i].journal);
 	}
@@ -31,27 +31,17 @@
 #define IS_WARM(t)	((t) == CURSEG_WARM_NODE || (t) == CURSEG_WARM_DATA)
 #define IS_COLD(t)	((t) == CURSEG_COLD_NODE || (t) == CURSEG_COLD_DATA)
 
-#define IS_CURSEG(sbi, seg)						\
-	(((seg) == CURSEG_I(sbi, CURSEG_HOT_DATA)->segno) ||	\
-	 ((seg) == CURSEG_I(sbi, CURSEG_WARM_DATA)->segno) ||	\
-	 ((seg) == CURSEG_I(sbi, CURSEG_COLD_DATA)->segno) ||	\
-	 ((seg) == CURSEG_I(sbi, CURSEG_HOT_NODE)->segno) ||	\
-	 ((seg) == CURSEG_I(sbi, CURSEG_WARM_NODE)->segno) ||	\
-	 ((seg) == CURSEG_I(sbi, CURSEG_COLD_NODE)->segno))
-
-#define IS_CURSEC(sbi, secno)						\
-	(((secno) == CURSEG_I(sbi, CURSEG_HOT_DATA)->segno /		\
-	  (sbi)->segs_per_sec) ||	\
-	 ((secno) == CURSEG_I(sbi, CURSEG_WARM_DATA)->segno /		\
-	  (sbi)->segs_per_sec) ||	\
-	 ((secno) == CURSEG_I(sbi, CURSEG_COLD_DATA)->segno /		\
-	  (sbi)->segs_per_sec) ||	\
-	 ((secno) == CURSEG_I(sbi, CURSEG_HOT_NODE)->segno /		\
-	  (sbi)->segs_per_sec) ||	\
-	 ((secno) == CURSEG_I(sbi, CURSEG_WARM_NODE)->segno /		\
-	  (sbi)->segs_per_sec) ||	\
-	 ((secno) == CURSEG_I(sbi, CURSEG_COLD_NODE)->segno /		\
-	  (sbi)->segs_per_sec))	\
+/* # of logs, including the extra data streams */
+#define NR_CURSEG(sbi)							\
+	(NR_CURSEG_TYPE +						\
+	 NR_CURSEG_DATA_TYPE * (F2FS_OPTION(sbi).data_streams - 1))
+
+/* log of data temperature @type in extra stream @stream (>= 1) */
+#define CURSEG_STREAM(type, stream)					\
+	(NR_CURSEG_TYPE + ((stream) - 1) * NR_CURSEG_DATA_TYPE + (type))
+
+#define IS_CURSEG(sbi, seg)	f2fs_is_curseg(sbi, seg)
+#define IS_CURSEC(sbi, secno)	f2fs_is_cursec(sbi, secno)
 
 #define MAIN_BLKADDR(sbi)						\
 	(SM_I(sbi) ? SM_I(sbi)->main_blkaddr : 				\
@@ -295,6 +285,7 @@ struct curseg_info {
 	struct rw_semaphore journal_rwsem;	/* protect journal area */
 	struct f2fs_journal *journal;		/* cached journal info */
 	unsigned char alloc_type;		/* current allocation type */
+	unsigned char seg_type;			/* CURSEG_XXX_TYPE of the log */
 	unsigned int segno;			/* current segment number */
 	unsigned short next_blkoff;		/* next block offset to write */
 	unsigned int zone;			/* current zone number */
@@ -315,6 +306,32 @@ static inline struct curseg_info *CURSEG_I(struct f2fs_sb_info *sbi, int type)
 	return (struct curseg_info *)(SM_I(sbi)->curseg_array + type);
 }
 
+static inline bool f2fs_is_curseg(struct f2fs_sb_info *sbi,
+						unsigned int segno)
+{
+	int i;
+
+	for (i = 0; i < NR_CURSEG(sbi); i++)
+		if (CURSEG_I(sbi, i)->segno == segno)
+			return true;
+	return false;
+}
+
+static inline bool f2fs_is_cursec(struct f2fs_sb_info *sbi,
+						unsigned int secno)
+{
+	int i;
+
+	for (i = 0; i < NR_CURSEG(sbi); i++) {
+		unsigned int segno = CURSEG_I(sbi, i)->segno;
+
+		/* data streams that were never used have no segment yet */
+		if (segno != NULL_SEGNO && secno == segno / sbi->segs_per_sec)
+			return true;
+	}
+	return false;
+}
+
 static inline struct seg_entry *get_seg_entry(struct f2fs_sb_info *sbi,
 						unsigned int segno)
 {
@@ -534,6 +551,12 @@ static inline int reserved_sections(struct f2fs_sb_info *sbi)
 	return GET_SEC_FROM_SEG(sbi, (unsigned int)reserved_segments(sbi));
 }
 
+/* each extra data stream may open a new section of its own at any time */
+static inline int stream_sections(struct f2fs_sb_info *sbi)
+{
+	return NR_CURSEG(sbi) - NR_CURSEG_TYPE;
+}
+
 static inline bool has_curseg_enough_space(struct f2fs_sb_info *sbi)
 {
 	unsigned int node_blocks = get_pages(sbi, F2FS_DIRTY_NODES) +
@@ -576,7 +599,7 @@ static inline bool has_not_enough_free_secs(struct f2fs_sb_info *sbi,
 		return false;
 	return (free_sections(sbi) + freed) <=
 		(node_secs + 2 * dent_secs + imeta_secs +
-		reserved_sections(sbi) + needed);
+		reserved_sections(sbi) + stream_sections(sbi) + needed);
 }
 
 static inline bool excess_prefree_segs(struct f2fs_sb_info *sbi)
@@ -92,6 +92,7 @@ enum {
 	Opt_acl,
 	Opt_noacl,
 	Opt_active_logs,
+	Opt_data_streams,
 	Opt_disable_ext_identify,
 	Opt_inline_xattr,
 	Opt_noinline_xattr,
@@ -149,6 +150,7 @@ static match_table_t f2fs_tokens = {
 	{Opt_acl, "acl"},
 	{Opt_noacl, "noacl"},
 	{Opt_active_logs, "active_logs=%u"},
+	{Opt_data_streams, "data_streams=%u"},
 	{Opt_disable_ext_identify, "disable_ext_identify"},
 	{Opt_inline_xattr, "inline_xattr"},
 	{Opt_noinline_xattr, "noinline_xattr"},
@@ -497,6 +499,13 @@ static int parse_options(struct super_block *sb, char *options)
 				return -EINVAL;
 			F2FS_OPTION(sbi).active_logs = arg;
 			break;
+		case Opt_data_streams:
+			if (args->from && match_int(args, &arg))
+				return -EINVAL;
+			if (arg < 1 || arg > F2FS_MAX_DATA_STREAMS)
+				return -EINVAL;
+			F2FS_OPTION(sbi).data_streams = arg;
+			break;
 		case Opt_disable_ext_identify:
 			set_opt(sbi, DISABLE_EXT_IDENTIFY);
 			break;
@@ -810,6 +819,13 @@ static int parse_options(struct super_block *sb, char *options)
 		}
 	}
 
+	/* the extra data streams can't keep LFS mode's write order */
+	if (F2FS_OPTION(sbi).data_streams > 1 && test_opt(sbi, LFS)) {
+		f2fs_msg(sb, KERN_ERR,
+			"data_streams is not allowed with mode=lfs");
+		return -EINVAL;
+	}
+
 	/* Not pass down write hints if the number of active logs is lesser
 	 * than NR_CURSEG_TYPE.
 	 */
@@ -1300,6 +1316,9 @@ static int f2fs_show_options(struct seq_file *seq, struct dentry *root)
 	else if (test_opt(sbi, LFS))
 		seq_puts(seq, "lfs");
 	seq_printf(seq, ",active_logs=%u", F2FS_OPTION(sbi).active_logs);
+	if (F2FS_OPTION(sbi).data_streams > 1)
+		seq_printf(seq, ",data_streams=%u",
+				F2FS_OPTION(sbi).data_streams);
 	if (test_opt(sbi, RESERVE_ROOT))
 		seq_printf(seq, ",reserve_root=%u,resuid=%u,resgid=%u",
 				F2FS_OPTION(sbi).root_reserved_blocks,
@@ -1350,6 +1369,7 @@ static void default_options(struct f2fs_sb_info *sbi)
 {
 	/* init some FS parameters */
 	F2FS_OPTION(sbi).active_logs = NR_CURSEG_TYPE;
+	F2FS_OPTION(sbi).data_streams = 1;
 	F2FS_OPTION(sbi).inline_xattr_size = DEFAULT_INLINE_XATTR_ADDRS;
 	F2FS_OPTION(sbi).whint_mode = WHINT_MODE_OFF;
 	F2FS_OPTION(sbi).alloc_mode = ALLOC_MODE_DEFAULT;
@@ -1435,6 +1455,8 @@ static int f2fs_remount(struct super_block *sb, int *flags, char *data)
 	}
 
 	default_options(sbi);
+	/* the logs are set up at mount time, keep them unless asked again */
+	F2FS_OPTION(sbi).data_streams = org_mount_opt.data_streams;
 
 	/* parse mount options */
 	err = parse_options(sb, data);
@@ -1473,6 +1495,15 @@ static int f2fs_remount(struct super_block *sb, int *flags, char *data)
 		goto restore_opts;
 	}
 
+	/* disallow changing data_streams dynamically */
+	if (F2FS_OPTION(sbi).data_streams !=
+			org_mount_opt.data_streams) {
+		err = -EINVAL;
+		f2fs_msg(sbi->sb, KERN_WARNING,
+				"switch data_streams option is not allowed");
+		goto restore_opts;
+	}
+
 	/*
 	 * We stop the GC thread if FS is mounted as RO
 	 * or if background_gc = off is passed in mount
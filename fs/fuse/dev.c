@@ -12,6 +12,8 @@
 #include <linux/module.h>
 #include <linux/poll.h>
 #include <linux/sched/signal.h>
+#include <linux/sched/clock.h>
+#include <linux/sched/user.h>
 #include <linux/uio.h>
 #include <linux/miscdevice.h>
 #include <linux/pagemap.h>
@@ -21,6 +23,7 @@
 #include <linux/swap.h>
 #include <linux/splice.h>
 #include <linux/sched.h>
+#include <linux/vmalloc.h>
 
 MODULE_ALIAS_MISCDEV(FUSE_MINOR);
 MODULE_ALIAS("devname:fuse");
@@ -1228,7 +1231,7 @@ __releases(fiq->waitq.lock)
  * request_end().  Otherwise add it to the processing list, and set
  * the 'sent' flag.
  */
-static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
+static ssize_t fuse_dev_do_read(struct fuse_dev *fud, bool nonblock,
 				struct fuse_copy_state *cs, size_t nbytes)
 {
 	ssize_t err;
@@ -1242,8 +1245,7 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
  restart:
 	spin_lock(&fiq->waitq.lock);
 	err = -EAGAIN;
-	if ((file->f_flags & O_NONBLOCK) && fiq->connected &&
-	    !request_pending(fiq))
+	if (nonblock && fiq->connected && !request_pending(fiq))
 		goto err_unlock;
 
 	err = wait_event_interruptible_exclusive_locked(fiq->waitq,
@@ -1357,7 +1359,8 @@ static ssize_t fuse_dev_read(struct kiocb *iocb, struct iov_iter *to)
 
 	fuse_copy_init(&cs, 1, to);
 
-	return fuse_dev_do_read(fud, file, &cs, iov_iter_count(to));
+	return fuse_dev_do_read(fud, file->f_flags & O_NONBLOCK, &cs,
+				iov_iter_count(to));
 }
 
 static ssize_t fuse_dev_splice_read(struct file *in, loff_t *ppos,
@@ -1381,7 +1384,7 @@ static ssize_t fuse_dev_splice_read(struct file *in, loff_t *ppos,
 	fuse_copy_init(&cs, 1, NULL);
 	cs.pipebufs = bufs;
 	cs.pipe = pipe;
-	ret = fuse_dev_do_read(fud, in, &cs, len);
+	ret = fuse_dev_do_read(fud, in->f_flags & O_NONBLOCK, &cs, len);
 	if (ret < 0)
 		goto out;
 
@@ -1675,7 +1678,7 @@ static int fuse_retrieve(struct fuse_conn *fc, struct inode *inode,
 		num = file_size - outarg->offset;
 
 	num_pages = (num + offset + PAGE_SIZE - 1) >> PAGE_SHIFT;
-	num_pages = min(num_pages, FUSE_MAX_PAGES_PER_REQ);
+	num_pages = min(num_pages, fc->max_pages);
 
 	req = fuse_get_req(fc, num_pages);
 	if (IS_ERR(req))
@@ -2216,11 +2219,303 @@ static int fuse_device_clone(struct fuse_conn *fc, struct file *new)
 	return 0;
 }
 
+/*
+ * Shared memory request ring
+ *
+ * The slots live in one vmalloc_user() area that the daemon maps.  Every
+ * slot is also described by an array of bio_vecs, so that requests and
+ * replies go through the same fuse_copy_state code as read() and write()
+ * on the device, only with a bvec iterator instead of user iovecs.
+ */
+struct fuse_ring {
+	/** Serializes FUSE_DEV_IOC_RING_ENTER */
+	struct mutex lock;
+
+	/** Slots holding a request the daemon hasn't replied to yet */
+	u64 busy;
+
+	unsigned int nr_slots;
+	unsigned int slot_size;
+	unsigned int npages;
+	void *buf;
+
+	/** Connection and user charged for the pages */
+	struct fuse_conn *fc;
+	struct user_struct *user;
+
+	/** nr_slots * (slot_size >> PAGE_SHIFT) entries */
+	struct bio_vec *bvecs;
+};
+
+/* Longest time FUSE_DEV_IOC_RING_ENTER spins before going to sleep */
+#define FUSE_RING_MAX_POLL_US	1000
+
+/* Most pages the rings of all devices of one connection may take */
+#define FUSE_RING_MAX_CONN_PAGES	((4 * FUSE_RING_MAX_SIZE) >> PAGE_SHIFT)
+
+/*
+ * The ring pages are pinned for as long as the device is open, so charge
+ * them to the connection and to RLIMIT_MEMLOCK of the daemon's user, the
+ * way other long term pinned user mappings are.
+ */
+static int fuse_ring_charge(struct fuse_conn *fc, struct fuse_ring *ring)
+{
+	unsigned long limit = rlimit(RLIMIT_MEMLOCK) >> PAGE_SHIFT;
+	struct user_struct *user;
+	int err = -ENOMEM;
+
+	spin_lock(&fc->lock);
+	if (fc->ring_pages + ring->npages <= FUSE_RING_MAX_CONN_PAGES) {
+		fc->ring_pages += ring->npages;
+		ring->fc = fc;
+		err = 0;
+	}
+	spin_unlock(&fc->lock);
+	if (err || capable(CAP_IPC_LOCK))
+		return err;
+
+	user = get_uid(current_user());
+	if (atomic_long_add_return(ring->npages, &user->locked_vm) > limit) {
+		atomic_long_sub(ring->npages, &user->locked_vm);
+		free_uid(user);
+		return -ENOMEM;
+	}
+	ring->user = user;
+	return 0;
+}
+
+void fuse_ring_free(struct fuse_ring *ring)
+{
+	if (ring) {
+		if (ring->user) {
+			atomic_long_sub(ring->npages, &ring->user->locked_vm);
+			free_uid(ring->user);
+		}
+		if (ring->fc) {
+			spin_lock(&ring->fc->lock);
+			ring->fc->ring_pages -= ring->npages;
+			spin_unlock(&ring->fc->lock);
+		}
+		kvfree(ring->bvecs);
+		vfree(ring->buf);
+		kfree(ring);
+	}
+}
+EXPORT_SYMBOL_GPL(fuse_ring_free);
+
+static int fuse_ring_setup(struct fuse_dev *fud,
+			   struct fuse_ring_setup __user *uarg)
+{
+	struct fuse_conn *fc = fud->fc;
+	struct fuse_ring_setup arg;
+	struct fuse_ring *ring;
+	unsigned int npages, i;
+	int err;
+
+	if (!fc->ring)
+		return -EOPNOTSUPP;
+	if (copy_from_user(&arg, uarg, sizeof(arg)))
+		return -EFAULT;
+	/* a slot must hold the largest request, as the read() buffer must */
+	if (arg.flags || !arg.nr_slots || arg.nr_slots > FUSE_RING_MAX_SLOTS ||
+	    arg.slot_size < FUSE_MIN_READ_BUFFER ||
+	    arg.slot_size < sizeof(struct fuse_in_header) +
+			    sizeof(struct fuse_write_in) + fc->max_write ||
+	    !PAGE_ALIGNED(arg.slot_size) ||
+	    arg.slot_size > FUSE_RING_MAX_SIZE / arg.nr_slots)
+		return -EINVAL;
+
+	err = -ENOMEM;
+	ring = kzalloc(sizeof(*ring), GFP_KERNEL);
+	if (!ring)
+		return err;
+	mutex_init(&ring->lock);
+	ring->nr_slots = arg.nr_slots;
+	ring->slot_size = arg.slot_size;
+
+	npages = (arg.nr_slots * arg.slot_size) >> PAGE_SHIFT;
+	ring->npages = npages;
+	err = fuse_ring_charge(fc, ring);
+	if (err)
+		goto out_free;
+
+	err = -ENOMEM;
+	ring->buf = vmalloc_user(npages << PAGE_SHIFT);
+	ring->bvecs = kvmalloc_array(npages, sizeof(struct bio_vec),
+				     GFP_KERNEL);
+	if (!ring->buf || !ring->bvecs)
+		goto out_free;
+	for (i = 0; i < npages; i++) {
+		ring->bvecs[i].bv_page =
+			vmalloc_to_page(ring->buf + (i << PAGE_SHIFT));
+		ring->bvecs[i].bv_len = PAGE_SIZE;
+		ring->bvecs[i].bv_offset = 0;
+	}
+
+	/* pairs with smp_load_acquire() in fuse_get_ring() */
+	err = -EBUSY;
+	if (cmpxchg_release(&fud->ring, NULL, ring) == NULL)
+		return 0;
+out_free:
+	fuse_ring_free(ring);
+	return err;
+}
+
+static struct fuse_ring *fuse_get_ring(struct fuse_dev *fud)
+{
+	return smp_load_acquire(&fud->ring);
+}
+
+static void fuse_ring_iter(struct fuse_ring *ring, struct iov_iter *iter,
+			   int dir, unsigned int slot, size_t count)
+{
+	unsigned int slot_pages = ring->slot_size >> PAGE_SHIFT;
+
+	iov_iter_bvec(iter, ITER_BVEC | dir, ring->bvecs + slot * slot_pages,
+		      slot_pages, count);
+}
+
+/* Hand the reply in @slot to the request it answers */
+static int fuse_ring_commit(struct fuse_dev *fud, struct fuse_ring *ring,
+			    unsigned int slot)
+{
+	struct fuse_out_header *oh = ring->buf + slot * ring->slot_size;
+	struct fuse_copy_state cs;
+	struct iov_iter iter;
+	u32 len = READ_ONCE(oh->len);
+	ssize_t ret;
+
+	if (!len)
+		return 0;
+	if (len > ring->slot_size)
+		return -EINVAL;
+
+	fuse_ring_iter(ring, &iter, WRITE, slot, len);
+	fuse_copy_init(&cs, 0, &iter);
+	ret = fuse_dev_do_write(fud, &cs, len);
+	return ret < 0 ? ret : 0;
+}
+
+/* Spin for a while in the hope that a request shows up */
+static void fuse_ring_poll(struct fuse_iqueue *fiq, unsigned int poll_us)
+{
+	u64 end = local_clock() +
+		  min_t(u32, poll_us, FUSE_RING_MAX_POLL_US) * NSEC_PER_USEC;
+
+	while (READ_ONCE(fiq->connected) && !request_pending(fiq)) {
+		if (need_resched() || signal_pending(current) ||
+		    local_clock() > end)
+			break;
+		cpu_relax();
+	}
+}
+
+static int fuse_ring_enter(struct fuse_dev *fud,
+			   struct fuse_ring_enter __user *uarg)
+{
+	struct fuse_ring *ring = fuse_get_ring(fud);
+	struct fuse_ring_enter arg;
+	struct fuse_copy_state cs;
+	struct iov_iter iter;
+	unsigned int slot;
+	bool wait;
+	u64 ready = 0;
+	ssize_t ret;
+	int err = 0;
+
+	if (!ring)
+		return -EINVAL;
+	if (copy_from_user(&arg, uarg, sizeof(arg)))
+		return -EFAULT;
+	if (arg.flags & ~FUSE_RING_ENTER_WAIT)
+		return -EINVAL;
+
+	mutex_lock(&ring->lock);
+	if (arg.commit & ~ring->busy) {
+		err = -EINVAL;
+		goto out_unlock;
+	}
+	for (slot = 0; slot < ring->nr_slots; slot++) {
+		if (!(arg.commit & BIT_ULL(slot)))
+			continue;
+		ring->busy &= ~BIT_ULL(slot);
+		ret = fuse_ring_commit(fud, ring, slot);
+		if (ret && !err)
+			err = ret;
+	}
+	if (err)
+		goto out_unlock;
+
+	wait = arg.flags & FUSE_RING_ENTER_WAIT;
+	if (wait && arg.poll_us)
+		fuse_ring_poll(&fud->fc->iq, arg.poll_us);
+
+	/* only wait for the first request, then take what is queued */
+	for (slot = 0; slot < ring->nr_slots; slot++) {
+		if (ring->busy & BIT_ULL(slot))
+			continue;
+
+		fuse_ring_iter(ring, &iter, READ, slot, ring->slot_size);
+		fuse_copy_init(&cs, 1, &iter);
+		ret = fuse_dev_do_read(fud, !wait || ready, &cs,
+				       ring->slot_size);
+		if (ret < 0) {
+			if (!ready && ret != -EAGAIN)
+				err = ret == -ERESTARTSYS ? -EINTR : ret;
+			break;
+		}
+		ring->busy |= BIT_ULL(slot);
+		ready |= BIT_ULL(slot);
+	}
+out_unlock:
+	mutex_unlock(&ring->lock);
+	if (err)
+		return err;
+
+	return put_user(ready, &uarg->ready);
+}
+
+static int fuse_dev_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_dev *fud = fuse_get_dev(file);
+	struct fuse_ring *ring;
+
+	if (!fud)
+		return -EPERM;
+	ring = fuse_get_ring(fud);
+	if (!ring)
+		return -EINVAL;
+
+	return remap_vmalloc_range(vma, ring->buf, vma->vm_pgoff);
+}
+
 static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
 			   unsigned long arg)
 {
 	int err = -ENOTTY;
 
+	if (cmd == FUSE_DEV_IOC_RING_SETUP || cmd == FUSE_DEV_IOC_RING_ENTER) {
+		struct fuse_dev *fud = fuse_get_dev(file);
+
+		/* CUSE shares this handler, but never negotiates FUSE_RING */
+		if (!fud)
+			return -EPERM;
+		if (cmd == FUSE_DEV_IOC_RING_SETUP)
+			return fuse_ring_setup(fud, (void __user *) arg);
+		return fuse_ring_enter(fud, (void __user *) arg);
+	}
+
+	if (cmd == FUSE_DEV_IOC_PASSTHROUGH_OPEN) {
+		struct fuse_dev *fud = fuse_get_dev(file);
+		u32 fd;
+
+		if (!fud)
+			return -EPERM;
+		if (get_user(fd, (__u32 __user *) arg))
+			return -EFAULT;
+		return fuse_passthrough_open(fud, fd);
+	}
+
 	if (cmd == FUSE_DEV_IOC_CLONE) {
 		int oldfd;
 
@@ -2265,6 +2560,7 @@ const struct file_operations fuse_dev_operations = {
 	.fasync		= fuse_dev_fasync,
 	.unlocked_ioctl = fuse_dev_ioctl,
 	.compat_ioctl   = fuse_dev_ioctl,
+	.mmap		= fuse_dev_mmap,
 };
 EXPORT_SYMBOL_GPL(fuse_dev_operations);
 
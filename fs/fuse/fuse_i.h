@@ -27,9 +27,18 @@
 #include <linux/pid_namespace.h>
 #include <linux/refcount.h>
 #include <linux/user_namespace.h>
+#include <linux/idr.h>
+#include <linux/cred.h>
+#include <linux/sizes.h>
 
-/** Max number of pages that can be used in a single read request */
-#define FUSE_MAX_PAGES_PER_REQ 32
+/** Default max number of pages that can be used in a single read request */
+#define FUSE_DEFAULT_MAX_PAGES_PER_REQ 32
+
+/** Upper limit for the max_pages the daemon may ask for in INIT */
+#define FUSE_MAX_MAX_PAGES (SZ_4M >> PAGE_SHIFT)
+
+/** Readahead may keep this many requests of max_pages in flight */
+#define FUSE_MAX_READAHEAD_REQS 4
 
 /** Bias for fi->writectr, meaning new writepages must not be sent */
 #define FUSE_NOWRITE INT_MIN
@@ -122,6 +131,15 @@ enum {
 
 struct fuse_conn;
 
+/** Backing file of a passthrough open */
+struct fuse_passthrough {
+	/** Backing file, NULL if passthrough is not in use */
+	struct file *filp;
+
+	/** Credentials of the daemon, used for I/O on filp */
+	const struct cred *cred;
+};
+
 /** FUSE specific file data */
 struct fuse_file {
 	/** Fuse connection for this file */
@@ -156,6 +174,9 @@ struct fuse_file {
 
 	/** Has flock been performed on this file? */
 	bool flock:1;
+
+	/** Backing file for FOPEN_PASSTHROUGH */
+	struct fuse_passthrough passthrough;
 };
 
 /** One input argument of a request */
@@ -435,6 +456,9 @@ struct fuse_dev {
 	/** Processing queue */
 	struct fuse_pqueue pq;
 
+	/** Shared memory request ring, if set up */
+	struct fuse_ring *ring;
+
 	/** list entry on fc->devices */
 	struct list_head entry;
 };
@@ -476,6 +500,9 @@ struct fuse_conn {
 	/** Maximum write size */
 	unsigned max_write;
 
+	/** Maximum number of pages that can be used in a single request */
+	unsigned int max_pages;
+
 	/** Input queue */
 	struct fuse_iqueue iq;
 
@@ -485,6 +512,15 @@ struct fuse_conn {
 	/** rbtree of fuse_files waiting for poll events indexed by ph */
 	struct rb_root polled_files;
 
+	/** Backing files registered for passthrough, not yet opened */
+	struct idr passthrough_req;
+
+	/** Number of entries in passthrough_req, under lock */
+	unsigned passthrough_pending;
+
+	/** Pages of all request rings of the devices, under lock */
+	unsigned long ring_pages;
+
 	/** Maximum number of outstanding background requests */
 	unsigned max_background;
 
@@ -536,6 +572,12 @@ struct fuse_conn {
 	/** Return an unique read error after abort.  Only set in INIT */
 	unsigned abort_err:1;
 
+	/** May the daemon set up request rings?  Only set in INIT */
+	unsigned ring:1;
+
+	/** May opens be backed by files of the daemon?  Only set in INIT */
+	unsigned passthrough:1;
+
 	/** Do not send separate SETATTR request before open(O_TRUNC)  */
 	unsigned atomic_o_trunc:1;
 
@@ -891,6 +933,24 @@ void fuse_conn_put(struct fuse_conn *fc);
 struct fuse_dev *fuse_dev_alloc(struct fuse_conn *fc);
 void fuse_dev_free(struct fuse_dev *fud);
 
+/**
+ * Free the request ring of a device
+ */
+void fuse_ring_free(struct fuse_ring *ring);
+
+/**
+ * Passthrough to backing files
+ */
+int fuse_passthrough_open(struct fuse_dev *fud, u32 fd);
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_file *ff,
+			    struct fuse_open_out *openarg);
+void fuse_passthrough_release(struct fuse_passthrough *passthrough);
+void fuse_passthrough_free_all(struct fuse_conn *fc);
+ssize_t fuse_passthrough_read_iter(struct kiocb *iocb, struct iov_iter *to);
+ssize_t fuse_passthrough_write_iter(struct kiocb *iocb,
+				    struct iov_iter *from);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+
 /**
  * Add connection to control filesystem
  */
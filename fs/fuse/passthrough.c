@@ -0,0 +1,273 @@
+/*
+ * FUSE: Filesystem in Userspace
+ *
+ * Passthrough of read, write and mmap to a backing file of the daemon.
+ *
+ * This program can be distributed under the terms of the GNU GPL.
+ * See the file COPYING.
+ */
+
+#include "fuse_i.h"
+
+#include <linux/file.h>
+#include <linux/uio.h>
+
+/* Most backing files registered, but not yet opened, per connection */
+#define FUSE_PASSTHROUGH_MAX_PENDING	1024
+
+/*
+ * Register a backing file for a later OPEN or CREATE reply.  Returns the
+ * handle to put into fuse_open_out.passthrough_fh.
+ *
+ * I/O on the backing file is done with the daemon's credentials, but
+ * on behalf of whoever opened the FUSE file, so this is restricted to
+ * daemons that could mount the backing filesystem themselves.
+ */
+int fuse_passthrough_open(struct fuse_dev *fud, u32 fd)
+{
+	struct fuse_conn *fc = fud->fc;
+	struct fuse_passthrough *fp;
+	struct file *filp;
+	int id;
+
+	if (!fc->passthrough || !capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	filp = fget(fd);
+	if (!filp)
+		return -EBADF;
+
+	id = -EINVAL;
+	if (!S_ISREG(file_inode(filp)->i_mode) ||
+	    !filp->f_op->read_iter || !filp->f_op->write_iter)
+		goto out_fput;
+
+	/*
+	 * Don't pass through to overlayfs, ecryptfs or another passthrough
+	 * FUSE mount, so stacking can't exhaust the kernel stack.
+	 */
+	id = -ELOOP;
+	if (file_inode(filp)->i_sb->s_stack_depth)
+		goto out_fput;
+
+	id = -ENOMEM;
+	fp = kmalloc(sizeof(*fp), GFP_KERNEL);
+	if (!fp)
+		goto out_fput;
+	fp->filp = filp;
+	fp->cred = get_current_cred();
+
+	idr_preload(GFP_KERNEL);
+	spin_lock(&fc->lock);
+	id = -EMFILE;
+	if (fc->passthrough_pending < FUSE_PASSTHROUGH_MAX_PENDING)
+		id = idr_alloc(&fc->passthrough_req, fp, 1, 0, GFP_ATOMIC);
+	if (id > 0)
+		fc->passthrough_pending++;
+	spin_unlock(&fc->lock);
+	idr_preload_end();
+	if (id > 0)
+		return id;
+
+	fuse_passthrough_release(fp);
+	kfree(fp);
+	return id;
+
+out_fput:
+	fput(filp);
+	return id;
+}
+
+/*
+ * Attach the backing file named in an OPEN or CREATE reply to the new
+ * fuse_file.  Unknown handles are ignored and the file is served by the
+ * daemon as usual.
+ */
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_file *ff,
+			    struct fuse_open_out *openarg)
+{
+	struct fuse_passthrough *fp;
+
+	ff->open_flags &= ~FOPEN_PASSTHROUGH;
+	if (!fc->passthrough || !openarg->passthrough_fh)
+		return;
+
+	spin_lock(&fc->lock);
+	fp = idr_remove(&fc->passthrough_req, openarg->passthrough_fh);
+	if (fp)
+		fc->passthrough_pending--;
+	spin_unlock(&fc->lock);
+	if (!fp)
+		return;
+
+	ff->passthrough = *fp;
+	kfree(fp);
+
+	/* Any caching is up to the backing file */
+	ff->open_flags |= FOPEN_PASSTHROUGH;
+	ff->open_flags &= ~FOPEN_DIRECT_IO;
+}
+
+void fuse_passthrough_release(struct fuse_passthrough *passthrough)
+{
+	if (passthrough->filp) {
+		fput(passthrough->filp);
+		put_cred(passthrough->cred);
+		passthrough->filp = NULL;
+		passthrough->cred = NULL;
+	}
+}
+
+/* Drop backing files that were registered, but never opened */
+void fuse_passthrough_free_all(struct fuse_conn *fc)
+{
+	struct fuse_passthrough *fp;
+	int id;
+
+	idr_for_each_entry(&fc->passthrough_req, fp, id) {
+		fuse_passthrough_release(fp);
+		kfree(fp);
+	}
+	idr_destroy(&fc->passthrough_req);
+}
+
+static rwf_t fuse_iocb_to_rwf(struct kiocb *iocb)
+{
+	int ifl = iocb->ki_flags;
+	rwf_t flags = 0;
+
+	if (ifl & IOCB_NOWAIT)
+		flags |= RWF_NOWAIT;
+	if (ifl & IOCB_HIPRI)
+		flags |= RWF_HIPRI;
+	if (ifl & IOCB_DSYNC)
+		flags |= RWF_DSYNC;
+	if (ifl & IOCB_SYNC)
+		flags |= RWF_SYNC;
+	if (ifl & IOCB_APPEND)
+		flags |= RWF_APPEND;
+
+	return flags;
+}
+
+/*
+ * Set up a synchronous kiocb for the backing file that carries the flags
+ * of @iocb.  O_DIRECT has no RWF_* flag, so it is added by hand, and
+ * refused if the backing file can't do direct I/O, as open() would.
+ */
+static int fuse_passthrough_kiocb(struct kiocb *kiocb, struct kiocb *iocb,
+				  struct file *backing)
+{
+	int ret;
+
+	init_sync_kiocb(kiocb, backing);
+	kiocb->ki_pos = iocb->ki_pos;
+	ret = kiocb_set_rw_flags(kiocb, fuse_iocb_to_rwf(iocb));
+	if (ret)
+		return ret;
+
+	if (iocb->ki_flags & IOCB_DIRECT) {
+		if (!backing->f_mapping->a_ops ||
+		    !backing->f_mapping->a_ops->direct_IO)
+			return -EINVAL;
+		kiocb->ki_flags |= IOCB_DIRECT;
+	}
+	return 0;
+}
+
+ssize_t fuse_passthrough_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	const struct cred *old_cred;
+	struct kiocb kiocb;
+	ssize_t ret;
+
+	if (!iov_iter_count(to))
+		return 0;
+
+	ret = fuse_passthrough_kiocb(&kiocb, iocb, ff->passthrough.filp);
+	if (ret)
+		return ret;
+
+	old_cred = override_creds(ff->passthrough.cred);
+	ret = vfs_iocb_iter_read(ff->passthrough.filp, &kiocb, to);
+	revert_creds(old_cred);
+	iocb->ki_pos = kiocb.ki_pos;
+
+	fuse_invalidate_atime(file_inode(file));
+
+	return ret;
+}
+
+ssize_t fuse_passthrough_write_iter(struct kiocb *iocb,
+				    struct iov_iter *from)
+{
+	struct file *file = iocb->ki_filp;
+	struct inode *inode = file_inode(file);
+	struct fuse_file *ff = file->private_data;
+	struct file *backing = ff->passthrough.filp;
+	const struct cred *old_cred;
+	struct kiocb kiocb;
+	ssize_t ret;
+
+	if (!iov_iter_count(from))
+		return 0;
+
+	inode_lock(inode);
+	ret = fuse_passthrough_kiocb(&kiocb, iocb, backing);
+	if (ret)
+		goto out;
+
+	old_cred = override_creds(ff->passthrough.cred);
+	file_start_write(backing);
+	ret = vfs_iocb_iter_write(backing, &kiocb, from);
+	file_end_write(backing);
+	revert_creds(old_cred);
+	iocb->ki_pos = kiocb.ki_pos;
+
+	if (ret > 0)
+		fuse_write_update_size(inode, iocb->ki_pos);
+	fuse_invalidate_attr(inode);
+out:
+	inode_unlock(inode);
+
+	return ret;
+}
+
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *backing = ff->passthrough.filp;
+	const struct cred *old_cred;
+	int ret;
+
+	if (WARN_ON(file != vma->vm_file))
+		return -EIO;
+
+	if (!backing->f_op->mmap)
+		return -ENODEV;
+
+	/* The daemon may have opened the backing file read-only */
+	if ((vma->vm_flags & VM_SHARED) && (vma->vm_flags & VM_MAYWRITE) &&
+	    !(backing->f_mode & FMODE_WRITE))
+		return -EACCES;
+
+	vma->vm_file = get_file(backing);
+
+	old_cred = override_creds(ff->passthrough.cred);
+	ret = call_mmap(vma->vm_file, vma);
+	revert_creds(old_cred);
+
+	if (ret) {
+		/* Drop reference count from new vm_file value */
+		fput(backing);
+	} else {
+		/* Drop reference count from previous vm_file value */
+		fput(file);
+	}
+
+	file_accessed(file);
+
+	return ret;
+}
@@ -186,17 +186,24 @@ static int journal_wait_on_commit_record(journal_t *journal,
  * use writepages() because with dealyed allocation we may be doing
  * block allocation in writepages().
  */
-static int journal_submit_inode_data_buffers(struct address_space *mapping)
+static int journal_submit_inode_data_buffers(struct address_space *mapping,
+		enum writeback_sync_modes sync_mode, long *budget)
 {
 	int ret;
+	long nr_to_write;
 	struct writeback_control wbc = {
-		.sync_mode =  WB_SYNC_ALL,
+		.sync_mode =  sync_mode,
 		.nr_to_write = mapping->nrpages * 2,
 		.range_start = 0,
 		.range_end = i_size_read(mapping->host),
 	};
 
+	if (budget)
+		wbc.nr_to_write = min(wbc.nr_to_write, *budget);
+	nr_to_write = wbc.nr_to_write;
 	ret = generic_writepages(mapping, &wbc);
+	if (budget)
+		*budget -= nr_to_write - wbc.nr_to_write;
 	return ret;
 }
 
@@ -204,12 +211,17 @@ static int journal_submit_inode_data_buffers(struct address_space *mapping)
  * Submit all the data buffers of inode associated with the transaction to
  * disk.
  *
- * We are in a committing transaction. Therefore no new inode can be added to
- * our inode list. We use JI_COMMIT_RUNNING flag to protect inode we currently
- * operate on from being released while we write out pages.
+ * Usually we are in a committing transaction, and no new inode can be added
+ * to our inode list. For the running transaction, see
+ * journal_next_data_writeback(), inodes may be added at the head of
+ * the list meanwhile; those are just left for its own commit. We use
+ * JI_COMMIT_RUNNING flag to protect inode we currently operate on from being
+ * released while we write out pages.  With a @budget, stop once that many
+ * pages have been written.
  */
 static int journal_submit_data_buffers(journal_t *journal,
-		transaction_t *commit_transaction)
+		transaction_t *commit_transaction,
+		enum writeback_sync_modes sync_mode, long *budget)
 {
 	struct jbd2_inode *jinode;
 	int err, ret = 0;
@@ -217,6 +229,8 @@ static int journal_submit_data_buffers(journal_t *journal,
 
 	spin_lock(&journal->j_list_lock);
 	list_for_each_entry(jinode, &commit_transaction->t_inode_list, i_list) {
+		if (budget && *budget <= 0)
+			break;
 		if (!(jinode->i_flags & JI_WRITE_DATA))
 			continue;
 		mapping = jinode->i_vfs_inode->i_mapping;
@@ -229,7 +243,8 @@ static int journal_submit_data_buffers(journal_t *journal,
 		 * only allocated blocks here.
 		 */
 		trace_jbd2_submit_inode_data(jinode->i_vfs_inode);
-		err = journal_submit_inode_data_buffers(mapping);
+		err = journal_submit_inode_data_buffers(mapping, sync_mode,
+							budget);
 		if (!ret)
 			ret = err;
 		spin_lock(&journal->j_list_lock);
@@ -242,6 +257,46 @@ static int journal_submit_data_buffers(journal_t *journal,
 	return ret;
 }
 
+/* Pages the early writeout of the next transaction submits at most */
+#define JBD2_NEXT_DATA_WRITEBACK_PAGES	1024
+
+/*
+ * Once a commit of the running transaction has been asked for, e.g. by
+ * fsync(), start writing out its ordered data while the committing
+ * transaction waits for its log and commit record I/O.  The two commits
+ * thus keep the device busy together instead of taking turns, and by the
+ * time the running transaction commits, much of its data is on disk
+ * already.  Its commit still submits and waits for everything itself, so
+ * ordering against its commit record is unchanged, and write errors are
+ * kept in the mappings for it to see.
+ *
+ * This runs from a workqueue so the commit thread never blocks on it, and
+ * submits a bounded amount so that it is done soon: the next commit waits
+ * for it before taking over the transaction.
+ */
+void jbd2_journal_next_data_work(struct work_struct *work)
+{
+	journal_t *journal = container_of(work, journal_t, j_next_data_work);
+	long budget = JBD2_NEXT_DATA_WRITEBACK_PAGES;
+	transaction_t *transaction;
+
+	read_lock(&journal->j_state_lock);
+	transaction = journal->j_running_transaction;
+	if (transaction &&
+	    !tid_geq(journal->j_commit_request, transaction->t_tid))
+		transaction = NULL;
+	read_unlock(&journal->j_state_lock);
+
+	/*
+	 * Its commit cancels or waits for us before locking it down, so it
+	 * stays running.  Don't wait for pages already under writeback, that
+	 * is for its commit.
+	 */
+	if (transaction && !is_journal_aborted(journal))
+		journal_submit_data_buffers(journal, transaction,
+					    WB_SYNC_NONE, &budget);
+}
+
 /*
  * Wait for data submitted for writeout, refile inodes to proper
  * transaction if needed.
@@ -374,6 +429,9 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	if (jbd2_journal_has_csum_v2or3(journal))
 		csum_size = sizeof(struct jbd2_journal_block_tail);
 
+	/* We submit and wait for all its data below anyway */
+	cancel_work_sync(&journal->j_next_data_work);
+
 	/*
 	 * First job: lock down the current transaction and wait for
 	 * all outstanding updates to complete.
@@ -523,7 +581,8 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	 * Now start flushing things to disk, in the order they appear
 	 * on the transaction lists.  Data blocks go first.
 	 */
-	err = journal_submit_data_buffers(journal, commit_transaction);
+	err = journal_submit_data_buffers(journal, commit_transaction,
+					  WB_SYNC_ALL, NULL);
 	if (err)
 		jbd2_journal_abort(journal, err);
 
@@ -773,6 +832,9 @@ start_journal_io:
 
 	blk_finish_plug(&plug);
 
+	if (!is_journal_aborted(journal))
+		queue_work(system_unbound_wq, &journal->j_next_data_work);
+
 	/* Lo and behold: we have just managed to send a transaction to
            the log.  Before we can commit it, wait for the IO so far to
            complete.  Control buffers being written are on the
@@ -1145,6 +1145,7 @@ static journal_t *journal_init_common(struct block_device *bdev,
 	init_waitqueue_head(&journal->j_wait_commit);
 	init_waitqueue_head(&journal->j_wait_updates);
 	init_waitqueue_head(&journal->j_wait_reserved);
+	INIT_WORK(&journal->j_next_data_work, jbd2_journal_next_data_work);
 	mutex_init(&journal->j_barrier);
 	mutex_init(&journal->j_checkpoint_mutex);
 	spin_lock_init(&journal->j_revoke_lock);
@@ -1726,6 +1727,7 @@ int jbd2_journal_destroy(journal_t *journal)
 	/* Force a final log commit */
 	if (journal->j_running_transaction)
 		jbd2_journal_commit_transaction(journal);
+	cancel_work_sync(&journal->j_next_data_work);
 
 	/* Force any old transactions to disk */
 
@@ -36,6 +36,7 @@
 #include <linux/fs_struct.h>
 #include <linux/posix_acl.h>
 #include <linux/hash.h>
+#include <linux/sysctl.h>
 #include <linux/bitops.h>
 #include <linux/init_task.h>
 #include <linux/uaccess.h>
@@ -508,6 +509,10 @@ struct nameidata {
 	struct inode	*link_inode;
 	unsigned	root_seq;
 	int		dfd;
+	/* path walk cache: key of the pathname prefix and where it led */
+	unsigned long	pc_key;
+	struct vfsmount	*pc_mnt;
+	int		pc_links;
 } __randomize_layout;
 
 static void set_nameidata(struct nameidata *p, int dfd, struct filename *name)
@@ -590,6 +595,238 @@ static void drop_links(struct nameidata *nd)
 	}
 }
 
+/*
+ * Path walk cache.
+ *
+ * Remembers which directory the pathname prefix (everything up to the
+ * last component) of a lookup led to, keyed by the starting point of the
+ * walk and the prefix string, so that the next rcu-walk of the same path
+ * can skip to that directory instead of resolving every component again.
+ *
+ * Nothing is ever invalidated: a hit is only trusted after walking up from
+ * the cached dentry to the starting point, checking each name against the
+ * prefix, each directory for MAY_EXEC and that none of them is a mountpoint,
+ * unhashed or asks for revalidation, all under rename_lock. Renames, chmod,
+ * ACL and mount changes are thus seen exactly as a full walk would see them.
+ *
+ * Slots hold no references.  They are only read under rcu_read_lock() and
+ * checked against the dentry's d_seq, and __dentry_kill() clears any slot
+ * still pointing at a dentry before it is freed, so a cached directory is
+ * evicted, rmdir'd and reclaimed like any other.
+ */
+int sysctl_path_walk_cache __read_mostly;
+
+#define PATH_CACHE_BITS		12
+#define PATH_CACHE_SIZE		(1 << PATH_CACHE_BITS)
+
+struct path_cache_slot {
+	unsigned long	key;
+	struct dentry	*dentry;
+};
+
+static struct path_cache_slot *path_cache __read_mostly;
+
+static int __init path_cache_init(void)
+{
+	path_cache = kcalloc(PATH_CACHE_SIZE, sizeof(*path_cache), GFP_KERNEL);
+	return 0;
+}
+fs_initcall(path_cache_init);
+
+static inline struct path_cache_slot *path_cache_slot(unsigned long key)
+{
+	return &path_cache[hash_long(key, PATH_CACHE_BITS)];
+}
+
+static void path_cache_flush(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < PATH_CACHE_SIZE; i++)
+		WRITE_ONCE(path_cache[i].dentry, NULL);
+}
+
+int path_cache_sysctl_handler(struct ctl_table *table, int write,
+			      void __user *buffer, size_t *lenp, loff_t *ppos)
+{
+	int ret = proc_dointvec_minmax(table, write, buffer, lenp, ppos);
+
+	if (!ret && write && !sysctl_path_walk_cache && path_cache)
+		path_cache_flush();
+	return ret;
+}
+
+/*
+ * Length of @name up to the end of its next to last component, 0 if there
+ * is no such prefix or it has "." or ".." in it.
+ */
+static unsigned int path_cache_prefix(const char *name)
+{
+	const char *p = name, *comp = name;
+	unsigned int prefix = 0, end = 0;
+
+	for (;; p++) {
+		if (*p && *p != '/')
+			continue;
+		if (p > comp) {
+			if (comp[0] == '.' &&
+			    (p - comp == 1 || (p - comp == 2 && comp[1] == '.')))
+				return 0;
+			prefix = end;
+			end = p - name;
+		}
+		if (!*p)
+			return prefix;
+		comp = p + 1;
+	}
+}
+
+static bool path_cache_verify(struct nameidata *nd, struct dentry *dentry,
+			      const char *name, unsigned int len)
+{
+	const unsigned int bad_flags = DCACHE_OP_HASH | DCACHE_OP_COMPARE |
+				       DCACHE_OP_REVALIDATE | DCACHE_MANAGED_DENTRY;
+	const char *end = name + len;
+	unsigned seq = read_seqbegin(&rename_lock);
+
+	if (READ_ONCE(nd->path.dentry->d_flags) &
+	    (DCACHE_OP_HASH | DCACHE_OP_COMPARE))
+		return false;
+
+	for (;;) {
+		const char *comp, *dname;
+		struct dentry *parent;
+		struct inode *dir;
+		unsigned int flags;
+		u32 dlen;
+
+		while (end > name && end[-1] == '/')
+			end--;
+		if (end == name)
+			break;
+		comp = end;
+		while (comp > name && comp[-1] != '/')
+			comp--;
+
+		if (dentry == nd->path.dentry || IS_ROOT(dentry))
+			return false;
+		flags = READ_ONCE(dentry->d_flags);
+		if ((flags & DCACHE_ENTRY_TYPE) != DCACHE_DIRECTORY_TYPE ||
+		    (flags & bad_flags) || d_unhashed(dentry))
+			return false;
+
+		/* see prepend_name() for the d_move() races here */
+		dname = READ_ONCE(dentry->d_name.name);
+		dlen = READ_ONCE(dentry->d_name.len);
+		if (dlen != end - comp)
+			return false;
+		while (comp < end) {
+			if (!*dname || *dname++ != *comp++)
+				return false;
+		}
+		comp -= dlen;
+
+		parent = READ_ONCE(dentry->d_parent);
+		dir = READ_ONCE(parent->d_inode);
+		if (!dir || inode_permission(dir, MAY_EXEC | MAY_NOT_BLOCK))
+			return false;
+
+		dentry = parent;
+		end = comp;
+	}
+
+	return dentry == nd->path.dentry && !read_seqretry(&rename_lock, seq);
+}
+
+/*
+ * Try to resolve the first @len bytes of @name from the cache, leaving
+ * nd->path at the directory they lead to. rcu-walk only, where the
+ * final legitimize_mnt() catches mounts racing with the verification.
+ */
+static bool path_cache_lookup(struct nameidata *nd, const char *name,
+			      unsigned int len, unsigned long key)
+{
+	struct path_cache_slot *slot = path_cache_slot(key);
+	struct dentry *dentry;
+	struct inode *inode;
+	unsigned seq;
+
+	if (READ_ONCE(slot->key) != key)
+		return false;
+	dentry = READ_ONCE(slot->dentry);
+	if (!dentry)
+		return false;
+
+	seq = raw_seqcount_begin(&dentry->d_seq);
+	if (!path_cache_verify(nd, dentry, name, len))
+		return false;
+	inode = d_backing_inode(dentry);
+	if (read_seqcount_retry(&dentry->d_seq, seq))
+		return false;
+
+	nd->path.dentry = dentry;
+	nd->inode = inode;
+	nd->seq = seq;
+	nd->flags &= ~LOOKUP_JUMPED;
+	return true;
+}
+
+/*
+ * Called once the prefix has been walked: remember the directory it led
+ * to if the walk stayed on its starting mount and followed no symlinks.
+ * nd->path.dentry is either referenced or protected by rcu-walk here.
+ */
+static void path_cache_record(struct nameidata *nd)
+{
+	struct dentry *dentry = nd->path.dentry;
+	struct path_cache_slot *slot;
+
+	if (!nd->pc_key || nd->pc_links != nd->total_link_count ||
+	    nd->path.mnt != nd->pc_mnt)
+		return;
+
+	slot = path_cache_slot(nd->pc_key);
+	if (READ_ONCE(slot->dentry) == dentry &&
+	    READ_ONCE(slot->key) == nd->pc_key)
+		return;
+
+	/* tell __dentry_kill() to look for us, unless it already ran */
+	if (!(READ_ONCE(dentry->d_flags) & DCACHE_PATH_CACHED)) {
+		spin_lock(&dentry->d_lock);
+		if (__lockref_is_dead(&dentry->d_lockref)) {
+			spin_unlock(&dentry->d_lock);
+			return;
+		}
+		dentry->d_flags |= DCACHE_PATH_CACHED;
+		spin_unlock(&dentry->d_lock);
+	}
+
+	WRITE_ONCE(slot->key, nd->pc_key);
+	WRITE_ONCE(slot->dentry, dentry);
+
+	/* pairs with the barrier in path_cache_forget() */
+	smp_mb();
+	if (unlikely(__lockref_is_dead(&dentry->d_lockref)))
+		cmpxchg(&slot->dentry, dentry, NULL);
+}
+
+/*
+ * Called by __dentry_kill() on a dentry that has been cached, after it has
+ * been marked dead and before it is freed: no slot may point at it once
+ * the RCU grace period is over.
+ */
+void path_cache_forget(struct dentry *dentry)
+{
+	unsigned int i;
+
+	/* pairs with the barrier in path_cache_record() */
+	smp_mb();
+	for (i = 0; i < PATH_CACHE_SIZE; i++) {
+		if (READ_ONCE(path_cache[i].dentry) == dentry)
+			cmpxchg(&path_cache[i].dentry, dentry, NULL);
+	}
+}
+
 static void terminate_walk(struct nameidata *nd)
 {
 	drop_links(nd);
@@ -745,7 +982,6 @@ static int unlazy_child(struct nameidata *nd, struct dentry *dentry, unsigned se
 			return -ECHILD;
 		}
 	}
-
 	rcu_read_unlock();
 	return 0;
 
@@ -1649,6 +1885,69 @@ static struct dentry *lookup_slow(const struct qstr *name,
 	return res;
 }
 
+/*
+ * Can create and unlink of non-directories in @dir run with its i_rwsem
+ * held shared?  Operations on the same name are then serialized by setting
+ * DCACHE_PAR_UPDATE on the dentry instead, see d_lock_update().
+ */
+static inline bool parallel_dirops(struct inode *dir)
+{
+	return (dir->i_opflags & IOP_PARALLEL_DIROPS) && !dir->i_op->atomic_open;
+}
+
+/*
+ * Returns false if @dentry got unhashed while we waited for it, by unlink
+ * or invalidation, in which case the caller has to look the name up again.
+ */
+static bool d_lock_update(struct dentry *dentry)
+{
+	spin_lock(&dentry->d_lock);
+	while (dentry->d_flags & DCACHE_PAR_UPDATE) {
+		spin_unlock(&dentry->d_lock);
+		wait_var_event(&dentry->d_flags,
+			!(READ_ONCE(dentry->d_flags) & DCACHE_PAR_UPDATE));
+		spin_lock(&dentry->d_lock);
+	}
+	if (unlikely(d_unhashed(dentry))) {
+		spin_unlock(&dentry->d_lock);
+		return false;
+	}
+	dentry->d_flags |= DCACHE_PAR_UPDATE;
+	spin_unlock(&dentry->d_lock);
+	return true;
+}
+
+static void d_unlock_update(struct dentry *dentry)
+{
+	spin_lock(&dentry->d_lock);
+	dentry->d_flags &= ~DCACHE_PAR_UPDATE;
+	spin_unlock(&dentry->d_lock);
+	wake_up_var(&dentry->d_flags);
+}
+
+/*
+ * Parent directory has inode locked shared and is parallel_dirops().
+ * Returns the dentry for @name with DCACHE_PAR_UPDATE set.
+ */
+static struct dentry *lookup_for_update(const struct qstr *name,
+		struct dentry *base, unsigned int flags)
+{
+	struct dentry *dentry;
+	bool negative;
+
+	for (;;) {
+		dentry = lookup_dcache(name, base, flags);
+		if (!dentry)
+			dentry = __lookup_slow(name, base, flags);
+		if (IS_ERR(dentry) || d_lock_update(dentry))
+			return dentry;
+		negative = d_is_negative(dentry);
+		dput(dentry);
+		if (negative)
+			return ERR_PTR(-ENOENT);
+	}
+}
+
 static inline int may_lookup(struct nameidata *nd)
 {
 	if (nd->flags & LOOKUP_RCU) {
@@ -2033,6 +2332,26 @@ static int link_path_walk(const char *name, struct nameidata *nd)
 	if (!*name)
 		return 0;
 
+	if (!nd->depth && path_cache && READ_ONCE(sysctl_path_walk_cache)) {
+		unsigned int len = path_cache_prefix(name);
+
+		if (len) {
+			unsigned long key = (unsigned long)nd->path.mnt ^
+				full_name_hash(nd->path.dentry, name, len);
+
+			if ((nd->flags & LOOKUP_RCU) &&
+			    path_cache_lookup(nd, name, len, key)) {
+				name += len;
+				while (*name == '/')
+					name++;
+			} else {
+				nd->pc_key = key;
+				nd->pc_mnt = nd->path.mnt;
+				nd->pc_links = nd->total_link_count;
+			}
+		}
+	}
+
 	/* At this point we know we have a real path component. */
 	for(;;) {
 		u64 hash_len;
@@ -2085,8 +2404,10 @@ static int link_path_walk(const char *name, struct nameidata *nd)
 		if (unlikely(!*name)) {
 OK:
 			/* pathname body, done */
-			if (!nd->depth)
+			if (!nd->depth) {
+				path_cache_record(nd);
 				return 0;
+			}
 			name = nd->stack[nd->depth - 1].name;
 			/* trailing symlink, done */
 			if (!name)
@@ -2135,6 +2456,7 @@ static const char *path_init(struct nameidata *nd, unsigned flags)
 	nd->last_type = LAST_ROOT; /* if there are only slashes... */
 	nd->flags = flags | LOOKUP_JUMPED | LOOKUP_PARENT;
 	nd->depth = 0;
+	nd->pc_key = 0;
 	if (flags & LOOKUP_ROOT) {
 		struct dentry *root = nd->root.dentry;
 		struct inode *inode = root->d_inode;
@@ -3121,12 +3443,14 @@ static int lookup_open(struct nameidata *nd, struct path *path,
 	struct dentry *dentry;
 	int error, create_error = 0;
 	umode_t mode = op->mode;
+	bool update = false;
 	DECLARE_WAIT_QUEUE_HEAD_ONSTACK(wq);
 
 	if (unlikely(IS_DEADDIR(dir_inode)))
 		return -ENOENT;
 
 	*opened &= ~FILE_CREATED;
+retry:
 	dentry = d_lookup(dir, &nd->last);
 	for (;;) {
 		if (!dentry) {
@@ -3209,6 +3533,19 @@ no_open:
 		}
 	}
 
+	/*
+	 * The parent is only locked shared, keep others from creating or
+	 * unlinking this name under us.
+	 */
+	if (!dentry->d_inode && (open_flag & O_CREAT) &&
+	    parallel_dirops(dir_inode)) {
+		if (!d_lock_update(dentry)) {
+			dput(dentry);
+			goto retry;
+		}
+		update = true;
+	}
+
 	/* Negative dentry, just create the file */
 	if (!dentry->d_inode && (open_flag & O_CREAT)) {
 		*opened |= FILE_CREATED;
@@ -3228,11 +3565,15 @@ no_open:
 		goto out_dput;
 	}
 out_no_open:
+	if (update)
+		d_unlock_update(dentry);
 	path->dentry = dentry;
 	path->mnt = nd->path.mnt;
 	return 1;
 
 out_dput:
+	if (update)
+		d_unlock_update(dentry);
 	dput(dentry);
 	return error;
 }
@@ -3248,6 +3589,7 @@ static int do_last(struct nameidata *nd,
 	int open_flag = op->open_flag;
 	bool will_truncate = (open_flag & O_TRUNC) != 0;
 	bool got_write = false;
+	bool shared;
 	int acc_mode = op->acc_mode;
 	unsigned seq;
 	struct inode *inode;
@@ -3304,15 +3646,16 @@ static int do_last(struct nameidata *nd,
 		 * dropping this one anyway.
 		 */
 	}
-	if (open_flag & O_CREAT)
-		inode_lock(dir->d_inode);
-	else
+	shared = !(open_flag & O_CREAT) || parallel_dirops(dir->d_inode);
+	if (shared)
 		inode_lock_shared(dir->d_inode);
-	error = lookup_open(nd, &path, file, op, got_write, opened);
-	if (open_flag & O_CREAT)
-		inode_unlock(dir->d_inode);
 	else
+		inode_lock(dir->d_inode);
+	error = lookup_open(nd, &path, file, op, got_write, opened);
+	if (shared)
 		inode_unlock_shared(dir->d_inode);
+	else
+		inode_unlock(dir->d_inode);
 
 	if (error <= 0) {
 		if (error)
@@ -3975,7 +4318,8 @@ SYSCALL_DEFINE1(rmdir, const char __user *, pathname)
  * @dentry:	victim
  * @delegated_inode: returns victim inode, if the inode is delegated.
  *
- * The caller must hold dir->i_mutex.
+ * The caller must hold dir->i_mutex, or hold it shared and have set
+ * DCACHE_PAR_UPDATE on @dentry if the filesystem allows parallel_dirops().
  *
  * If vfs_unlink discovers a delegation, it will return -EWOULDBLOCK and
  * return a reference to the inode in delegated_inode.  The caller
@@ -4043,6 +4387,7 @@ long do_unlinkat(int dfd, struct filename *name)
 	struct inode *inode = NULL;
 	struct inode *delegated_inode = NULL;
 	unsigned int lookup_flags = 0;
+	bool shared;
 retry:
 	name = filename_parentat(dfd, name, lookup_flags, &path, &last, &type);
 	if (IS_ERR(name))
@@ -4055,9 +4400,15 @@ retry:
 	error = mnt_want_write(path.mnt);
 	if (error)
 		goto exit1;
+	shared = parallel_dirops(path.dentry->d_inode);
 retry_deleg:
-	inode_lock_nested(path.dentry->d_inode, I_MUTEX_PARENT);
-	dentry = __lookup_hash(&last, path.dentry, lookup_flags);
+	if (shared) {
+		inode_lock_shared_nested(path.dentry->d_inode, I_MUTEX_PARENT);
+		dentry = lookup_for_update(&last, path.dentry, lookup_flags);
+	} else {
+		inode_lock_nested(path.dentry->d_inode, I_MUTEX_PARENT);
+		dentry = __lookup_hash(&last, path.dentry, lookup_flags);
+	}
 	error = PTR_ERR(dentry);
 	if (!IS_ERR(dentry)) {
 		/* Why not before? Because we want correct error value */
@@ -4072,9 +4423,14 @@ retry_deleg:
 			goto exit2;
 		error = vfs_unlink(path.dentry->d_inode, dentry, &delegated_inode);
 exit2:
+		if (shared)
+			d_unlock_update(dentry);
 		dput(dentry);
 	}
-	inode_unlock(path.dentry->d_inode);
+	if (shared)
+		inode_unlock_shared(path.dentry->d_inode);
+	else
+		inode_unlock(path.dentry->d_inode);
 	if (inode)
 		iput(inode);	/* truncate the inode here */
 	inode = NULL;
@@ -139,7 +139,8 @@ static int anon_pipe_buf_steal(struct pipe_inode_info *pipe,
 {
 	struct page *page = buf->page;
 
-	if (page_count(page) == 1) {
+	/* Compound buffers can't go into the page cache */
+	if (page_count(page) == 1 && !PageCompound(page)) {
 		if (memcg_kmem_enabled())
 			memcg_kmem_uncharge(page, 0);
 		__SetPageLocked(page);
@@ -242,6 +243,17 @@ static const struct pipe_buf_operations packet_pipe_buf_ops = {
 	.get = generic_pipe_buf_get,
 };
 
+/*
+ * Readers only ever sleep on an empty pipe and writers on a full one, so
+ * those are the only transitions that need a wakeup. Pollers and fasync
+ * users may however rely on a notification for each read and write.
+ */
+static inline bool pipe_wake_always(struct pipe_inode_info *pipe)
+{
+	return READ_ONCE(pipe->poll_usage) || pipe->fasync_readers ||
+	       pipe->fasync_writers;
+}
+
 static ssize_t
 pipe_read(struct kiocb *iocb, struct iov_iter *to)
 {
@@ -295,10 +307,11 @@ pipe_read(struct kiocb *iocb, struct iov_iter *to)
 
 			if (!buf->len) {
 				pipe_buf_release(pipe, buf);
+				if (bufs == pipe->buffers || pipe_wake_always(pipe))
+					do_wakeup = 1;
 				curbuf = (curbuf + 1) & (pipe->buffers - 1);
 				pipe->curbuf = curbuf;
 				pipe->nrbufs = --bufs;
-				do_wakeup = 1;
 			}
 			total_len -= chars;
 			if (!total_len)
@@ -349,6 +362,44 @@ static inline int is_packetized(struct file *file)
 	return (file->f_flags & O_DIRECT) != 0;
 }
 
+static inline size_t anon_pipe_buf_size(struct pipe_buffer *buf)
+{
+	return PAGE_SIZE << compound_order(buf->page);
+}
+
+/*
+ * Get a page for a new buffer that @len bytes are about to be written
+ * to. Large writes get a compound page of up to pipe->buf_order, if one
+ * is readily available.
+ */
+static struct page *pipe_get_page(struct pipe_inode_info *pipe, size_t len)
+{
+	struct page *page = pipe->tmp_page;
+	unsigned int order = 0;
+
+	if (pipe->buf_order && len > PAGE_SIZE)
+		order = min_t(unsigned int, pipe->buf_order, get_order(len));
+
+	if (page) {
+		if (compound_order(page) >= order &&
+		    compound_order(page) <= pipe->buf_order)
+			return page;
+		put_page(page);
+		pipe->tmp_page = NULL;
+	}
+
+	if (order) {
+		/* Not highmem, consumers access the whole buffer via kmap() */
+		page = alloc_pages(GFP_USER | __GFP_ACCOUNT | __GFP_COMP |
+				   __GFP_NORETRY | __GFP_NOWARN, order);
+		if (page)
+			return page;
+	}
+	return alloc_page(GFP_HIGHUSER | __GFP_ACCOUNT);
+}
+
+static void pipe_grow(struct pipe_inode_info *pipe);
+
 static ssize_t
 pipe_write(struct kiocb *iocb, struct iov_iter *from)
 {
@@ -379,7 +430,8 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 		struct pipe_buffer *buf = pipe->bufs + lastbuf;
 		int offset = buf->offset + buf->len;
 
-		if (buf->ops->can_merge && offset + chars <= PAGE_SIZE) {
+		if (buf->ops->can_merge &&
+		    offset + chars <= anon_pipe_buf_size(buf)) {
 			ret = pipe_buf_confirm(pipe, buf);
 			if (ret)
 				goto out;
@@ -389,7 +441,8 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 				ret = -EFAULT;
 				goto out;
 			}
-			do_wakeup = 1;
+			if (pipe_wake_always(pipe))
+				do_wakeup = 1;
 			buf->len += ret;
 			if (!iov_iter_count(from))
 				goto out;
@@ -409,25 +462,30 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 		if (bufs < pipe->buffers) {
 			int newbuf = (pipe->curbuf + bufs) & (pipe->buffers-1);
 			struct pipe_buffer *buf = pipe->bufs + newbuf;
-			struct page *page = pipe->tmp_page;
+			struct page *page;
+			size_t size;
 			int copied;
 
-			if (!page) {
-				page = alloc_page(GFP_HIGHUSER | __GFP_ACCOUNT);
-				if (unlikely(!page)) {
-					ret = ret ? : -ENOMEM;
-					break;
-				}
-				pipe->tmp_page = page;
+			/* Packets stay PAGE_SIZE, that is part of the ABI */
+			page = pipe_get_page(pipe, is_packetized(filp) ?
+					     PAGE_SIZE : iov_iter_count(from));
+			if (unlikely(!page)) {
+				ret = ret ? : -ENOMEM;
+				break;
 			}
+			pipe->tmp_page = page;
+			size = PAGE_SIZE << compound_order(page);
+			if (is_packetized(filp))
+				size = PAGE_SIZE;
+
 			/* Always wake up, even if the copy fails. Otherwise
 			 * we lock up (O_NONBLOCK-)readers that sleep due to
-			 * syscall merging.
-			 * FIXME! Is this really true?
+			 * syscall merging. Readers only sleep on an empty pipe.
 			 */
-			do_wakeup = 1;
-			copied = copy_page_from_iter(page, 0, PAGE_SIZE, from);
-			if (unlikely(copied < PAGE_SIZE && iov_iter_count(from))) {
+			if (!bufs || pipe_wake_always(pipe))
+				do_wakeup = 1;
+			copied = copy_page_from_iter(page, 0, size, from);
+			if (unlikely(copied < size && iov_iter_count(from))) {
 				if (!ret)
 					ret = -EFAULT;
 				break;
@@ -467,6 +525,13 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 			kill_fasync(&pipe->fasync_readers, SIGIO, POLL_IN);
 			do_wakeup = 0;
 		}
+		/*
+		 * The reader can't keep up and there is more to write: use
+		 * larger buffers from now on, so that both sides do fewer
+		 * page allocations and wakeups per byte.
+		 */
+		if (iov_iter_count(from) > PAGE_SIZE && !is_packetized(filp))
+			pipe_grow(pipe);
 		pipe->waiting_writers++;
 		pipe_wait(pipe);
 		pipe->waiting_writers--;
@@ -519,6 +584,9 @@ pipe_poll(struct file *filp, poll_table *wait)
 
 	poll_wait(filp, &pipe->wait, wait);
 
+	/* Epoll has some historical nasty semantics, this enables them */
+	WRITE_ONCE(pipe->poll_usage, true);
+
 	/* Reading only -- no need for acquiring the semaphore.  */
 	nrbufs = pipe->nrbufs;
 	mask = 0;
@@ -622,6 +690,32 @@ static bool is_unprivileged_user(void)
 	return !capable(CAP_SYS_RESOURCE) && !capable(CAP_SYS_ADMIN);
 }
 
+/*
+ * Double the size of the pages backing new buffers of @pipe, unless that
+ * would take it over pipe_max_size or the user over the pipe page limits.
+ * The number of buffers, and hence of pending write()s and wakeups, stays
+ * the same. Pipes sized explicitly with F_SETPIPE_SZ are left alone.
+ */
+static void pipe_grow(struct pipe_inode_info *pipe)
+{
+	unsigned long old_pages = pipe_nr_pages(pipe);
+	unsigned long nr_pages = old_pages << 1;
+	unsigned long user_bufs;
+
+	if (pipe->size_fixed || pipe->buf_order >= PIPE_MAX_BUF_ORDER)
+		return;
+	if (nr_pages * PAGE_SIZE > READ_ONCE(pipe_max_size))
+		return;
+
+	user_bufs = account_pipe_buffers(pipe->user, old_pages, nr_pages);
+	if (too_many_pipe_buffers_soft(user_bufs) ||
+	    too_many_pipe_buffers_hard(user_bufs)) {
+		(void) account_pipe_buffers(pipe->user, nr_pages, old_pages);
+		return;
+	}
+	pipe->buf_order++;
+}
+
 struct pipe_inode_info *alloc_pipe_info(void)
 {
 	struct pipe_inode_info *pipe;
@@ -671,7 +765,7 @@ void free_pipe_info(struct pipe_inode_info *pipe)
 {
 	int i;
 
-	(void) account_pipe_buffers(pipe->user, pipe->buffers, 0);
+	(void) account_pipe_buffers(pipe->user, pipe_nr_pages(pipe), 0);
 	free_uid(pipe->user);
 	for (i = 0; i < pipe->buffers; i++) {
 		struct pipe_buffer *buf = pipe->bufs + i;
@@ -679,7 +773,7 @@ void free_pipe_info(struct pipe_inode_info *pipe)
 			pipe_buf_release(pipe, buf);
 	}
 	if (pipe->tmp_page)
-		__free_page(pipe->tmp_page);
+		put_page(pipe->tmp_page);
 	kfree(pipe->bufs);
 	kfree(pipe);
 }
@@ -1050,7 +1144,7 @@ static long pipe_set_size(struct pipe_inode_info *pipe, unsigned long arg)
 {
 	struct pipe_buffer *bufs;
 	unsigned int size, nr_pages;
-	unsigned long user_bufs;
+	unsigned long user_bufs, old_pages = pipe_nr_pages(pipe);
 	long ret = 0;
 
 	size = round_pipe_size(arg);
@@ -1066,13 +1160,13 @@ static long pipe_set_size(struct pipe_inode_info *pipe, unsigned long arg)
 	 * Decreasing the pipe capacity is always permitted, even
 	 * if the user is currently over a limit.
 	 */
-	if (nr_pages > pipe->buffers &&
+	if (nr_pages > old_pages &&
 			size > pipe_max_size && !capable(CAP_SYS_RESOURCE))
 		return -EPERM;
 
-	user_bufs = account_pipe_buffers(pipe->user, pipe->buffers, nr_pages);
+	user_bufs = account_pipe_buffers(pipe->user, old_pages, nr_pages);
 
-	if (nr_pages > pipe->buffers &&
+	if (nr_pages > old_pages &&
 			(too_many_pipe_buffers_hard(user_bufs) ||
 			 too_many_pipe_buffers_soft(user_bufs)) &&
 			is_unprivileged_user()) {
@@ -1123,10 +1217,15 @@ static long pipe_set_size(struct pipe_inode_info *pipe, unsigned long arg)
 	kfree(pipe->bufs);
 	pipe->bufs = bufs;
 	pipe->buffers = nr_pages;
+	/* The caller knows best, stop growing the pipe behind its back */
+	pipe->buf_order = 0;
+	pipe->size_fixed = true;
+	/* Writers blocked on a full pipe may have room now */
+	wake_up_interruptible_all(&pipe->wait);
 	return nr_pages * PAGE_SIZE;
 
 out_revert_acct:
-	(void) account_pipe_buffers(pipe->user, nr_pages, pipe->buffers);
+	(void) account_pipe_buffers(pipe->user, nr_pages, old_pages);
 	return ret;
 }
 
@@ -1156,7 +1255,7 @@ long pipe_fcntl(struct file *file, unsigned int cmd, unsigned long arg)
 		ret = pipe_set_size(pipe, arg);
 		break;
 	case F_GETPIPE_SZ:
-		ret = pipe->buffers * PAGE_SIZE;
+		ret = pipe_nr_pages(pipe) * PAGE_SIZE;
 		break;
 	default:
 		ret = -EINVAL;
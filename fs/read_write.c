@@ -20,6 +20,7 @@
 #include <linux/compat.h>
 #include <linux/mount.h>
 #include <linux/fs.h>
+#include <linux/sizes.h>
 #include "internal.h"
 
 #include <linux/uaccess.h>
@@ -937,6 +938,38 @@ ssize_t vfs_iter_read(struct file *file, struct iov_iter *iter, loff_t *ppos,
 }
 EXPORT_SYMBOL(vfs_iter_read);
 
+/*
+ * Like vfs_iter_read(), but with a kiocb set up by the caller, e.g. to pass
+ * on IOCB_DIRECT, which has no RWF_* equivalent.
+ */
+ssize_t vfs_iocb_iter_read(struct file *file, struct kiocb *iocb,
+			   struct iov_iter *iter)
+{
+	size_t tot_len;
+	ssize_t ret = 0;
+
+	if (!file->f_op->read_iter)
+		return -EINVAL;
+	if (!(file->f_mode & FMODE_READ))
+		return -EBADF;
+	if (!(file->f_mode & FMODE_CAN_READ))
+		return -EINVAL;
+
+	tot_len = iov_iter_count(iter);
+	if (!tot_len)
+		goto out;
+	ret = rw_verify_area(READ, file, &iocb->ki_pos, tot_len);
+	if (ret < 0)
+		return ret;
+
+	ret = call_read_iter(file, iocb, iter);
+out:
+	if (ret >= 0)
+		fsnotify_access(file);
+	return ret;
+}
+EXPORT_SYMBOL(vfs_iocb_iter_read);
+
 static ssize_t do_iter_write(struct file *file, struct iov_iter *iter,
 		loff_t *pos, rwf_t flags)
 {
@@ -973,6 +1006,33 @@ ssize_t vfs_iter_write(struct file *file, struct iov_iter *iter, loff_t *ppos,
 }
 EXPORT_SYMBOL(vfs_iter_write);
 
+ssize_t vfs_iocb_iter_write(struct file *file, struct kiocb *iocb,
+			    struct iov_iter *iter)
+{
+	size_t tot_len;
+	ssize_t ret = 0;
+
+	if (!file->f_op->write_iter)
+		return -EINVAL;
+	if (!(file->f_mode & FMODE_WRITE))
+		return -EBADF;
+	if (!(file->f_mode & FMODE_CAN_WRITE))
+		return -EINVAL;
+
+	tot_len = iov_iter_count(iter);
+	if (!tot_len)
+		return 0;
+	ret = rw_verify_area(WRITE, file, &iocb->ki_pos, tot_len);
+	if (ret < 0)
+		return ret;
+
+	ret = call_write_iter(file, iocb, iter);
+	if (ret > 0)
+		fsnotify_modify(file);
+	return ret;
+}
+EXPORT_SYMBOL(vfs_iocb_iter_write);
+
 ssize_t vfs_readv(struct file *file, const struct iovec __user *vec,
 		  unsigned long vlen, loff_t *pos, rwf_t flags)
 {
@@ -1541,6 +1601,102 @@ COMPAT_SYSCALL_DEFINE4(sendfile64, int, out_fd, int, in_fd,
 }
 #endif
 
+/* Amount copied between checks for pending signals */
+#define COPY_CHUNK_SIZE	SZ_1M
+
+/**
+ * generic_copy_file_range - copy data between two files through the page cache
+ * @file_in:	file structure to read from
+ * @pos_in:	file offset to read from
+ * @file_out:	file structure to write data to
+ * @pos_out:	file offset to write data to
+ * @len:	amount of data to copy
+ * @flags:	copy flags
+ *
+ * This is the fallback of copy_file_range(2) for files that can neither be
+ * cloned nor copied by the filesystem, possibly living on two different
+ * filesystems. The data is spliced from @file_in to @file_out in chunks,
+ * without a round trip through userspace. Between chunks the copy stops
+ * early if a signal is pending and reports what was copied so far, so
+ * that large copies stay interruptible and callers can track progress.
+ */
+ssize_t generic_copy_file_range(struct file *file_in, loff_t pos_in,
+				struct file *file_out, loff_t pos_out,
+				size_t len, unsigned int flags)
+{
+	ssize_t ret, copied = 0;
+
+	len = min_t(size_t, len, MAX_RW_COUNT);
+	while (len) {
+		size_t chunk = min_t(size_t, len, COPY_CHUNK_SIZE);
+
+		ret = do_splice_direct(file_in, &pos_in, file_out, &pos_out,
+				       chunk, 0);
+		if (ret <= 0) {
+			if (!copied)
+				copied = ret;
+			break;
+		}
+		copied += ret;
+		len -= ret;
+
+		/* EOF or a short write */
+		if (ret < chunk || signal_pending(current))
+			break;
+		cond_resched();
+	}
+
+	return copied;
+}
+EXPORT_SYMBOL(generic_copy_file_range);
+
+/*
+ * Clone the block aligned middle of the range and copy the unaligned head
+ * and tail, for copies that can't be cloned in one go only because they
+ * start or end in the middle of a block.
+ */
+static ssize_t clone_aligned_file_range(struct file *file_in, loff_t pos_in,
+					struct file *file_out, loff_t pos_out,
+					size_t len)
+{
+	unsigned int bs = file_inode(file_out)->i_sb->s_blocksize;
+	size_t head, body, tail;
+	ssize_t ret, copied = 0;
+
+	if ((pos_in ^ pos_out) & (bs - 1))
+		return -EINVAL;
+
+	head = round_up(pos_in, bs) - pos_in;
+	if (len < head + bs)
+		return -EINVAL;
+	body = round_down(len - head, bs);
+	tail = len - head - body;
+
+	if (head) {
+		ret = generic_copy_file_range(file_in, pos_in, file_out,
+					      pos_out, head, 0);
+		if (ret != head)
+			return ret;
+		copied = head;
+	}
+
+	ret = file_in->f_op->clone_file_range(file_in, pos_in + head,
+					      file_out, pos_out + head, body);
+	if (ret)
+		return copied ? copied : ret;
+	copied += body;
+
+	if (tail) {
+		ret = generic_copy_file_range(file_in, pos_in + copied,
+					      file_out, pos_out + copied,
+					      tail, 0);
+		if (ret > 0)
+			copied += ret;
+	}
+
+	return copied;
+}
+
 /*
  * copy_file_range() differs from regular file read and write in that it
  * specifically allows return partial success.  When it does so is up to
@@ -1575,15 +1731,18 @@ ssize_t vfs_copy_file_range(struct file *file_in, loff_t pos_in,
 	    (file_out->f_flags & O_APPEND))
 		return -EBADF;
 
-	/* this could be relaxed once a method supports cross-fs copies */
-	if (inode_in->i_sb != inode_out->i_sb)
-		return -EXDEV;
-
 	if (len == 0)
 		return 0;
 
 	file_start_write(file_out);
 
+	/*
+	 * Clone and the filesystem's own copy method only work within one
+	 * filesystem; anything else goes through the page cache below.
+	 */
+	if (inode_in->i_sb != inode_out->i_sb)
+		goto generic;
+
 	/*
 	 * Try cloning first, this is supported by more file systems, and
 	 * more efficient if both clone and copy are supported (e.g. NFS).
@@ -1595,6 +1754,13 @@ ssize_t vfs_copy_file_range(struct file *file_in, loff_t pos_in,
 			ret = len;
 			goto done;
 		}
+		/* -EINVAL is what misaligned ranges get */
+		if (ret == -EINVAL) {
+			ret = clone_aligned_file_range(file_in, pos_in,
+						       file_out, pos_out, len);
+			if (ret > 0)
+				goto done;
+		}
 	}
 
 	if (file_out->f_op->copy_file_range) {
@@ -1604,8 +1770,9 @@ ssize_t vfs_copy_file_range(struct file *file_in, loff_t pos_in,
 			goto done;
 	}
 
-	ret = do_splice_direct(file_in, &pos_in, file_out, &pos_out,
-			len > MAX_RW_COUNT ? MAX_RW_COUNT : len, 0);
+generic:
+	ret = generic_copy_file_range(file_in, pos_in, file_out, pos_out,
+				      len, flags);
 
 done:
 	if (ret > 0) {
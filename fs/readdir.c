@@ -14,6 +14,7 @@
 #include <linux/stat.h>
 #include <linux/file.h>
 #include <linux/fs.h>
+#include <linux/namei.h>
 #include <linux/fsnotify.h>
 #include <linux/dirent.h>
 #include <linux/security.h>
@@ -23,6 +24,8 @@
 
 #include <linux/uaccess.h>
 
+#include "internal.h"
+
 int iterate_dir(struct file *file, struct dir_context *ctx)
 {
 	struct inode *inode = file_inode(file);
@@ -333,6 +336,191 @@ SYSCALL_DEFINE3(getdents64, unsigned int, fd,
 	return ksys_getdents64(fd, dirent, count);
 }
 
+struct getdents_statx_callback {
+	struct dir_context ctx;
+	struct dirent_statx __user * current_dir;
+	struct dirent_statx __user * previous;
+	int count;
+	int error;
+};
+
+static int filldir_statx(struct dir_context *ctx, const char *name, int namlen,
+			 loff_t offset, u64 ino, unsigned int d_type)
+{
+	struct dirent_statx __user *dirent;
+	struct getdents_statx_callback *buf =
+		container_of(ctx, struct getdents_statx_callback, ctx);
+	int reclen = ALIGN(offsetof(struct dirent_statx, d_name) + namlen + 1,
+		sizeof(u64));
+
+	buf->error = -EINVAL;	/* only used if we fail.. */
+	if (reclen > buf->count)
+		return -EINVAL;
+	dirent = buf->previous;
+	if (dirent) {
+		if (signal_pending(current))
+			return -EINTR;
+		if (__put_user(offset, &dirent->d_off))
+			goto efault;
+	}
+	dirent = buf->current_dir;
+	if (__put_user(ino, &dirent->d_ino))
+		goto efault;
+	if (__put_user(0, &dirent->d_off))
+		goto efault;
+	if (__put_user(reclen, &dirent->d_reclen))
+		goto efault;
+	if (__put_user(d_type, &dirent->d_type))
+		goto efault;
+	if (copy_to_user(dirent->d_name, name, namlen))
+		goto efault;
+	if (__put_user(0, dirent->d_name + namlen))
+		goto efault;
+	buf->previous = dirent;
+	dirent = (void __user *)dirent + reclen;
+	buf->current_dir = dirent;
+	buf->count -= reclen;
+	return 0;
+efault:
+	buf->error = -EFAULT;
+	return -EFAULT;
+}
+
+static int dirent_getattr(struct file *dir, const char *name, int len,
+			  unsigned int flags, unsigned int mask,
+			  struct kstat *stat)
+{
+	struct path path;
+	int error;
+
+	if (len == 1 && name[0] == '.')
+		return vfs_getattr(&dir->f_path, stat, mask, flags);
+	/* might be on another mount; fstatat() it if you need it */
+	if (len == 2 && name[0] == '.' && name[1] == '.')
+		return -EOPNOTSUPP;
+
+	path.dentry = lookup_one_len_unlocked(name, dir->f_path.dentry, len);
+	if (IS_ERR(path.dentry))
+		return PTR_ERR(path.dentry);
+	path.mnt = mntget(dir->f_path.mnt);
+
+	error = -ENOENT;
+	if (d_really_is_positive(path.dentry)) {
+		/* what a path walk would have stopped at */
+		while (d_mountpoint(path.dentry) && follow_down_one(&path))
+			;
+		error = vfs_getattr(&path, stat, mask, flags);
+	}
+	path_put(&path);
+	return error;
+}
+
+/*
+ * Second pass over the records filldir_statx() put in the user buffer,
+ * once the directory lock is dropped: look every entry up and fill in its
+ * attributes. The names are read back from the buffer, so userspace
+ * scribbling over it only gets it the attributes of some other name in
+ * that directory, with the same permission checks as fstatat().
+ */
+static int fill_dirent_statx(struct file *file,
+			     struct dirent_statx __user *dirent, int len,
+			     unsigned int flags, unsigned int mask)
+{
+	void __user *end = (void __user *)dirent + len;
+	char name[NAME_MAX + 1];
+	struct kstat stat;
+
+	flags |= AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT;
+
+	while ((void __user *)dirent < end) {
+		unsigned short reclen;
+		int namlen, error;
+
+		if (__get_user(reclen, &dirent->d_reclen))
+			return -EFAULT;
+		namlen = reclen - (int)offsetof(struct dirent_statx, d_name);
+		if (namlen <= 0 || (void __user *)dirent + reclen > end)
+			break;
+		namlen = min(namlen, NAME_MAX + 1);
+		if (copy_from_user(name, dirent->d_name, namlen))
+			return -EFAULT;
+
+		namlen = strnlen(name, namlen);
+		if (namlen > NAME_MAX)
+			error = -ENAMETOOLONG;
+		else
+			error = dirent_getattr(file, name, namlen, flags, mask,
+					       &stat);
+
+		if (__put_user(error, &dirent->d_stx_err))
+			return -EFAULT;
+		if (error) {
+			if (clear_user(&dirent->d_stx, sizeof(dirent->d_stx)))
+				return -EFAULT;
+		} else if (cp_statx(&stat, &dirent->d_stx)) {
+			return -EFAULT;
+		}
+
+		dirent = (void __user *)dirent + reclen;
+		cond_resched();
+	}
+	return len;
+}
+
+/**
+ * sys_getdents_statx - read directory entries along with their attributes
+ * @fd: directory to read
+ * @dirent: buffer for the struct dirent_statx records
+ * @count: size of @dirent
+ * @flags: AT_STATX_* sync flags, as for statx()
+ * @mask: parts of struct statx wanted, as for statx()
+ *
+ * Saves the statx() call per entry that tree walkers otherwise do right
+ * after getdents64(). Entries are stat'ed without following symlinks.
+ */
+SYSCALL_DEFINE5(getdents_statx, unsigned int, fd,
+		struct dirent_statx __user *, dirent, unsigned int, count,
+		unsigned int, flags, unsigned int, mask)
+{
+	struct fd f;
+	struct dirent_statx __user * lastdirent;
+	struct getdents_statx_callback buf = {
+		.ctx.actor = filldir_statx,
+		.count = count,
+		.current_dir = dirent
+	};
+	int error;
+
+	if (mask & STATX__RESERVED)
+		return -EINVAL;
+	if (flags & ~AT_STATX_SYNC_TYPE)
+		return -EINVAL;
+	if ((flags & AT_STATX_SYNC_TYPE) == AT_STATX_SYNC_TYPE)
+		return -EINVAL;
+	if (!access_ok(VERIFY_WRITE, dirent, count))
+		return -EFAULT;
+
+	f = fdget_pos(fd);
+	if (!f.file)
+		return -EBADF;
+
+	error = iterate_dir(f.file, &buf.ctx);
+	if (error >= 0)
+		error = buf.error;
+	lastdirent = buf.previous;
+	if (lastdirent) {
+		typeof(lastdirent->d_off) d_off = buf.ctx.pos;
+		if (__put_user(d_off, &lastdirent->d_off))
+			error = -EFAULT;
+		else
+			error = fill_dirent_statx(f.file, dirent,
+						  count - buf.count, flags,
+						  mask);
+	}
+	fdput_pos(f);
+	return error;
+}
+
 #ifdef CONFIG_COMPAT
 struct compat_old_linux_dirent {
 	compat_ulong_t	d_ino;
@@ -689,7 +689,7 @@ iter_file_splice_write(struct pipe_inode_info *pipe, struct file *out,
 		.pos = *ppos,
 		.u.file = out,
 	};
-	int nbufs = pipe->buffers;
+	int nbufs = pipe_nr_pages(pipe);
 	struct bio_vec *array = kcalloc(nbufs, sizeof(struct bio_vec),
 					GFP_KERNEL);
 	ssize_t ret;
@@ -703,15 +703,15 @@ iter_file_splice_write(struct pipe_inode_info *pipe, struct file *out,
 	while (sd.total_len) {
 		struct iov_iter from;
 		size_t left;
-		int n, idx;
+		int i, n, idx;
 
 		ret = splice_from_pipe_next(pipe, &sd);
 		if (ret <= 0)
 			break;
 
-		if (unlikely(nbufs < pipe->buffers)) {
+		if (unlikely(nbufs < pipe_nr_pages(pipe))) {
 			kfree(array);
-			nbufs = pipe->buffers;
+			nbufs = pipe_nr_pages(pipe);
 			array = kcalloc(nbufs, sizeof(struct bio_vec),
 					GFP_KERNEL);
 			if (!array) {
@@ -720,11 +720,16 @@ iter_file_splice_write(struct pipe_inode_info *pipe, struct file *out,
 			}
 		}
 
-		/* build the vector */
+		/*
+		 * Build the vector, one entry per page: buffers filled by
+		 * pipe_write() may be backed by compound pages.
+		 */
 		left = sd.total_len;
-		for (n = 0, idx = pipe->curbuf; left && n < pipe->nrbufs; n++, idx++) {
+		for (i = 0, n = 0, idx = pipe->curbuf;
+		     left && i < pipe->nrbufs && n < nbufs; i++, idx++) {
 			struct pipe_buffer *buf = pipe->bufs + idx;
 			size_t this_len = buf->len;
+			unsigned int offset = buf->offset;
 
 			if (this_len > left)
 				this_len = left;
@@ -739,10 +744,18 @@ iter_file_splice_write(struct pipe_inode_info *pipe, struct file *out,
 				goto done;
 			}
 
-			array[n].bv_page = buf->page;
-			array[n].bv_len = this_len;
-			array[n].bv_offset = buf->offset;
-			left -= this_len;
+			while (this_len && n < nbufs) {
+				size_t part = min_t(size_t, this_len,
+						    PAGE_SIZE - offset_in_page(offset));
+
+				array[n].bv_page = buf->page + (offset >> PAGE_SHIFT);
+				array[n].bv_len = part;
+				array[n].bv_offset = offset_in_page(offset);
+				offset += part;
+				this_len -= part;
+				left -= part;
+				n++;
+			}
 		}
 
 		iov_iter_bvec(&from, ITER_BVEC | WRITE, array, n,
@@ -234,12 +234,100 @@ xfs_inode_set_reclaim_tag(
 			   XFS_ICI_RECLAIM_TAG);
 	xfs_perag_set_reclaim_tag(pag);
 	__xfs_iflags_set(ip, XFS_IRECLAIMABLE);
+	ip->i_flags &= ~XFS_INACTIVATING;
 
 	spin_unlock(&ip->i_flags_lock);
 	spin_unlock(&pag->pag_ici_lock);
 	xfs_perag_put(pag);
 }
 
+/*
+ * Unlinked inodes can take a long time to inactivate, e.g. when freeing a
+ * heavily fragmented file means freeing lots of extents. Rather than making
+ * the final iput wait for that, queue them to a per-cpu worker, which then
+ * hands them over to reclaim.
+ *
+ * Tasks unlinking faster than the worker keeps up are throttled by waiting
+ * for the backlog on their CPU. That is skipped in memory reclaim and inside
+ * transactions, where the worker might need resources the caller holds.
+ *
+ * Returns true if the inode was queued, otherwise the caller has to
+ * inactivate it itself.
+ */
+bool
+xfs_inodegc_queue(
+	struct xfs_inode	*ip)
+{
+	struct xfs_mount	*mp = ip->i_mount;
+	struct xfs_inodegc	*gc;
+	unsigned int		items;
+
+	if (VFS_I(ip)->i_nlink || !VFS_I(ip)->i_mode)
+		return false;
+	if ((mp->m_flags & XFS_MOUNT_RDONLY) || XFS_FORCED_SHUTDOWN(mp))
+		return false;
+
+	xfs_iflags_set(ip, XFS_NEED_INACTIVE);
+
+	gc = get_cpu_ptr(mp->m_inodegc);
+	llist_add(&ip->i_gclist, &gc->list);
+	items = READ_ONCE(gc->items) + 1;
+	WRITE_ONCE(gc->items, items);
+	queue_work_on(smp_processor_id(), mp->m_inodegc_workqueue, &gc->work);
+	put_cpu_ptr(gc);
+
+	if (items > XFS_INODEGC_MAX_BACKLOG &&
+	    !(current->flags & (PF_MEMALLOC | PF_MEMALLOC_NOFS)))
+		flush_work(&gc->work);
+	return true;
+}
+
+void
+xfs_inodegc_worker(
+	struct work_struct	*work)
+{
+	struct xfs_inodegc	*gc = container_of(work, struct xfs_inodegc,
+						   work);
+	struct llist_node	*node = llist_del_all(&gc->list);
+	struct xfs_inode	*ip, *n;
+
+	WRITE_ONCE(gc->items, 0);
+
+	/* inactivate in the order the inodes were queued */
+	node = llist_reverse_order(node);
+	llist_for_each_entry_safe(ip, n, node, i_gclist) {
+		spin_lock(&ip->i_flags_lock);
+		ip->i_flags &= ~XFS_NEED_INACTIVE;
+		__xfs_iflags_set(ip, XFS_INACTIVATING);
+		spin_unlock(&ip->i_flags_lock);
+
+		xfs_inactive(ip);
+		ASSERT(XFS_FORCED_SHUTDOWN(ip->i_mount) ||
+		       ip->i_delayed_blks == 0);
+		XFS_STATS_INC(ip->i_mount, vn_reclaim);
+
+		xfs_inode_set_reclaim_tag(ip);
+	}
+}
+
+/*
+ * Wait for the inactivation of all the inodes queued so far, so that the
+ * space and quota they hold is released. On a frozen filesystem the worker
+ * is stuck waiting for the thaw, so don't bother.
+ */
+void
+xfs_inodegc_flush(
+	struct xfs_mount	*mp)
+{
+	int			cpu;
+
+	if (mp->m_super->s_writers.frozen >= SB_FREEZE_FS)
+		return;
+
+	for_each_possible_cpu(cpu)
+		flush_work(&per_cpu_ptr(mp->m_inodegc, cpu)->work);
+}
+
 STATIC void
 xfs_inode_clear_reclaim_tag(
 	struct xfs_perag	*pag,
@@ -378,13 +466,22 @@ xfs_iget_cache_hit(
 	 *	     wait_on_inode to wait for these flags to be cleared
 	 *	     instead of polling for it.
 	 */
-	if (ip->i_flags & (XFS_INEW|XFS_IRECLAIM)) {
+	if (ip->i_flags & (XFS_INEW|XFS_IRECLAIM|XFS_INACTIVATING)) {
 		trace_xfs_iget_skip(ip);
 		XFS_STATS_INC(mp, xs_ig_frecycle);
 		error = -EAGAIN;
 		goto out_error;
 	}
 
+	/*
+	 * Unlinked inodes waiting for background inactivation are as good as
+	 * freed, they can't be brought back.
+	 */
+	if (ip->i_flags & XFS_NEED_INACTIVE) {
+		error = -ENOENT;
+		goto out_error;
+	}
+
 	/*
 	 * Check the inode free state is valid. This also detects lookup
 	 * racing with unlinks.
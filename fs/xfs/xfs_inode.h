@@ -50,6 +50,7 @@ typedef struct xfs_inode {
 	/* Miscellaneous state. */
 	unsigned long		i_flags;	/* see defined flags below */
 	unsigned int		i_delayed_blks;	/* count of delay alloc blks */
+	struct llist_node	i_gclist;	/* background inactivation */
 
 	struct xfs_icdinode	i_d;		/* most of ondisk inode */
 
@@ -221,6 +222,8 @@ static inline bool xfs_is_reflink_inode(struct xfs_inode *ip)
  */
 #define XFS_IRECOVERY		(1 << 11)
 #define XFS_ICOWBLOCKS		(1 << 12)/* has the cowblocks tag set */
+#define XFS_NEED_INACTIVE	(1 << 13)/* queued for background inactivation */
+#define XFS_INACTIVATING	(1 << 14)/* being inactivated in the background */
 
 /*
  * Per-lifetime flags need to be reset when re-using a reclaimable inode during
@@ -44,8 +44,8 @@ xlog_cil_ticket_alloc(
 				KM_SLEEP|KM_NOFS);
 
 	/*
-	 * set the current reservation to zero so we know to steal the basic
-	 * transaction overhead reservation from the first transaction commit.
+	 * set the current reservation to zero, the basic transaction overhead
+	 * reservation is stolen from the first transaction commit.
 	 */
 	tic->t_curr_res = 0;
 	return tic;
@@ -384,6 +384,13 @@ insert:
  * if the change requires additional log metadata. If it does, take that space
  * as well. Remove the amount of space we added to the checkpoint ticket from
  * the current transaction ticket so that the accounting works out correctly.
+ *
+ * All of this is done on the per-cpu CIL structure of the CPU we are running
+ * on, so that concurrent commits don't serialise on a CIL wide lock. Holding
+ * the context lock in read mode keeps the push from looking at the per-cpu
+ * structures while we update them, and running with preemption disabled
+ * keeps other commits on this CPU away. The push aggregates everything into
+ * the checkpoint context once it has excluded all commits.
  */
 static void
 xlog_cil_insert_items(
@@ -392,11 +399,13 @@ xlog_cil_insert_items(
 {
 	struct xfs_cil		*cil = log->l_cilp;
 	struct xfs_cil_ctx	*ctx = cil->xc_ctx;
+	struct xlog_cil_pcp	*cilpcp;
 	struct xfs_log_item	*lip;
 	int			len = 0;
 	int			diff_iovecs = 0;
 	int			iclog_space;
 	int			iovhdr_res = 0, split_res = 0, ctx_res = 0;
+	int			order;
 
 	ASSERT(tp);
 
@@ -406,84 +415,102 @@ xlog_cil_insert_items(
 	 */
 	xlog_cil_insert_format_items(log, tp, &len, &diff_iovecs);
 
-	spin_lock(&cil->xc_cil_lock);
-
 	/* account for space used by new iovec headers  */
 	iovhdr_res = diff_iovecs * sizeof(xlog_op_header_t);
 	len += iovhdr_res;
-	ctx->nvecs += diff_iovecs;
+
+	cilpcp = get_cpu_ptr(cil->xc_pcp);
 
 	/* attach the transaction to the CIL if it has any busy extents */
 	if (!list_empty(&tp->t_busy))
-		list_splice_init(&tp->t_busy, &ctx->busy_extents);
+		list_splice_init(&tp->t_busy, &cilpcp->busy_extents);
 
 	/*
 	 * Now transfer enough transaction reservation to the context ticket
 	 * for the checkpoint. The context ticket is special - the unit
 	 * reservation has to grow as well as the current reservation as we
 	 * steal from tickets so we can correctly determine the space used
-	 * during the transaction commit.
+	 * during the transaction commit. The first commit into an empty CIL
+	 * takes the unit reservation, which includes the header of the first
+	 * log record of the checkpoint. Test the bit before doing the atomic
+	 * clear so that the fast path stays free of locked operations.
 	 */
-	if (ctx->ticket->t_curr_res == 0) {
+	if (test_bit(XLOG_CIL_EMPTY, &cil->xc_flags) &&
+	    test_and_clear_bit(XLOG_CIL_EMPTY, &cil->xc_flags)) {
 		ctx_res = ctx->ticket->t_unit_res;
-		ctx->ticket->t_curr_res = ctx_res;
 		tp->t_ticket->t_curr_res -= ctx_res;
 	}
 
-	/* do we need space for more log record headers? */
+	/*
+	 * Do we need space for more log record headers? Each CPU only knows
+	 * how much it added to the checkpoint, so it reserves headers for the
+	 * log record boundaries its own share crosses. That can come up one
+	 * header short per CPU compared to accounting the total, so also take
+	 * one header on the first commit into this checkpoint on every CPU
+	 * but the one that took the unit reservation above.
+	 */
 	iclog_space = log->l_iclog_size - log->l_iclog_hsize;
-	if (len > 0 && (ctx->space_used / iclog_space !=
-				(ctx->space_used + len) / iclog_space)) {
-		split_res = (len + iclog_space - 1) / iclog_space;
+	if (len > 0 && !ctx_res && !cilpcp->space_reserved)
+		split_res = 1;
+	if (len > 0 && (cilpcp->space_used / iclog_space !=
+				(cilpcp->space_used + len) / iclog_space))
+		split_res += (len + iclog_space - 1) / iclog_space;
+	if (split_res) {
 		/* need to take into account split region headers, too */
 		split_res *= log->l_iclog_hsize + sizeof(struct xlog_op_header);
-		ctx->ticket->t_unit_res += split_res;
-		ctx->ticket->t_curr_res += split_res;
 		tp->t_ticket->t_curr_res -= split_res;
 		ASSERT(tp->t_ticket->t_curr_res >= len);
 	}
+	cilpcp->space_reserved += ctx_res + split_res;
 	tp->t_ticket->t_curr_res -= len;
-	ctx->space_used += len;
 
 	/*
-	 * If we've overrun the reservation, dump the tx details before we move
-	 * the log items. Shutdown is imminent...
+	 * Only fold the space used into the context once we have gathered a
+	 * batch of it, the background push doesn't need an exact count.
 	 */
-	if (WARN_ON(tp->t_ticket->t_curr_res < 0)) {
-		xfs_warn(log->l_mp, "Transaction log reservation overrun:");
-		xfs_warn(log->l_mp,
-			 "  log items: %d bytes (iov hdrs: %d bytes)",
-			 len, iovhdr_res);
-		xfs_warn(log->l_mp, "  split region headers: %d bytes",
-			 split_res);
-		xfs_warn(log->l_mp, "  ctx ticket: %d bytes", ctx_res);
-		xlog_print_trans(tp);
+	cilpcp->space_used += len;
+	cilpcp->space_pending += len;
+	if (cilpcp->space_pending > XLOG_CIL_PCP_SPACE_BATCH(log)) {
+		atomic_add(cilpcp->space_pending, &ctx->space_used);
+		cilpcp->space_pending = 0;
 	}
 
 	/*
-	 * Now (re-)position everything modified at the tail of the CIL.
-	 * We do this here so we only need to take the CIL lock once during
-	 * the transaction commit.
+	 * Now (re-)position everything modified on the CIL. Items that are
+	 * already in the CIL may be on the list of another CPU, and we can't
+	 * move them from here. Record the commit order instead, the push sorts
+	 * the checkpoint by it so that items are still written in the order
+	 * they were last modified.
 	 */
+	order = atomic_inc_return(&ctx->order_id);
 	list_for_each_entry(lip, &tp->t_items, li_trans) {
 
 		/* Skip items which aren't dirty in this transaction. */
 		if (!test_bit(XFS_LI_DIRTY, &lip->li_flags))
 			continue;
 
-		/*
-		 * Only move the item if it isn't already at the tail. This is
-		 * to prevent a transient list_empty() state when reinserting
-		 * an item that is already the only item in the CIL.
-		 */
-		if (!list_is_last(&lip->li_cil, &cil->xc_cil))
-			list_move_tail(&lip->li_cil, &cil->xc_cil);
+		lip->li_order_id = order;
+		if (list_empty(&lip->li_cil))
+			list_add_tail(&lip->li_cil, &cilpcp->log_items);
 	}
 
-	spin_unlock(&cil->xc_cil_lock);
+	put_cpu_ptr(cilpcp);
 
-	if (tp->t_ticket->t_curr_res < 0)
+	/*
+	 * If we've overrun the reservation, dump the tx details. Shutdown is
+	 * imminent...
+	 */
+	if (WARN_ON(tp->t_ticket->t_curr_res < 0)) {
+		xfs_warn(log->l_mp, "Transaction log reservation overrun:");
+		xfs_warn(log->l_mp,
+			 "  log items: %d bytes (iov hdrs: %d bytes)",
+			 len, iovhdr_res);
+		xfs_warn(log->l_mp, "  split region headers: %d bytes",
+			 split_res);
+		xfs_warn(log->l_mp, "  ctx ticket: %d bytes", ctx_res);
+		xlog_print_trans(tp);
 		xfs_force_shutdown(log->l_mp, SHUTDOWN_LOG_IO_ERROR);
+	}
 }
 
 static void
@@ -609,6 +636,65 @@ xlog_cil_committed(
 		kmem_free(ctx);
 }
 
+/*
+ * Items relogged on another CPU than the one they were first committed on are
+ * left where they are, so the per-cpu lists are only roughly ordered. Sort
+ * the checkpoint by the order of the last commit of every item.
+ */
+static int
+xlog_cil_order_cmp(
+	void			*priv,
+	struct list_head	*a,
+	struct list_head	*b)
+{
+	struct xfs_log_item	*l1 = container_of(a, struct xfs_log_item, li_cil);
+	struct xfs_log_item	*l2 = container_of(b, struct xfs_log_item, li_cil);
+
+	return l1->li_order_id > l2->li_order_id;
+}
+
+/*
+ * Pull everything the commits have accumulated on the per-cpu structures into
+ * the context being pushed. Must be called with the context lock held in write
+ * mode so that no commit can be modifying them.
+ */
+static void
+xlog_cil_pcp_aggregate(
+	struct xfs_cil		*cil,
+	struct xfs_cil_ctx	*ctx,
+	struct list_head	*log_items)
+{
+	struct xlog_cil_pcp	*cilpcp;
+	int			space_reserved = 0;
+	int			cpu;
+
+	for_each_possible_cpu(cpu) {
+		cilpcp = per_cpu_ptr(cil->xc_pcp, cpu);
+
+		list_splice_init(&cilpcp->log_items, log_items);
+		list_splice_init(&cilpcp->busy_extents, &ctx->busy_extents);
+		space_reserved += cilpcp->space_reserved;
+		atomic_add(cilpcp->space_pending, &ctx->space_used);
+
+		cilpcp->space_reserved = 0;
+		cilpcp->space_used = 0;
+		cilpcp->space_pending = 0;
+	}
+
+	/*
+	 * The context ticket started out with no current reservation, and the
+	 * first commit stole the unit reservation for it. Everything reserved
+	 * on top of that was for additional log record headers, which have to
+	 * be accounted to the unit reservation as well.
+	 */
+	ASSERT(ctx->ticket->t_curr_res == 0);
+	ASSERT(space_reserved >= ctx->ticket->t_unit_res);
+	ctx->ticket->t_curr_res = space_reserved;
+	ctx->ticket->t_unit_res = space_reserved;
+
+	list_sort(NULL, log_items, xlog_cil_order_cmp);
+}
+
 /*
  * Push the Committed Item List to the log. If @push_seq flag is zero, then it
  * is a background flush and so we can chose to ignore it. Otherwise, if the
@@ -640,6 +726,7 @@ xlog_cil_push(
 	struct xfs_log_vec	lvhdr = { NULL };
 	xfs_lsn_t		commit_lsn;
 	xfs_lsn_t		push_seq;
+	LIST_HEAD(log_items);
 
 	if (!cil)
 		return 0;
@@ -659,7 +746,7 @@ xlog_cil_push(
 	 * move on to a new sequence number and so we have to be able to push
 	 * this sequence again later.
 	 */
-	if (list_empty(&cil->xc_cil)) {
+	if (test_bit(XLOG_CIL_EMPTY, &cil->xc_flags)) {
 		cil->xc_push_seq = 0;
 		spin_unlock(&cil->xc_push_lock);
 		goto out_skip;
@@ -701,16 +788,17 @@ xlog_cil_push(
 
 	/*
 	 * pull all the log vectors off the items in the CIL, and
-	 * remove the items from the CIL. We don't need the CIL lock
-	 * here because it's only needed on the transaction commit
-	 * side which is currently locked out by the flush lock.
+	 * remove the items from the CIL. We don't need any locking
+	 * here because the transaction commit side is currently
+	 * locked out by the flush lock.
 	 */
+	xlog_cil_pcp_aggregate(cil, ctx, &log_items);
 	lv = NULL;
 	num_iovecs = 0;
-	while (!list_empty(&cil->xc_cil)) {
+	while (!list_empty(&log_items)) {
 		struct xfs_log_item	*item;
 
-		item = list_first_entry(&cil->xc_cil,
+		item = list_first_entry(&log_items,
 					struct xfs_log_item, li_cil);
 		list_del_init(&item->li_cil);
 		if (!ctx->lv_chain)
@@ -733,6 +821,7 @@ xlog_cil_push(
 	new_ctx->sequence = ctx->sequence + 1;
 	new_ctx->cil = cil;
 	cil->xc_ctx = new_ctx;
+	set_bit(XLOG_CIL_EMPTY, &cil->xc_flags);
 
 	/*
 	 * The switch is now done, so we can drop the context lock and move out
@@ -889,13 +978,13 @@ xlog_cil_push_background(
 	 * The cil won't be empty because we are called while holding the
 	 * context lock so whatever we added to the CIL will still be there
 	 */
-	ASSERT(!list_empty(&cil->xc_cil));
+	ASSERT(!test_bit(XLOG_CIL_EMPTY, &cil->xc_flags));
 
 	/*
 	 * don't do a background push if we haven't used up all the
 	 * space available yet.
 	 */
-	if (cil->xc_ctx->space_used < XLOG_CIL_SPACE_LIMIT(log))
+	if (atomic_read(&cil->xc_ctx->space_used) < XLOG_CIL_SPACE_LIMIT(log))
 		return;
 
 	spin_lock(&cil->xc_push_lock);
@@ -933,7 +1022,8 @@ xlog_cil_push_now(
 	 * there's no work we need to do.
 	 */
 	spin_lock(&cil->xc_push_lock);
-	if (list_empty(&cil->xc_cil) || push_seq <= cil->xc_push_seq) {
+	if (test_bit(XLOG_CIL_EMPTY, &cil->xc_flags) ||
+	    push_seq <= cil->xc_push_seq) {
 		spin_unlock(&cil->xc_push_lock);
 		return;
 	}
@@ -951,7 +1041,7 @@ xlog_cil_empty(
 	bool		empty = false;
 
 	spin_lock(&cil->xc_push_lock);
-	if (list_empty(&cil->xc_cil))
+	if (test_bit(XLOG_CIL_EMPTY, &cil->xc_flags))
 		empty = true;
 	spin_unlock(&cil->xc_push_lock);
 	return empty;
@@ -1095,7 +1185,7 @@ restart:
 	 * we would have found the context on the committing list.
 	 */
 	if (sequence == cil->xc_current_sequence &&
-	    !list_empty(&cil->xc_cil)) {
+	    !test_bit(XLOG_CIL_EMPTY, &cil->xc_flags)) {
 		spin_unlock(&cil->xc_push_lock);
 		goto restart;
 	}
@@ -1154,21 +1244,29 @@ xlog_cil_init(
 {
 	struct xfs_cil	*cil;
 	struct xfs_cil_ctx *ctx;
+	struct xlog_cil_pcp *cilpcp;
+	int		cpu;
 
 	cil = kmem_zalloc(sizeof(*cil), KM_SLEEP|KM_MAYFAIL);
 	if (!cil)
 		return -ENOMEM;
 
 	ctx = kmem_zalloc(sizeof(*ctx), KM_SLEEP|KM_MAYFAIL);
-	if (!ctx) {
-		kmem_free(cil);
-		return -ENOMEM;
+	if (!ctx)
+		goto out_free_cil;
+
+	cil->xc_pcp = alloc_percpu(struct xlog_cil_pcp);
+	if (!cil->xc_pcp)
+		goto out_free_ctx;
+
+	for_each_possible_cpu(cpu) {
+		cilpcp = per_cpu_ptr(cil->xc_pcp, cpu);
+		INIT_LIST_HEAD(&cilpcp->busy_extents);
+		INIT_LIST_HEAD(&cilpcp->log_items);
 	}
 
 	INIT_WORK(&cil->xc_push_work, xlog_cil_push_work);
-	INIT_LIST_HEAD(&cil->xc_cil);
 	INIT_LIST_HEAD(&cil->xc_committing);
-	spin_lock_init(&cil->xc_cil_lock);
 	spin_lock_init(&cil->xc_push_lock);
 	init_rwsem(&cil->xc_ctx_lock);
 	init_waitqueue_head(&cil->xc_commit_wait);
@@ -1179,10 +1277,17 @@ xlog_cil_init(
 	ctx->cil = cil;
 	cil->xc_ctx = ctx;
 	cil->xc_current_sequence = ctx->sequence;
+	set_bit(XLOG_CIL_EMPTY, &cil->xc_flags);
 
 	cil->xc_log = log;
 	log->l_cilp = cil;
 	return 0;
+
+out_free_ctx:
+	kmem_free(ctx);
+out_free_cil:
+	kmem_free(cil);
+	return -ENOMEM;
 }
 
 void
@@ -1195,7 +1300,8 @@ xlog_cil_destroy(
 		kmem_free(log->l_cilp->xc_ctx);
 	}
 
-	ASSERT(list_empty(&log->l_cilp->xc_cil));
+	ASSERT(test_bit(XLOG_CIL_EMPTY, &log->l_cilp->xc_flags));
+	free_percpu(log->l_cilp->xc_pcp);
 	kmem_free(log->l_cilp);
 }
 
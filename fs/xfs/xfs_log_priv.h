@@ -239,8 +239,8 @@ struct xfs_cil_ctx {
 	xfs_lsn_t		start_lsn;	/* first LSN of chkpt commit */
 	xfs_lsn_t		commit_lsn;	/* chkpt commit record lsn */
 	struct xlog_ticket	*ticket;	/* chkpt ticket */
-	int			nvecs;		/* number of regions */
-	int			space_used;	/* aggregate size of regions */
+	atomic_t		space_used;	/* aggregate size of regions */
+	atomic_t		order_id;	/* last commit order */
 	struct list_head	busy_extents;	/* busy extents in chkpt */
 	struct xfs_log_vec	*lv_chain;	/* logvecs being pushed */
 	struct xfs_log_callback	log_cb;		/* completion callback hook. */
@@ -264,10 +264,23 @@ struct xfs_cil_ctx {
  * the commit LSN to be determined as well. This should make synchronous
  * operations almost as efficient as the old logging methods.
  */
+/*
+ * Per-cpu part of the CIL. Transaction commits add their items and account
+ * their space here, without sharing any cachelines with commits running on
+ * other CPUs. The push moves it all into the checkpoint context.
+ */
+struct xlog_cil_pcp {
+	int			space_used;	/* added to this chkpt */
+	int			space_pending;	/* not in ctx->space_used yet */
+	int			space_reserved;	/* stolen for the chkpt ticket */
+	struct list_head	busy_extents;
+	struct list_head	log_items;
+};
+
 struct xfs_cil {
 	struct xlog		*xc_log;
-	struct list_head	xc_cil;
-	spinlock_t		xc_cil_lock;
+	unsigned long		xc_flags;
+	struct xlog_cil_pcp __percpu *xc_pcp;
 
 	struct rw_semaphore	xc_ctx_lock ____cacheline_aligned_in_smp;
 	struct xfs_cil_ctx	*xc_ctx;
@@ -280,6 +293,9 @@ struct xfs_cil {
 	struct work_struct	xc_push_work;
 } ____cacheline_aligned_in_smp;
 
+/* xc_flags bit values */
+#define	XLOG_CIL_EMPTY		0	/* no commits in the current chkpt */
+
 /*
  * The amount of log space we allow the CIL to aggregate is difficult to size.
  * Whatever we choose, we have to make sure we can get a reservation for the
@@ -329,6 +345,14 @@ struct xfs_cil {
  */
 #define XLOG_CIL_SPACE_LIMIT(log)	(log->l_logsize >> 3)
 
+/*
+ * Commits only add the space they use to the checkpoint context once a CPU
+ * has gathered this much of it, so the background push may see the context
+ * as up to a quarter of the space limit smaller than it really is.
+ */
+#define XLOG_CIL_PCP_SPACE_BATCH(log)	\
+	(XLOG_CIL_SPACE_LIMIT(log) / (4 * num_online_cpus()))
+
 /*
  * ticket grant locks, queues and accounting have their own cachlines
  * as these are quite hot and can be operated on concurrently.
@@ -5861,6 +5861,7 @@ xlog_recover_finish(
 		xfs_log_force(log->l_mp, XFS_LOG_SYNC);
 
 		xlog_recover_process_iunlinks(log);
+		xfs_inodegc_flush(log->l_mp);
 
 		xlog_recover_check_summary(log);
 
@@ -1063,6 +1063,12 @@ xfs_unmountfs(
 	uint64_t		resblks;
 	int			error;
 
+	/*
+	 * Finish inactivating unlinked inodes while quotas and the per-AG
+	 * reservations are still around.
+	 */
+	xfs_inodegc_flush(mp);
+
 	xfs_icache_disable_reclaim(mp);
 	xfs_fs_unreserve_ag_blocks(mp);
 	xfs_qm_unmount_quotas(mp);
@@ -890,8 +890,15 @@ xfs_init_mount_workqueues(
 	if (!mp->m_sync_workqueue)
 		goto out_destroy_eofb;
 
+	mp->m_inodegc_workqueue = alloc_workqueue("xfs-inodegc/%s",
+			WQ_MEM_RECLAIM|WQ_FREEZABLE, 0, mp->m_fsname);
+	if (!mp->m_inodegc_workqueue)
+		goto out_destroy_sync;
+
 	return 0;
 
+out_destroy_sync:
+	destroy_workqueue(mp->m_sync_workqueue);
 out_destroy_eofb:
 	destroy_workqueue(mp->m_eofblocks_workqueue);
 out_destroy_log:
@@ -914,6 +921,7 @@ STATIC void
 xfs_destroy_mount_workqueues(
 	struct xfs_mount	*mp)
 {
+	destroy_workqueue(mp->m_inodegc_workqueue);
 	destroy_workqueue(mp->m_sync_workqueue);
 	destroy_workqueue(mp->m_eofblocks_workqueue);
 	destroy_workqueue(mp->m_log_workqueue);
@@ -940,6 +948,9 @@ xfs_flush_inodes(
 		sync_inodes_sb(sb);
 		up_read(&sb->s_umount);
 	}
+
+	/* unlinked inodes still being inactivated hold on to space, too */
+	xfs_inodegc_flush(mp);
 }
 
 /* Catch misguided souls that try to use this interface on XFS */
@@ -967,17 +978,21 @@ xfs_fs_destroy_inode(
 	XFS_STATS_INC(ip->i_mount, vn_rele);
 	XFS_STATS_INC(ip->i_mount, vn_remove);
 
-	xfs_inactive(ip);
-
-	ASSERT(XFS_FORCED_SHUTDOWN(ip->i_mount) || ip->i_delayed_blks == 0);
-	XFS_STATS_INC(ip->i_mount, vn_reclaim);
-
 	/*
 	 * We should never get here with one of the reclaim flags already set.
 	 */
 	ASSERT_ALWAYS(!xfs_iflags_test(ip, XFS_IRECLAIMABLE));
 	ASSERT_ALWAYS(!xfs_iflags_test(ip, XFS_IRECLAIM));
 
+	/* unlinked inodes are inactivated and reclaimed in the background */
+	if (xfs_inodegc_queue(ip))
+		return;
+
+	xfs_inactive(ip);
+
+	ASSERT(XFS_FORCED_SHUTDOWN(ip->i_mount) || ip->i_delayed_blks == 0);
+	XFS_STATS_INC(ip->i_mount, vn_reclaim);
+
 	/*
 	 * We always use background reclaim here because even if the
 	 * inode is clean, it still may be under IO and hence we have
@@ -1087,6 +1102,7 @@ xfs_fs_sync_fs(
 	if (!wait)
 		return 0;
 
+	xfs_inodegc_flush(mp);
 	xfs_log_force(mp, XFS_LOG_SYNC);
 	if (laptop_mode) {
 		/*
@@ -1115,6 +1131,12 @@ xfs_fs_statfs(
 	xfs_extlen_t		lsize;
 	int64_t			ffree;
 
+	/*
+	 * Make sure the space and inodes of unlinked files waiting for
+	 * background inactivation show up as free.
+	 */
+	xfs_inodegc_flush(mp);
+
 	statp->f_type = XFS_SB_MAGIC;
 	statp->f_namelen = MAXNAMELEN - 1;
 
@@ -1379,6 +1401,9 @@ xfs_fs_remount(
 
 	/* rw -> ro */
 	if (!(mp->m_flags & XFS_MOUNT_RDONLY) && (*flags & SB_RDONLY)) {
+		/* Inactivation can't finish once we are read-only. */
+		xfs_inodegc_flush(mp);
+
 		/*
 		 * Cancel background eofb scanning so it cannot race with the
 		 * final log force+buftarg wait and deadlock the remount.
@@ -1557,6 +1582,26 @@ xfs_reinit_percpu_counters(
 	percpu_counter_set(&mp->m_fdblocks, mp->m_sb.sb_fdblocks);
 }
 
+static int
+xfs_inodegc_init_percpu(
+	struct xfs_mount	*mp)
+{
+	struct xfs_inodegc	*gc;
+	int			cpu;
+
+	mp->m_inodegc = alloc_percpu(struct xfs_inodegc);
+	if (!mp->m_inodegc)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		gc = per_cpu_ptr(mp->m_inodegc, cpu);
+		init_llist_head(&gc->list);
+		INIT_WORK(&gc->work, xfs_inodegc_worker);
+		gc->items = 0;
+	}
+	return 0;
+}
+
 static void
 xfs_destroy_percpu_counters(
 	struct xfs_mount	*mp)
@@ -1649,11 +1694,15 @@ xfs_fs_fill_super(
 	if (error)
 		goto out_destroy_workqueues;
 
+	error = xfs_inodegc_init_percpu(mp);
+	if (error)
+		goto out_destroy_counters;
+
 	/* Allocate stats memory before we do operations that might use it */
 	mp->m_stats.xs_stats = alloc_percpu(struct xfsstats);
 	if (!mp->m_stats.xs_stats) {
 		error = -ENOMEM;
-		goto out_destroy_counters;
+		goto out_free_inodegc;
 	}
 
 	error = xfs_readsb(mp, flags);
@@ -1759,6 +1808,8 @@ xfs_fs_fill_super(
 	xfs_freesb(mp);
  out_free_stats:
 	free_percpu(mp->m_stats.xs_stats);
+ out_free_inodegc:
+	free_percpu(mp->m_inodegc);
  out_destroy_counters:
 	xfs_destroy_percpu_counters(mp);
  out_destroy_workqueues:
@@ -1794,6 +1845,7 @@ xfs_fs_put_super(
 
 	xfs_freesb(mp);
 	free_percpu(mp->m_stats.xs_stats);
+	free_percpu(mp->m_inodegc);
 	xfs_destroy_percpu_counters(mp);
 	xfs_destroy_mount_workqueues(mp);
 	xfs_close_devices(mp);
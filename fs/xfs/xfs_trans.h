@@ -46,6 +46,7 @@ typedef struct xfs_log_item {
 
 	/* delayed logging */
 	struct list_head		li_cil;		/* CIL pointers */
+	int				li_order_id;	/* CIL commit order */
 	struct xfs_log_vec		*li_lv;		/* active log vector */
 	struct xfs_log_vec		*li_lv_shadow;	/* standby vector */
 	xfs_lsn_t			li_seq;		/* CIL commit seq */
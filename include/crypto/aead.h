@@ -115,6 +115,12 @@ struct aead_request {
  * @setkey: see struct skcipher_alg
  * @encrypt: see struct skcipher_alg
  * @decrypt: see struct skcipher_alg
+ * @encrypt_batch: Encrypt several independent requests sharing this
+ *		   transformation in one call. The result of each request is
+ *		   stored in the corresponding slot of the error array, using
+ *		   the same convention as @encrypt. Optional; if not set, the
+ *		   requests are passed to @encrypt one at a time.
+ * @decrypt_batch: Batched counterpart of @decrypt, see @encrypt_batch.
  * @geniv: see struct skcipher_alg
  * @ivsize: see struct skcipher_alg
  * @chunksize: see struct skcipher_alg
@@ -131,7 +137,8 @@ struct aead_request {
  *	  @init.
  * @base: Definition of a generic crypto cipher algorithm.
  *
- * All fields except @ivsize is mandatory and must be filled.
+ * All fields except @ivsize, @encrypt_batch and @decrypt_batch are mandatory
+ * and must be filled.
  */
 struct aead_alg {
 	int (*setkey)(struct crypto_aead *tfm, const u8 *key,
@@ -139,6 +146,10 @@ struct aead_alg {
 	int (*setauthsize)(struct crypto_aead *tfm, unsigned int authsize);
 	int (*encrypt)(struct aead_request *req);
 	int (*decrypt)(struct aead_request *req);
+	void (*encrypt_batch)(struct aead_request **reqs, int *err,
+			      unsigned int nreqs);
+	void (*decrypt_batch)(struct aead_request **reqs, int *err,
+			      unsigned int nreqs);
 	int (*init)(struct crypto_aead *tfm);
 	void (*exit)(struct crypto_aead *tfm);
 
@@ -370,6 +381,41 @@ static inline int crypto_aead_decrypt(struct aead_request *req)
 	return crypto_aead_alg(aead)->decrypt(req);
 }
 
+/**
+ * crypto_aead_encrypt_batch() - encrypt several independent requests
+ * @reqs: array of request handles, all referring to the same cipher handle
+ * @err: array receiving the result of each request
+ * @nreqs: number of requests in @reqs
+ *
+ * Submit @nreqs fully set up requests to the cipher in one call. This allows
+ * an implementation to amortize its per-call setup (such as saving the FPU
+ * state) over all requests, or to process the requests in parallel SIMD
+ * lanes. Each entry of @err receives what crypto_aead_encrypt() would have
+ * returned for the corresponding request, including -EINPROGRESS or -EBUSY
+ * when that request completes asynchronously through its callback.
+ *
+ * Return: 0 if all requests were submitted; -EINVAL if the requests do not
+ *	   share one cipher handle; -ENOKEY if no key was set. In the error
+ *	   cases no request was submitted and @err is left untouched.
+ */
+int crypto_aead_encrypt_batch(struct aead_request **reqs, int *err,
+			      unsigned int nreqs);
+
+/**
+ * crypto_aead_decrypt_batch() - decrypt several independent requests
+ * @reqs: array of request handles, all referring to the same cipher handle
+ * @err: array receiving the result of each request
+ * @nreqs: number of requests in @reqs
+ *
+ * Batched counterpart of crypto_aead_decrypt(), see
+ * crypto_aead_encrypt_batch(). A request whose ciphertext is shorter than
+ * the authentication tag gets -EINVAL in its @err slot.
+ *
+ * Return: see crypto_aead_encrypt_batch()
+ */
+int crypto_aead_decrypt_batch(struct aead_request **reqs, int *err,
+			      unsigned int nreqs);
+
 /**
  * DOC: Asynchronous AEAD Request Handle
  *
@@ -55,6 +55,8 @@ extern void exit_robust_list(struct task_struct *curr);
 
 long do_futex(u32 __user *uaddr, int op, u32 val, ktime_t *timeout,
 	      u32 __user *uaddr2, u32 val2, u32 val3);
+int futex_hash_prctl(unsigned long cmd, unsigned long slots);
+void futex_mm_free(struct mm_struct *mm);
 #ifdef CONFIG_HAVE_FUTEX_CMPXCHG
 #define futex_cmpxchg_enabled 1
 #else
@@ -71,6 +73,15 @@ static inline long do_futex(u32 __user *uaddr, int op, u32 val,
 {
 	return -EINVAL;
 }
+
+static inline int futex_hash_prctl(unsigned long cmd, unsigned long slots)
+{
+	return -EINVAL;
+}
+
+static inline void futex_mm_free(struct mm_struct *mm)
+{
+}
 #endif
 
 #ifdef CONFIG_FUTEX_PI
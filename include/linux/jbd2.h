@@ -28,6 +28,7 @@
 #include <linux/stddef.h>
 #include <linux/mutex.h>
 #include <linux/timer.h>
+#include <linux/workqueue.h>
 #include <linux/slab.h>
 #include <linux/bit_spinlock.h>
 #include <crypto/hash.h>
@@ -1002,6 +1003,15 @@ struct journal_s
 	 */
 	struct task_struct	*j_task;
 
+	/**
+	 * @j_next_data_work:
+	 *
+	 * Starts the ordered data writeout of the running transaction once
+	 * its commit has been requested, while the committing transaction
+	 * waits for its log I/O.
+	 */
+	struct work_struct	j_next_data_work;
+
 	/**
 	 * @j_max_transaction_buffers:
 	 *
@@ -1269,6 +1279,7 @@ void jbd2_update_log_tail(journal_t *journal, tid_t tid, unsigned long block);
 
 /* Commit management */
 extern void jbd2_journal_commit_transaction(journal_t *);
+extern void jbd2_journal_next_data_work(struct work_struct *);
 
 /* Checkpoint list management */
 void __jbd2_journal_clean_checkpoint_list(journal_t *journal, bool destroy);
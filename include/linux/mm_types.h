@@ -27,6 +27,7 @@ typedef int vm_fault_t;
 struct address_space;
 struct mem_cgroup;
 struct hmm;
+struct futex_hash_bucket;
 
 /*
  * Each physical page in the system has a struct page associated with
@@ -432,6 +433,11 @@ struct mm_struct {
 	spinlock_t			ioctx_lock;
 	struct kioctx_table __rcu	*ioctx_table;
 #endif
+#ifdef CONFIG_FUTEX
+	/* Private futex hash, see futex_hash_prctl() */
+	struct futex_hash_bucket	*futex_hash;
+	unsigned long			futex_hash_size;
+#endif
 #ifdef CONFIG_MEMCG
 	/*
 	 * "owner" points to a task that is regarded as the canonical
@@ -4,6 +4,9 @@
 
 #define PIPE_DEF_BUFFERS	16
 
+/* Largest order of the pages backing a pipe buffer that write() allocates */
+#define PIPE_MAX_BUF_ORDER	PAGE_ALLOC_COSTLY_ORDER
+
 #define PIPE_BUF_FLAG_LRU	0x01	/* page is on the LRU */
 #define PIPE_BUF_FLAG_ATOMIC	0x02	/* was atomically mapped */
 #define PIPE_BUF_FLAG_GIFT	0x04	/* page is a gift */
@@ -38,6 +41,9 @@ struct pipe_buffer {
  *	@writers: number of current writers of this pipe
  *	@files: number of struct file referring this pipe (protected by ->i_lock)
  *	@waiting_writers: number of writers blocked waiting for room
+ *	@buf_order: order of the pages write() allocates for new buffers
+ *	@size_fixed: the size was set with F_SETPIPE_SZ, don't grow @buf_order
+ *	@poll_usage: the pipe has been polled, wake up on every read/write
  *	@r_counter: reader counter
  *	@w_counter: writer counter
  *	@fasync_readers: reader side fasync
@@ -53,6 +59,9 @@ struct pipe_inode_info {
 	unsigned int writers;
 	unsigned int files;
 	unsigned int waiting_writers;
+	unsigned int buf_order;
+	bool size_fixed;
+	bool poll_usage;
 	unsigned int r_counter;
 	unsigned int w_counter;
 	struct page *tmp_page;
@@ -62,6 +71,17 @@ struct pipe_inode_info {
 	struct user_struct *user;
 };
 
+/**
+ * pipe_nr_pages - Return the capacity of a pipe in pages
+ * @pipe:	the pipe
+ *
+ * This is what the pipe is accounted for against the per-user limits.
+ */
+static inline unsigned long pipe_nr_pages(struct pipe_inode_info *pipe)
+{
+	return (unsigned long)pipe->buffers << pipe->buf_order;
+}
+
 /*
  * Note on the nesting of these functions:
  *
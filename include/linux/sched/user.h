@@ -39,7 +39,7 @@ struct user_struct {
 	kuid_t uid;
 
 #if defined(CONFIG_PERF_EVENTS) || defined(CONFIG_BPF_SYSCALL) || \
-    defined(CONFIG_NET)
+    defined(CONFIG_NET) || IS_ENABLED(CONFIG_FUSE_FS)
 	atomic_long_t locked_vm;
 #endif
 
@@ -19,13 +19,16 @@
 #include <linux/sunrpc/svcauth.h>
 #include <linux/wait.h>
 #include <linux/mm.h>
+#include <linux/llist.h>
 
 /* statistics for svc_pool structures */
 struct svc_pool_stats {
 	atomic_long_t	packets;
-	unsigned long	sockets_queued;
+	atomic_long_t	sockets_queued;
 	atomic_long_t	threads_woken;
 	atomic_long_t	threads_timedout;
+	atomic_long_t	sockets_waiting;	/* currently queued */
+	atomic64_t	queue_time;		/* ns spent queued, in total */
 };
 
 /*
@@ -40,8 +43,13 @@ struct svc_pool_stats {
  */
 struct svc_pool {
 	unsigned int		sp_id;	    	/* pool id; also node id on NUMA */
-	spinlock_t		sp_lock;	/* protects all fields */
+	spinlock_t		sp_lock;	/* protects sp_sockets, and
+						 * updates of sp_nrthreads
+						 * and sp_all_threads */
 	struct list_head	sp_sockets;	/* pending sockets */
+	struct llist_head	sp_new_sockets;	/* sockets queued without
+						 * sp_lock, not yet moved
+						 * to sp_sockets */
 	unsigned int		sp_nrthreads;	/* # of threads in pool */
 	struct list_head	sp_all_threads;	/* all server threads */
 	struct svc_pool_stats	sp_stats;	/* statistics on pool operation */
@@ -443,6 +451,7 @@ struct svc_procedure {
  * Mode for mapping cpus to pools.
  */
 enum {
+	SVC_POOL_DEFAULT = -2,	/* pernode on NUMA machines, else global */
 	SVC_POOL_AUTO = -1,	/* choose one of the others */
 	SVC_POOL_GLOBAL,	/* no mapping, just a single global pool
 				 * (legacy & UP mode) */
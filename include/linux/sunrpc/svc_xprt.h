@@ -54,6 +54,8 @@ struct svc_xprt {
 	struct kref		xpt_ref;
 	struct list_head	xpt_list;
 	struct list_head	xpt_ready;
+	struct llist_node	xpt_ready_node;	/* on sp_new_sockets */
+	ktime_t			xpt_qtime;	/* when it was queued */
 	unsigned long		xpt_flags;
 #define	XPT_BUSY	0		/* enqueued/receiving */
 #define	XPT_CONN	1		/* conn pending */
@@ -209,6 +209,7 @@ struct rpc_xprt {
 	 * Multipath
 	 */
 	struct list_head	xprt_switch;
+	atomic_long_t		queuelen;	/* tasks using this transport */
 
 	/*
 	 * Connection of transports
@@ -50,6 +50,7 @@ struct stat64;
 struct statfs;
 struct statfs64;
 struct statx;
+struct dirent_statx;
 struct __sysctl_args;
 struct sysinfo;
 struct timespec;
@@ -903,6 +904,10 @@ asmlinkage long sys_pkey_alloc(unsigned long flags, unsigned long init_val);
 asmlinkage long sys_pkey_free(int pkey);
 asmlinkage long sys_statx(int dfd, const char __user *path, unsigned flags,
 			  unsigned mask, struct statx __user *buffer);
+asmlinkage long sys_getdents_statx(unsigned int fd,
+				   struct dirent_statx __user *dirent,
+				   unsigned int count, unsigned int flags,
+				   unsigned int mask);
 asmlinkage long sys_rseq(struct rseq __user *rseq, uint32_t rseq_len,
 			 int flags, uint32_t sig);
 
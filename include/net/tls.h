@@ -56,8 +56,12 @@
 #define TLS_RECORD_TYPE_DATA		0x17
 
 #define TLS_AAD_SPACE_SIZE		13
+#define TLS13_MAX_EXPANSION		256
 #define TLS_DEVICE_NAME_MAX		32
 
+/* Ciphertext pages kept per socket for reuse once TCP releases them */
+#define TLS_TX_POOL_PAGES		4
+
 /*
  * This structure defines the routines for Inline TLS driver.
  * The following routines are optional and filled with a
@@ -85,6 +89,7 @@ struct tls_device {
 
 struct tls_sw_context_tx {
 	struct crypto_aead *aead_send;
+	struct aead_request *aead_req;
 	struct crypto_wait async_wait;
 
 	char aad_space[TLS_AAD_SPACE_SIZE];
@@ -101,6 +106,12 @@ struct tls_sw_context_tx {
 	struct scatterlist sg_aead_in[2];
 	/* AAD | sg_encrypted_data (data contain overhead for hdr&iv&tag) */
 	struct scatterlist sg_aead_out[2];
+
+	/* Each page holds one full record; sg_encrypted_data[0] lives in
+	 * one of them while tx_pool_record is set.
+	 */
+	struct page *tx_pool[TLS_TX_POOL_PAGES];
+	bool tx_pool_record;
 };
 
 struct tls_sw_context_rx {
@@ -118,6 +129,8 @@ struct tls_sw_context_rx {
 	char rx_aad_ciphertext[TLS_AAD_SPACE_SIZE];
 	char rx_aad_plaintext[TLS_AAD_SPACE_SIZE];
 
+	/* protected by the socket lock */
+	struct tls_rx_stats stats;
 };
 
 struct tls_record_info {
@@ -156,9 +169,11 @@ enum {
 };
 
 struct cipher_context {
+	u16 version;
 	u16 prepend_size;
 	u16 tag_size;
 	u16 overhead_size;
+	u16 aad_size;
 	u16 iv_size;
 	char *iv;
 	u16 rec_seq_size;
@@ -319,6 +334,13 @@ static inline void tls_advance_record_sn(struct sock *sk,
 {
 	if (tls_bigint_increment(ctx->rec_seq, ctx->rec_seq_size))
 		tls_err_abort(sk, EBADMSG);
+
+	/* TLS 1.3 derives the nonce from the sequence number, the static
+	 * IV must be left alone.
+	 */
+	if (ctx->version == TLS_1_3_VERSION)
+		return;
+
 	tls_bigint_increment(ctx->iv + TLS_CIPHER_AES_GCM_128_SALT_SIZE,
 			     ctx->iv_size);
 }
@@ -360,6 +382,18 @@ static inline void tls_make_aad(char *buf,
 	buf[12] = size & 0xFF;
 }
 
+/* TLS 1.3 authenticates the outer record header, which always claims
+ * to be TLS 1.2 application data (RFC 8446, section 5.2).
+ */
+static inline void tls13_make_aad(char *buf, size_t size)
+{
+	buf[0] = TLS_RECORD_TYPE_DATA;
+	buf[1] = TLS_1_2_VERSION_MAJOR;
+	buf[2] = TLS_1_2_VERSION_MINOR;
+	buf[3] = size >> 8;
+	buf[4] = size & 0xFF;
+}
+
 static inline struct tls_context *tls_get_ctx(const struct sock *sk)
 {
 	struct inet_connection_sock *icsk = inet_csk(sk);
@@ -116,6 +116,20 @@
  *
  *  7.27
  *  - add FUSE_ABORT_ERROR
+ *
+ *  7.28
+ *  - add FUSE_MAX_PAGES, add max_pages to init_out
+ *
+ *  Local extensions, not part of any minor version:
+ *  - add FUSE_INIT_EXT, add flags2 to init_in and init_out, numbered as
+ *    in upstream 7.36
+ *  - add FUSE_RING, FUSE_DEV_IOC_RING_SETUP and FUSE_DEV_IOC_RING_ENTER
+ *  - add FUSE_PASSTHROUGH, FOPEN_PASSTHROUGH and FUSE_DEV_IOC_PASSTHROUGH_OPEN
+ *  - add passthrough_fh to fuse_open_out, replacing padding
+ *
+ *  Local extensions use bits from the top of flags2 and open_flags down,
+ *  which upstream allocates from the bottom up, so that daemons written
+ *  for upstream never request them by accident.
  */
 
 #ifndef _LINUX_FUSE_H
@@ -151,7 +165,7 @@
 #define FUSE_KERNEL_VERSION 7
 
 /** Minor version number of this interface */
-#define FUSE_KERNEL_MINOR_VERSION 27
+#define FUSE_KERNEL_MINOR_VERSION 28
 
 /** The node ID of the root inode */
 #define FUSE_ROOT_ID 1
@@ -219,10 +233,12 @@ struct fuse_file_lock {
  * FOPEN_DIRECT_IO: bypass page cache for this open file
  * FOPEN_KEEP_CACHE: don't invalidate the data cache on open
  * FOPEN_NONSEEKABLE: the file is not seekable
+ * FOPEN_PASSTHROUGH: read, write and mmap go to the file in passthrough_fh
  */
 #define FOPEN_DIRECT_IO		(1 << 0)
 #define FOPEN_KEEP_CACHE	(1 << 1)
 #define FOPEN_NONSEEKABLE	(1 << 2)
+#define FOPEN_PASSTHROUGH	(1U << 31)
 
 /**
  * INIT request/reply flags
@@ -249,6 +265,10 @@ struct fuse_file_lock {
  * FUSE_HANDLE_KILLPRIV: fs handles killing suid/sgid/cap on write/chown/trunc
  * FUSE_POSIX_ACL: filesystem supports posix acls
  * FUSE_ABORT_ERROR: reading the device after abort returns ECONNABORTED
+ * FUSE_MAX_PAGES: init_out.max_pages contains the max number of req pages
+ * FUSE_INIT_EXT: extended fuse_init_in and fuse_init_out, flags2 is valid
+ * FUSE_PASSTHROUGH: open files may be backed by a file of the daemon
+ * FUSE_RING: requests can be exchanged through a shared memory ring
  */
 #define FUSE_ASYNC_READ		(1 << 0)
 #define FUSE_POSIX_LOCKS	(1 << 1)
@@ -272,6 +292,12 @@ struct fuse_file_lock {
 #define FUSE_HANDLE_KILLPRIV	(1 << 19)
 #define FUSE_POSIX_ACL		(1 << 20)
 #define FUSE_ABORT_ERROR	(1 << 21)
+#define FUSE_MAX_PAGES		(1 << 22)
+#define FUSE_INIT_EXT		(1 << 30)
+
+/* Bits 32-63 are sent in flags2 */
+#define FUSE_PASSTHROUGH	(1ULL << 62)
+#define FUSE_RING		(1ULL << 63)
 
 /**
  * CUSE INIT request/reply flags
@@ -503,7 +529,7 @@ struct fuse_create_in {
 struct fuse_open_out {
 	uint64_t	fh;
 	uint32_t	open_flags;
-	uint32_t	padding;
+	uint32_t	passthrough_fh;
 };
 
 struct fuse_release_in {
@@ -596,6 +622,8 @@ struct fuse_init_in {
 	uint32_t	minor;
 	uint32_t	max_readahead;
 	uint32_t	flags;
+	uint32_t	flags2;
+	uint32_t	unused[11];
 };
 
 #define FUSE_COMPAT_INIT_OUT_SIZE 8
@@ -610,7 +638,10 @@ struct fuse_init_out {
 	uint16_t	congestion_threshold;
 	uint32_t	max_write;
 	uint32_t	time_gran;
-	uint32_t	unused[9];
+	uint16_t	max_pages;
+	uint16_t	padding;
+	uint32_t	flags2;
+	uint32_t	unused[7];
 };
 
 #define CUSE_INIT_INFO_MAX 4096
@@ -778,8 +809,67 @@ struct fuse_notify_retrieve_in {
 	uint64_t	dummy4;
 };
 
+/*
+ * Request ring
+ *
+ * Instead of one read() and one write() per request, a daemon that
+ * negotiated FUSE_RING may set up a ring of nr_slots buffers of slot_size
+ * bytes each on a device file (usually one clone per worker thread) and
+ * mmap() it at offset 0.  slot_size must be page aligned and hold the
+ * largest WRITE request, i.e. at least max_write plus the fuse_in_header
+ * and fuse_write_in.  The ring is charged to RLIMIT_MEMLOCK.
+ *
+ * FUSE_DEV_IOC_RING_ENTER first completes the slots set in 'commit',
+ * then fills free slots with new requests and returns them in 'ready'.
+ * A ready slot holds the request exactly as read() would return it.  The
+ * daemon writes its reply over it, starting with a fuse_out_header, and
+ * hands the slot back in the next 'commit'.  A reply with out.len == 0
+ * just frees the slot, e.g. after a FORGET.  Data for READ replies can
+ * be read straight into the slot, WRITE data taken straight from it.
+ *
+ * With FUSE_RING_ENTER_WAIT, the call sleeps until at least one request
+ * is ready, busy polling for up to 'poll_us' microseconds first.
+ * Commits are always processed, even if an error is returned.
+ */
+#define FUSE_RING_MAX_SLOTS	64
+#define FUSE_RING_MAX_SIZE	(32 * 1024 * 1024)
+
+struct fuse_ring_setup {
+	uint32_t	nr_slots;
+	uint32_t	slot_size;
+	uint32_t	flags;
+	uint32_t	padding;
+};
+
+#define FUSE_RING_ENTER_WAIT	(1 << 0)
+
+struct fuse_ring_enter {
+	uint64_t	commit;
+	uint64_t	ready;
+	uint32_t	flags;
+	uint32_t	poll_us;
+};
+
+/*
+ * Passthrough
+ *
+ * A daemon that negotiated FUSE_PASSTHROUGH and has CAP_SYS_ADMIN can hand
+ * an open file of its own to FUSE_DEV_IOC_PASSTHROUGH_OPEN, which returns a
+ * positive handle, or EMFILE if too many handles are waiting to be used.
+ * Replying to OPEN or CREATE with FOPEN_PASSTHROUGH and that handle in
+ * passthrough_fh makes read, write and mmap of the new FUSE file go to
+ * the backing file in the kernel, with the credentials of the daemon.
+ * Every handle can be used for one open; unknown handles are ignored and
+ * unused ones are dropped with the connection.  Backing files must not be
+ * on a stacked filesystem.  O_DIRECT on the FUSE file is O_DIRECT on the
+ * backing file, and fails with EINVAL if that doesn't support it.
+ */
+
 /* Device ioctls: */
 #define FUSE_DEV_IOC_CLONE	_IOR(229, 0, uint32_t)
+#define FUSE_DEV_IOC_RING_SETUP	_IOW(229, 1, struct fuse_ring_setup)
+#define FUSE_DEV_IOC_RING_ENTER	_IOWR(229, 2, struct fuse_ring_enter)
+#define FUSE_DEV_IOC_PASSTHROUGH_OPEN	_IOW(229, 3, uint32_t)
 
 struct fuse_lseek_in {
 	uint64_t	fh;
@@ -21,6 +21,7 @@
 #define FUTEX_WAKE_BITSET	10
 #define FUTEX_WAIT_REQUEUE_PI	11
 #define FUTEX_CMP_REQUEUE_PI	12
+#define FUTEX_WAIT_MULTIPLE	13
 
 #define FUTEX_PRIVATE_FLAG	128
 #define FUTEX_CLOCK_REALTIME	256
@@ -40,6 +41,29 @@
 					 FUTEX_PRIVATE_FLAG)
 #define FUTEX_CMP_REQUEUE_PI_PRIVATE	(FUTEX_CMP_REQUEUE_PI | \
 					 FUTEX_PRIVATE_FLAG)
+#define FUTEX_WAIT_MULTIPLE_PRIVATE	(FUTEX_WAIT_MULTIPLE | \
+					 FUTEX_PRIVATE_FLAG)
+
+/*
+ * FUTEX_WAIT_MULTIPLE takes an array of these in uaddr and the number of
+ * entries in val, and returns the index of a futex that was woken. 8 and
+ * 16 bit futexes are woken through the naturally aligned 32 bit word that
+ * contains them.
+ */
+struct futex_wait_block {
+	__u64 uaddr;
+	__u64 val;
+	__u32 flags;
+	__u32 __reserved;
+};
+
+#define FUTEX_WAIT_SIZE_U8	0x00
+#define FUTEX_WAIT_SIZE_U16	0x01
+#define FUTEX_WAIT_SIZE_U32	0x02
+#define FUTEX_WAIT_SIZE_U64	0x03
+#define FUTEX_WAIT_SIZE_MASK	0x03
+
+#define FUTEX_WAIT_MULTIPLE_MAX	128
 
 /*
  * Support for robust futexes: the kernel cleans up held futexes at
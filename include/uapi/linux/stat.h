@@ -127,6 +127,27 @@ struct statx {
 	/* 0x100 */
 };
 
+/*
+ * Records returned by getdents_statx(): the linux_dirent64 fields plus the
+ * attributes of the entry, as statx() with AT_SYMLINK_NOFOLLOW would have
+ * returned them. d_stx_err is 0 if d_stx is valid, a negative errno
+ * otherwise (e.g. -ENOENT if the entry went away meanwhile).
+ */
+struct dirent_statx {
+	/* 0x00 */
+	__u64	d_ino;		/* Inode number */
+	__s64	d_off;		/* Offset to next record */
+	/* 0x10 */
+	__u16	d_reclen;	/* Length of this record */
+	__u8	d_type;		/* DT_* type */
+	__u8	__spare0[1];
+	__s32	d_stx_err;	/* 0 or -errno */
+	/* 0x18 */
+	struct statx d_stx;
+	/* 0x118 */
+	char	d_name[0];	/* NUL terminated name */
+};
+
 /*
  * Flags to be stx_mask
  *
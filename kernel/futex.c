@@ -67,6 +67,7 @@
 #include <linux/freezer.h>
 #include <linux/bootmem.h>
 #include <linux/fault-inject.h>
+#include <linux/prctl.h>
 
 #include <asm/futex.h>
 
@@ -384,20 +385,103 @@ static inline int hb_waiters_pending(struct futex_hash_bucket *hb)
 }
 
 /**
- * hash_futex - Return the hash bucket in the global hash
+ * hash_futex - Return the hash bucket for a futex key
  * @key:	Pointer to the futex key for which the hash is calculated
  *
  * We hash on the keys returned from get_futex_key (see below) and return the
- * corresponding hash bucket in the global hash.
+ * corresponding hash bucket. Process private futexes use the private hash
+ * of their mm if one was set up with PR_FUTEX_HASH, everything else goes to
+ * the global hash.
  */
 static struct futex_hash_bucket *hash_futex(union futex_key *key)
 {
 	u32 hash = jhash2((u32*)&key->both.word,
 			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
 			  key->both.offset);
+
+	if (!(key->both.offset & (FUT_OFF_INODE | FUT_OFF_MMSHARED))) {
+		struct mm_struct *mm = key->private.mm;
+		struct futex_hash_bucket *fh;
+
+		/* Pairs with smp_store_release() in futex_hash_prctl() */
+		fh = smp_load_acquire(&mm->futex_hash);
+		if (fh)
+			return &fh[hash & (mm->futex_hash_size - 1)];
+	}
+
 	return &futex_queues[hash & (futex_hashsize - 1)];
 }
 
+static void futex_hash_init_buckets(struct futex_hash_bucket *fh,
+				    unsigned long size)
+{
+	unsigned long i;
+
+	for (i = 0; i < size; i++) {
+		atomic_set(&fh[i].waiters, 0);
+		plist_head_init(&fh[i].chain);
+		spin_lock_init(&fh[i].lock);
+	}
+}
+
+/**
+ * futex_hash_prctl() - Query or set up the private futex hash of current->mm
+ * @cmd:	PR_FUTEX_HASH_SET_SLOTS or PR_FUTEX_HASH_GET_SLOTS
+ * @slots:	Number of hash buckets wanted, for PR_FUTEX_HASH_SET_SLOTS
+ *
+ * All threads of a process share the global futex hash by default, where
+ * their private futexes compete for buckets (and bucket cachelines) with
+ * every other process in the system. A process can ask for a hash table of
+ * its own, allocated on the local node, instead. The size is rounded up to
+ * a power of two and capped to the size of the global hash.
+ *
+ * The table can only be installed while the process is single threaded and
+ * cannot be changed afterwards, so that no futex_q can ever be queued on a
+ * different bucket than the one its waker looks at.
+ *
+ * Return: the number of buckets of the private hash (0 if there is none)
+ * for PR_FUTEX_HASH_GET_SLOTS, 0 or a negative error code otherwise.
+ */
+int futex_hash_prctl(unsigned long cmd, unsigned long slots)
+{
+	struct mm_struct *mm = current->mm;
+	struct futex_hash_bucket *fh;
+
+	switch (cmd) {
+	case PR_FUTEX_HASH_GET_SLOTS:
+		if (slots)
+			return -EINVAL;
+		return mm->futex_hash ? mm->futex_hash_size : 0;
+	case PR_FUTEX_HASH_SET_SLOTS:
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (!slots)
+		return -EINVAL;
+	if (mm->futex_hash || atomic_read(&mm->mm_users) != 1)
+		return -EBUSY;
+
+	slots = roundup_pow_of_two(min(slots, futex_hashsize));
+	fh = kvmalloc_node(slots * sizeof(*fh), GFP_KERNEL_ACCOUNT,
+			   numa_node_id());
+	if (!fh)
+		return -ENOMEM;
+	futex_hash_init_buckets(fh, slots);
+
+	mm->futex_hash_size = slots;
+	smp_store_release(&mm->futex_hash, fh);
+	return 0;
+}
+
+/* Called from __mmput(), once there are no users of the mm left. */
+void futex_mm_free(struct mm_struct *mm)
+{
+	kvfree(mm->futex_hash);
+	mm->futex_hash = NULL;
+}
+
 
 /**
  * match_futex - Check whether two futex keys are equal
@@ -2698,6 +2782,258 @@ static long futex_wait_restart(struct restart_block *restart)
 				restart->futex.val, tp, restart->futex.bitset);
 }
 
+/*
+ * FUTEX_WAIT_MULTIPLE support: wait on up to FUTEX_WAIT_MULTIPLE_MAX futexes
+ * at once, each of them 8, 16, 32 or 64 bits wide. Every futex is queued
+ * under the key of the naturally aligned 32 bit word that contains its first
+ * byte, so a waker uses a plain FUTEX_WAKE on that word.
+ */
+
+static inline void __user *futex_block_addr(struct futex_wait_block *wb)
+{
+	return (void __user *)(unsigned long)wb->uaddr;
+}
+
+static inline u32 __user *futex_block_word(struct futex_wait_block *wb)
+{
+	return (u32 __user *)((unsigned long)wb->uaddr & ~(sizeof(u32) - 1));
+}
+
+static inline unsigned int futex_block_size(struct futex_wait_block *wb)
+{
+	return 1U << (wb->flags & FUTEX_WAIT_SIZE_MASK);
+}
+
+static int futex_block_value(struct futex_wait_block *wb, u64 *val,
+			     bool locked)
+{
+	union {
+		u8 b;
+		u16 h;
+		u32 w;
+		u64 d;
+	} v;
+	unsigned int size = futex_block_size(wb);
+	unsigned long left;
+
+	if (locked) {
+		pagefault_disable();
+		left = __copy_from_user_inatomic(&v, futex_block_addr(wb),
+						 size);
+		pagefault_enable();
+	} else {
+		left = copy_from_user(&v, futex_block_addr(wb), size);
+	}
+	if (left)
+		return -EFAULT;
+
+	switch (size) {
+	case 1:
+		*val = v.b;
+		break;
+	case 2:
+		*val = v.h;
+		break;
+	case 4:
+		*val = v.w;
+		break;
+	default:
+		*val = v.d;
+		break;
+	}
+	return 0;
+}
+
+/*
+ * Unqueue all the futexes in @qs and drop their key references.
+ *
+ * Return: the index of the first futex which was already unqueued by a
+ * waker, or -1 if none were.
+ */
+static int unqueue_multiple(struct futex_q *qs, int count)
+{
+	int ret = -1;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (!unqueue_me(&qs[i]) && ret < 0)
+			ret = i;
+	}
+	return ret;
+}
+
+/**
+ * futex_wait_multiple_setup() - Prepare to wait on a set of futexes
+ * @wb:		the futexes and the values they are expected to contain
+ * @qs:		one futex_q per entry of @wb
+ * @count:	the number of entries in @wb and @qs
+ * @flags:	futex flags (FLAGS_SHARED, etc.)
+ * @woken:	index of the futex which was woken while setting up
+ *
+ * Like futex_wait_setup(), but every futex is queued as soon as its value
+ * has been checked under its hash bucket lock, so that a wakeup on one of
+ * them can't be lost while the others are being set up. The task state is
+ * set before the first futex is queued for the same reason.
+ *
+ * Return:
+ *  -  0 - all futexes are queued, current is TASK_INTERRUPTIBLE;
+ *  -  1 - one of the futexes was woken during setup, see @woken;
+ *  - <0 - -EFAULT or -EWOULDBLOCK, nothing is queued
+ */
+static int futex_wait_multiple_setup(struct futex_wait_block *wb,
+				     struct futex_q *qs, int count,
+				     unsigned int flags, int *woken)
+{
+	struct futex_hash_bucket *hb;
+	u64 uval;
+	int ret, i, j;
+
+retry:
+	for (i = 0; i < count; i++) {
+		ret = get_futex_key(futex_block_word(&wb[i]),
+				    flags & FLAGS_SHARED, &qs[i].key,
+				    VERIFY_READ);
+		if (unlikely(ret)) {
+			while (--i >= 0)
+				put_futex_key(&qs[i].key);
+			return ret;
+		}
+	}
+
+	set_current_state(TASK_INTERRUPTIBLE);
+
+	for (i = 0; i < count; i++) {
+		hb = queue_lock(&qs[i]);
+
+		ret = futex_block_value(&wb[i], &uval, true);
+		if (!ret && uval == wb[i].val) {
+			queue_me(&qs[i], hb);
+			continue;
+		}
+
+		queue_unlock(hb);
+		__set_current_state(TASK_RUNNING);
+
+		*woken = unqueue_multiple(qs, i);
+		for (j = i; j < count; j++)
+			put_futex_key(&qs[j].key);
+		if (*woken >= 0)
+			return 1;
+
+		if (!ret)
+			return -EWOULDBLOCK;
+
+		/* Fault the page in and start over */
+		ret = futex_block_value(&wb[i], &uval, false);
+		if (ret)
+			return ret;
+		goto retry;
+	}
+
+	return 0;
+}
+
+static int futex_wait_multiple(struct futex_wait_block __user *uwb,
+			       unsigned int flags, u32 count,
+			       ktime_t *abs_time)
+{
+	struct hrtimer_sleeper timeout, *to = NULL;
+	struct futex_wait_block *wb;
+	struct futex_q *qs;
+	int ret, woken, i;
+
+	if (!count || count > FUTEX_WAIT_MULTIPLE_MAX)
+		return -EINVAL;
+
+	wb = kmalloc_array(count, sizeof(*wb), GFP_KERNEL);
+	if (!wb)
+		return -ENOMEM;
+	if (copy_from_user(wb, uwb, count * sizeof(*wb))) {
+		ret = -EFAULT;
+		goto out_free_wb;
+	}
+
+	for (i = 0; i < count; i++) {
+		ret = -EINVAL;
+		if (wb[i].flags & ~FUTEX_WAIT_SIZE_MASK || wb[i].__reserved)
+			goto out_free_wb;
+		if ((unsigned long)wb[i].uaddr != wb[i].uaddr)
+			goto out_free_wb;
+		if (wb[i].uaddr & (futex_block_size(&wb[i]) - 1))
+			goto out_free_wb;
+		ret = -EFAULT;
+		if (!access_ok(VERIFY_READ, futex_block_addr(&wb[i]),
+			       futex_block_size(&wb[i])))
+			goto out_free_wb;
+	}
+
+	qs = kmalloc_array(count, sizeof(*qs), GFP_KERNEL);
+	if (!qs) {
+		ret = -ENOMEM;
+		goto out_free_wb;
+	}
+	for (i = 0; i < count; i++)
+		qs[i] = futex_q_init;
+
+	if (abs_time) {
+		to = &timeout;
+
+		hrtimer_init_on_stack(&to->timer, (flags & FLAGS_CLOCKRT) ?
+				      CLOCK_REALTIME : CLOCK_MONOTONIC,
+				      HRTIMER_MODE_ABS);
+		hrtimer_init_sleeper(to, current);
+		hrtimer_set_expires_range_ns(&to->timer, *abs_time,
+					     current->timer_slack_ns);
+	}
+
+	for (;;) {
+		ret = futex_wait_multiple_setup(wb, qs, count, flags, &woken);
+		if (ret) {
+			if (ret > 0)
+				ret = woken;
+			break;
+		}
+
+		if (to)
+			hrtimer_start_expires(&to->timer, HRTIMER_MODE_ABS);
+		/*
+		 * A wakeup on any of the futexes since it was queued has
+		 * put us back to TASK_RUNNING, so this can't miss it.
+		 */
+		if (!to || to->task)
+			freezable_schedule();
+		__set_current_state(TASK_RUNNING);
+
+		/* unqueue_multiple() drops the key refs */
+		ret = unqueue_multiple(qs, count);
+		if (ret >= 0)
+			break;
+
+		ret = -ETIMEDOUT;
+		if (to && !to->task)
+			break;
+
+		/*
+		 * The timeout is absolute by now, so a restarted syscall
+		 * would wait for too long; let userspace retry instead.
+		 */
+		if (signal_pending(current)) {
+			ret = abs_time ? -EINTR : -ERESTARTSYS;
+			break;
+		}
+		/* Spurious wakeup, queue everything again */
+	}
+
+	if (to) {
+		hrtimer_cancel(&to->timer);
+		destroy_hrtimer_on_stack(&to->timer);
+	}
+	kfree(qs);
+out_free_wb:
+	kfree(wb);
+	return ret;
+}
+
 
 /*
  * Userspace tried a 0 -> TID atomic transition of the futex value
@@ -3547,6 +3883,9 @@ long do_futex(u32 __user *uaddr, int op, u32 val, ktime_t *timeout,
 					     uaddr2);
 	case FUTEX_CMP_REQUEUE_PI:
 		return futex_requeue(uaddr, flags, uaddr2, val, val2, &val3, 1);
+	case FUTEX_WAIT_MULTIPLE:
+		return futex_wait_multiple((void __user *)uaddr, flags, val,
+					   timeout);
 	}
 	return -ENOSYS;
 }
@@ -3563,7 +3902,8 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 
 	if (utime && (cmd == FUTEX_WAIT || cmd == FUTEX_LOCK_PI ||
 		      cmd == FUTEX_WAIT_BITSET ||
-		      cmd == FUTEX_WAIT_REQUEUE_PI)) {
+		      cmd == FUTEX_WAIT_REQUEUE_PI ||
+		      cmd == FUTEX_WAIT_MULTIPLE)) {
 		if (unlikely(should_fail_futex(!(op & FUTEX_PRIVATE_FLAG))))
 			return -EFAULT;
 		if (copy_from_user(&ts, utime, sizeof(ts)) != 0)
@@ -3572,7 +3912,7 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 			return -EINVAL;
 
 		t = timespec_to_ktime(ts);
-		if (cmd == FUTEX_WAIT)
+		if (cmd == FUTEX_WAIT || cmd == FUTEX_WAIT_MULTIPLE)
 			t = ktime_add_safe(ktime_get(), t);
 		tp = &t;
 	}
@@ -3610,7 +3950,6 @@ static void __init futex_detect_cmpxchg(void)
 static int __init futex_init(void)
 {
 	unsigned int futex_shift;
-	unsigned long i;
 
 #if CONFIG_BASE_SMALL
 	futex_hashsize = 16;
@@ -3626,12 +3965,7 @@ static int __init futex_init(void)
 	futex_hashsize = 1UL << futex_shift;
 
 	futex_detect_cmpxchg();
-
-	for (i = 0; i < futex_hashsize; i++) {
-		atomic_set(&futex_queues[i].waiters, 0);
-		plist_head_init(&futex_queues[i].chain);
-		spin_lock_init(&futex_queues[i].lock);
-	}
+	futex_hash_init_buckets(futex_queues, futex_hashsize);
 
 	return 0;
 }
@@ -1154,6 +1154,62 @@ void rt_mutex_init_waiter(struct rt_mutex_waiter *waiter)
 	waiter->task = NULL;
 }
 
+#ifdef CONFIG_RT_MUTEX_SPIN_ON_OWNER
+/*
+ * Spin while @owner holds @lock and is running on another CPU, in the hope
+ * that it releases the lock soon and we get to take it without going
+ * through schedule(). Only the top waiter spins, which keeps at most one
+ * spinner per lock without needing an MCS queue like mutex_spin_on_owner().
+ *
+ * Return: true if the owner changed and the lock should be tried again,
+ * false if the caller should go to sleep.
+ */
+static bool rt_mutex_spin_on_owner(struct rt_mutex *lock,
+				   struct rt_mutex_waiter *waiter,
+				   struct task_struct *owner)
+{
+	bool ret = true;
+
+	rcu_read_lock();
+	while (rt_mutex_owner(lock) == owner) {
+		/*
+		 * Ensure we emit the owner->on_cpu, dereference _after_
+		 * checking lock->owner still matches owner. If that fails,
+		 * owner might point to freed memory. If it still matches,
+		 * the rcu_read_lock() ensures the memory stays valid.
+		 */
+		barrier();
+
+		/*
+		 * Stop when the owner got preempted or scheduled out, when
+		 * we need to reschedule, when a higher priority waiter was
+		 * enqueued ahead of us, or when we have been woken up by a
+		 * signal or our timeout.
+		 */
+		if (!owner->on_cpu || need_resched() ||
+		    vcpu_is_preempted(task_cpu(owner)) ||
+		    READ_ONCE(lock->waiters.rb_leftmost) !=
+						&waiter->tree_entry ||
+		    READ_ONCE(current->state) == TASK_RUNNING) {
+			ret = false;
+			break;
+		}
+
+		cpu_relax();
+	}
+	rcu_read_unlock();
+
+	return ret;
+}
+#else
+static inline bool rt_mutex_spin_on_owner(struct rt_mutex *lock,
+					  struct rt_mutex_waiter *waiter,
+					  struct task_struct *owner)
+{
+	return false;
+}
+#endif
+
 /**
  * __rt_mutex_slowlock() - Perform the wait-wake-try-to-take loop
  * @lock:		 the rt_mutex to take
@@ -1169,6 +1225,7 @@ __rt_mutex_slowlock(struct rt_mutex *lock, int state,
 		    struct hrtimer_sleeper *timeout,
 		    struct rt_mutex_waiter *waiter)
 {
+	struct task_struct *owner;
 	int ret = 0;
 
 	for (;;) {
@@ -1190,11 +1247,16 @@ __rt_mutex_slowlock(struct rt_mutex *lock, int state,
 				break;
 		}
 
+		if (waiter == rt_mutex_top_waiter(lock))
+			owner = rt_mutex_owner(lock);
+		else
+			owner = NULL;
 		raw_spin_unlock_irq(&lock->wait_lock);
 
 		debug_rt_mutex_print_deadlock(waiter);
 
-		schedule();
+		if (!owner || !rt_mutex_spin_on_owner(lock, waiter, owner))
+			schedule();
 
 		raw_spin_lock_irq(&lock->wait_lock);
 		set_current_state(state);
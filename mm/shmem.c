@@ -2215,6 +2215,7 @@ static struct inode *shmem_get_inode(struct super_block *sb, const struct inode
 			inc_nlink(inode);
 			/* Some things misbehave if size == 0 on a directory */
 			inode->i_size = 2 * BOGO_DIRENT_SIZE;
+			inode->i_opflags |= IOP_PARALLEL_DIROPS;
 			inode->i_op = &shmem_dir_inode_operations;
 			inode->i_fop = &simple_dir_operations;
 			break;
@@ -2787,6 +2788,18 @@ static int shmem_statfs(struct dentry *dentry, struct kstatfs *buf)
 	return 0;
 }
 
+/*
+ * Directories are IOP_PARALLEL_DIROPS, so creates and unlinks of different
+ * names can update the parent concurrently with only i_rwsem held shared.
+ */
+static void shmem_dir_update(struct inode *dir, int size)
+{
+	spin_lock(&dir->i_lock);
+	dir->i_size += size;
+	dir->i_ctime = dir->i_mtime = current_time(dir);
+	spin_unlock(&dir->i_lock);
+}
+
 /*
  * File creation. Allocate an inode, and we're done..
  */
@@ -2808,8 +2821,7 @@ shmem_mknod(struct inode *dir, struct dentry *dentry, umode_t mode, dev_t dev)
 			goto out_iput;
 
 		error = 0;
-		dir->i_size += BOGO_DIRENT_SIZE;
-		dir->i_ctime = dir->i_mtime = current_time(dir);
+		shmem_dir_update(dir, BOGO_DIRENT_SIZE);
 		d_instantiate(dentry, inode);
 		dget(dentry); /* Extra count - pin the dentry in core */
 	}
@@ -2893,8 +2905,8 @@ static int shmem_unlink(struct inode *dir, struct dentry *dentry)
 	if (inode->i_nlink > 1 && !S_ISDIR(inode->i_mode))
 		shmem_free_inode(inode->i_sb);
 
-	dir->i_size -= BOGO_DIRENT_SIZE;
-	inode->i_ctime = dir->i_ctime = dir->i_mtime = current_time(inode);
+	shmem_dir_update(dir, -BOGO_DIRENT_SIZE);
+	inode->i_ctime = current_time(inode);
 	drop_nlink(inode);
 	dput(dentry);	/* Undo the count from "create" - this does all the work */
 	return 0;
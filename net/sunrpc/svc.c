@@ -36,8 +36,6 @@ static void svc_unregister(const struct svc_serv *serv, struct net *net);
 
 #define svc_serv_is_pooled(serv)    ((serv)->sv_ops->svo_function)
 
-#define SVC_POOL_DEFAULT	SVC_POOL_GLOBAL
-
 /*
  * Structure for mapping cpus to pools and vice versa.
  * Setup once during sunrpc initialisation.
@@ -86,6 +84,10 @@ param_get_pool_mode(char *buf, const struct kernel_param *kp)
 
 	switch (*ip)
 	{
+	case SVC_POOL_DEFAULT:
+		if (nr_online_nodes > 1)
+			return strlcpy(buf, "pernode", 20);
+		return strlcpy(buf, "global", 20);
 	case SVC_POOL_AUTO:
 		return strlcpy(buf, "auto", 20);
 	case SVC_POOL_GLOBAL:
@@ -232,6 +234,13 @@ svc_pool_map_get(void)
 		return m->npools;
 	}
 
+	/* Unless told otherwise, split pools on NUMA node boundaries, so
+	 * that requests are handled by threads close to the CPU that
+	 * received them.
+	 */
+	if (m->mode == SVC_POOL_DEFAULT)
+		m->mode = nr_online_nodes > 1 ? SVC_POOL_PERNODE :
+						SVC_POOL_GLOBAL;
 	if (m->mode == SVC_POOL_AUTO)
 		m->mode = svc_pool_map_choose_mode();
 
@@ -326,6 +335,38 @@ svc_pool_map_set_cpumask(struct task_struct *task, unsigned int pidx)
 	}
 }
 
+static inline bool svc_pool_has_threads(struct svc_serv *serv,
+					unsigned int pidx)
+{
+	return READ_ONCE(serv->sv_pools[pidx].sp_nrthreads) != 0;
+}
+
+/*
+ * There may be fewer threads than pools. Don't queue work in a pool that
+ * has no thread to pick it up, spread it over the pools that have threads
+ * instead, so that one of them doesn't get the work of all empty pools.
+ */
+static unsigned int
+svc_pool_with_threads(struct svc_serv *serv, unsigned int pidx)
+{
+	unsigned int i, nr = 0;
+
+	if (svc_pool_has_threads(serv, pidx))
+		return pidx;
+
+	for (i = 0; i < serv->sv_nrpools; i++)
+		if (svc_pool_has_threads(serv, i))
+			nr++;
+	if (!nr)
+		return pidx;
+
+	nr = pidx % nr;
+	for (i = 0; i < serv->sv_nrpools; i++)
+		if (svc_pool_has_threads(serv, i) && !nr--)
+			return i;
+	return pidx;
+}
+
 /*
  * Use the mapping mode to choose a pool for a given CPU.
  * Used when enqueueing an incoming RPC.  Always returns
@@ -351,6 +392,7 @@ svc_pool_for_cpu(struct svc_serv *serv, int cpu)
 			pidx = m->to_pool[cpu_to_node(cpu)];
 			break;
 		}
+		pidx = svc_pool_with_threads(serv, pidx % serv->sv_nrpools);
 	}
 	return &serv->sv_pools[pidx % serv->sv_nrpools];
 }
@@ -477,6 +519,7 @@ __svc_create(struct svc_program *prog, unsigned int bufsize, int npools,
 
 		pool->sp_id = i;
 		INIT_LIST_HEAD(&pool->sp_sockets);
+		init_llist_head(&pool->sp_new_sockets);
 		INIT_LIST_HEAD(&pool->sp_all_threads);
 		spin_lock_init(&pool->sp_lock);
 	}
@@ -45,6 +45,8 @@ static LIST_HEAD(svc_xprt_class_list);
 /* SMP locking strategy:
  *
  *	svc_pool->sp_lock protects most of the fields of that pool.
+ *	Transports are queued on svc_pool->sp_new_sockets without it,
+ *	threads move them over to sp_sockets under sp_lock.
  *	svc_serv->sv_lock protects sv_tempsocks, sv_permsocks, sv_tmpcnt.
  *	when both need to be taken (rare), svc_serv->sv_lock is first.
  *	The "service mutex" protects svc_serv->sv_nrthread.
@@ -376,6 +378,49 @@ static bool svc_xprt_has_something_to_do(struct svc_xprt *xprt)
 	return false;
 }
 
+static bool svc_pool_has_sockets(struct svc_pool *pool)
+{
+	return !list_empty(&pool->sp_sockets) ||
+	       !llist_empty(&pool->sp_new_sockets);
+}
+
+/*
+ * Move the transports queued since the last call over to sp_sockets, in
+ * the order they were queued. Must be called with sp_lock held.
+ */
+static void svc_pool_splice_new_sockets(struct svc_pool *pool)
+{
+	struct llist_node *first;
+	struct svc_xprt *xprt, *tmp;
+
+	first = llist_reverse_order(llist_del_all(&pool->sp_new_sockets));
+	llist_for_each_entry_safe(xprt, tmp, first, xpt_ready_node)
+		list_add_tail(&xprt->xpt_ready, &pool->sp_sockets);
+}
+
+/*
+ * Wake up an idle thread of @pool, if there is one. Returns NULL if all
+ * of them are busy; they look for more work before going back to sleep.
+ */
+static struct svc_rqst *svc_pool_wake_idle_thread(struct svc_pool *pool)
+{
+	struct svc_rqst	*rqstp;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(rqstp, &pool->sp_all_threads, rq_all) {
+		if (test_and_set_bit(RQ_BUSY, &rqstp->rq_flags))
+			continue;
+		atomic_long_inc(&pool->sp_stats.threads_woken);
+		rqstp->rq_qtime = ktime_get();
+		wake_up_process(rqstp->rq_task);
+		rcu_read_unlock();
+		return rqstp;
+	}
+	rcu_read_unlock();
+	set_bit(SP_CONGESTED, &pool->sp_flags);
+	return NULL;
+}
+
 void svc_xprt_do_enqueue(struct svc_xprt *xprt)
 {
 	struct svc_pool *pool;
@@ -397,26 +442,19 @@ void svc_xprt_do_enqueue(struct svc_xprt *xprt)
 	pool = svc_pool_for_cpu(xprt->xpt_server, cpu);
 
 	atomic_long_inc(&pool->sp_stats.packets);
+	atomic_long_inc(&pool->sp_stats.sockets_queued);
+	atomic_long_inc(&pool->sp_stats.sockets_waiting);
+	xprt->xpt_qtime = ktime_get();
 
-	spin_lock_bh(&pool->sp_lock);
-	list_add_tail(&xprt->xpt_ready, &pool->sp_sockets);
-	pool->sp_stats.sockets_queued++;
-	spin_unlock_bh(&pool->sp_lock);
+	/*
+	 * Only the transport that finds the queue empty wakes a thread.
+	 * Transports queued behind it are handed on by the threads that
+	 * dequeue them, see svc_xprt_dequeue(), so a burst of incoming
+	 * requests does not cost one wakeup scan per request here.
+	 */
+	if (llist_add(&xprt->xpt_ready_node, &pool->sp_new_sockets))
+		rqstp = svc_pool_wake_idle_thread(pool);
 
-	/* find a thread for this xprt */
-	rcu_read_lock();
-	list_for_each_entry_rcu(rqstp, &pool->sp_all_threads, rq_all) {
-		if (test_and_set_bit(RQ_BUSY, &rqstp->rq_flags))
-			continue;
-		atomic_long_inc(&pool->sp_stats.threads_woken);
-		rqstp->rq_qtime = ktime_get();
-		wake_up_process(rqstp->rq_task);
-		goto out_unlock;
-	}
-	set_bit(SP_CONGESTED, &pool->sp_flags);
-	rqstp = NULL;
-out_unlock:
-	rcu_read_unlock();
 	put_cpu();
 	trace_svc_xprt_do_enqueue(xprt, rqstp);
 }
@@ -441,18 +479,32 @@ EXPORT_SYMBOL_GPL(svc_xprt_enqueue);
 static struct svc_xprt *svc_xprt_dequeue(struct svc_pool *pool)
 {
 	struct svc_xprt	*xprt = NULL;
+	bool more;
 
-	if (list_empty(&pool->sp_sockets))
+	if (!svc_pool_has_sockets(pool))
 		goto out;
 
 	spin_lock_bh(&pool->sp_lock);
+	if (list_empty(&pool->sp_sockets))
+		svc_pool_splice_new_sockets(pool);
 	if (likely(!list_empty(&pool->sp_sockets))) {
 		xprt = list_first_entry(&pool->sp_sockets,
 					struct svc_xprt, xpt_ready);
 		list_del_init(&xprt->xpt_ready);
 		svc_xprt_get(xprt);
 	}
+	more = svc_pool_has_sockets(pool);
 	spin_unlock_bh(&pool->sp_lock);
+
+	if (xprt) {
+		atomic_long_dec(&pool->sp_stats.sockets_waiting);
+		atomic64_add(ktime_to_ns(ktime_sub(ktime_get(),
+						   xprt->xpt_qtime)),
+			     &pool->sp_stats.queue_time);
+	}
+	/* pass the rest of the batch on to the next idle thread */
+	if (more)
+		svc_pool_wake_idle_thread(pool);
 out:
 	return xprt;
 }
@@ -663,7 +715,7 @@ rqst_should_sleep(struct svc_rqst *rqstp)
 		return false;
 
 	/* was a socket queued? */
-	if (!list_empty(&pool->sp_sockets))
+	if (svc_pool_has_sockets(pool))
 		return false;
 
 	/* are we shutting down? */
@@ -1068,11 +1120,13 @@ static struct svc_xprt *svc_dequeue_net(struct svc_serv *serv, struct net *net)
 		pool = &serv->sv_pools[i];
 
 		spin_lock_bh(&pool->sp_lock);
+		svc_pool_splice_new_sockets(pool);
 		list_for_each_entry_safe(xprt, tmp, &pool->sp_sockets, xpt_ready) {
 			if (xprt->xpt_net != net)
 				continue;
 			list_del_init(&xprt->xpt_ready);
 			spin_unlock_bh(&pool->sp_lock);
+			atomic_long_dec(&pool->sp_stats.sockets_waiting);
 			return xprt;
 		}
 		spin_unlock_bh(&pool->sp_lock);
@@ -1383,16 +1437,19 @@ static int svc_pool_stats_show(struct seq_file *m, void *p)
 	struct svc_pool *pool = p;
 
 	if (p == SEQ_START_TOKEN) {
-		seq_puts(m, "# pool packets-arrived sockets-enqueued threads-woken threads-timedout\n");
+		seq_puts(m, "# pool packets-arrived sockets-enqueued threads-woken threads-timedout sockets-waiting queue-time-us\n");
 		return 0;
 	}
 
-	seq_printf(m, "%u %lu %lu %lu %lu\n",
+	seq_printf(m, "%u %lu %lu %lu %lu %lu %llu\n",
 		pool->sp_id,
 		(unsigned long)atomic_long_read(&pool->sp_stats.packets),
-		pool->sp_stats.sockets_queued,
+		(unsigned long)atomic_long_read(&pool->sp_stats.sockets_queued),
 		(unsigned long)atomic_long_read(&pool->sp_stats.threads_woken),
-		(unsigned long)atomic_long_read(&pool->sp_stats.threads_timedout));
+		(unsigned long)atomic_long_read(&pool->sp_stats.threads_timedout),
+		(unsigned long)atomic_long_read(&pool->sp_stats.sockets_waiting),
+		div_u64(atomic64_read(&pool->sp_stats.queue_time),
+			NSEC_PER_USEC));
 
 	return 0;
 }
@@ -43,7 +43,9 @@ static void xprt_switch_add_xprt_locked(struct rpc_xprt_switch *xps,
  * @xps: pointer to struct rpc_xprt_switch
  * @xprt: pointer to struct rpc_xprt
  *
- * Adds xprt to the end of the list of struct rpc_xprt in xps.
+ * Adds xprt to the end of the list of struct rpc_xprt in xps. More than
+ * one transport may connect to the same address; callers that want to
+ * add distinct addresses only must check rpc_xprt_switch_has_addr().
  */
 void rpc_xprt_switch_add_xprt(struct rpc_xprt_switch *xps,
 		struct rpc_xprt *xprt)
@@ -51,8 +53,7 @@ void rpc_xprt_switch_add_xprt(struct rpc_xprt_switch *xps,
 	if (xprt == NULL)
 		return;
 	spin_lock(&xps->xps_lock);
-	if ((xps->xps_net == xprt->xprt_net || xps->xps_net == NULL) &&
-	    !rpc_xprt_switch_has_addr(xps, (struct sockaddr *)&xprt->addr))
+	if (xps->xps_net == xprt->xprt_net || xps->xps_net == NULL)
 		xprt_switch_add_xprt_locked(xps, xprt);
 	spin_unlock(&xps->xps_lock);
 }
@@ -103,6 +104,7 @@ struct rpc_xprt_switch *xprt_switch_alloc(struct rpc_xprt *xprt,
 		spin_lock_init(&xps->xps_lock);
 		kref_init(&xps->xps_kref);
 		xps->xps_nxprts = 0;
+		atomic_long_set(&xps->xps_queuelen, 0);
 		INIT_LIST_HEAD(&xps->xps_xprt_list);
 		xps->xps_iter_ops = &rpc_xprt_iter_singular;
 		xprt_switch_add_xprt_locked(xps, xprt);
@@ -317,8 +319,30 @@ struct rpc_xprt *xprt_switch_find_next_entry_roundrobin(struct list_head *head,
 static
 struct rpc_xprt *xprt_iter_next_entry_roundrobin(struct rpc_xprt_iter *xpi)
 {
-	return xprt_iter_next_entry_multiple(xpi,
-			xprt_switch_find_next_entry_roundrobin);
+	struct rpc_xprt_switch *xps = rcu_dereference(xpi->xpi_xpswitch);
+	unsigned long xprt_queuelen, xps_queuelen;
+	struct rpc_xprt *xprt;
+	unsigned int tries;
+
+	if (xps == NULL)
+		return NULL;
+	/*
+	 * Skip transports that have more than their share of the tasks
+	 * queued, so that one stalled connection doesn't hold up every
+	 * n-th request. Both counts are sampled without locking, hence
+	 * the bounded number of tries.
+	 */
+	tries = READ_ONCE(xps->xps_nxprts);
+	do {
+		xprt = xprt_iter_next_entry_multiple(xpi,
+				xprt_switch_find_next_entry_roundrobin);
+		if (xprt == NULL)
+			break;
+		xprt_queuelen = atomic_long_read(&xprt->queuelen);
+		xps_queuelen = atomic_long_read(&xps->xps_queuelen);
+	} while (--tries > 0 &&
+		 xprt_queuelen * xps->xps_nxprts > xps_queuelen);
+	return xprt;
 }
 
 static
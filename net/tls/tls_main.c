@@ -392,6 +392,36 @@ out:
 	return rc;
 }
 
+static int do_tls_getsockopt_rx_stats(struct sock *sk, char __user *optval,
+				      int __user *optlen)
+{
+	struct tls_context *ctx = tls_get_ctx(sk);
+	struct tls_rx_stats stats;
+	int len;
+
+	if (get_user(len, optlen))
+		return -EFAULT;
+
+	if (!optval || len < sizeof(stats))
+		return -EINVAL;
+
+	lock_sock(sk);
+	if (!ctx || ctx->rx_conf != TLS_SW) {
+		release_sock(sk);
+		return -EBUSY;
+	}
+	stats = tls_sw_ctx_rx(ctx)->stats;
+	release_sock(sk);
+
+	len = sizeof(stats);
+	if (put_user(len, optlen))
+		return -EFAULT;
+	if (copy_to_user(optval, &stats, len))
+		return -EFAULT;
+
+	return 0;
+}
+
 static int do_tls_getsockopt(struct sock *sk, int optname,
 			     char __user *optval, int __user *optlen)
 {
@@ -401,6 +431,9 @@ static int do_tls_getsockopt(struct sock *sk, int optname,
 	case TLS_TX:
 		rc = do_tls_getsockopt_tx(sk, optval, optlen);
 		break;
+	case TLS_RX_STATS:
+		rc = do_tls_getsockopt_rx_stats(sk, optval, optlen);
+		break;
 	default:
 		rc = -ENOPROTOOPT;
 		break;
@@ -449,8 +482,9 @@ static int do_tls_setsockopt_conf(struct sock *sk, char __user *optval,
 		goto err_crypto_info;
 	}
 
-	/* check version */
-	if (crypto_info->version != TLS_1_2_VERSION) {
+	/* check version, TLS 1.3 is only handled on the receive side */
+	if (crypto_info->version != TLS_1_2_VERSION &&
+	    (tx || crypto_info->version != TLS_1_3_VERSION)) {
 		rc = -ENOTSUPP;
 		goto err_crypto_info;
 	}
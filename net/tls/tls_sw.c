@@ -65,7 +65,7 @@ static int tls_do_decryption(struct sock *sk,
 		return -ENOMEM;
 
 	aead_request_set_tfm(aead_req, ctx->aead_recv);
-	aead_request_set_ad(aead_req, TLS_AAD_SPACE_SIZE);
+	aead_request_set_ad(aead_req, tls_ctx->rx.aad_size);
 	aead_request_set_crypt(aead_req, sgin, sgout,
 			       data_len + tls_ctx->rx.tag_size,
 			       (u8 *)iv_recv);
@@ -138,11 +138,112 @@ static void trim_both_sgl(struct sock *sk, int target_size)
 		target_size);
 }
 
+/* Release the pool pages TCP no longer references */
+static void tls_tx_pool_trim(struct tls_sw_context_tx *ctx)
+{
+	int i;
+
+	for (i = 0; i < TLS_TX_POOL_PAGES; i++) {
+		if (ctx->tx_pool[i] && page_ref_count(ctx->tx_pool[i]) == 1) {
+			put_page(ctx->tx_pool[i]);
+			ctx->tx_pool[i] = NULL;
+		}
+	}
+}
+
+/* Find a pool page that TCP no longer references, filling empty slots
+ * on demand.
+ */
+static struct page *tls_tx_pool_get(struct sock *sk,
+				    struct tls_sw_context_tx *ctx,
+				    unsigned int order)
+{
+	struct page *page;
+	int i;
+
+	/* The pool is only a cache, give it back when memory is tight */
+	if (sk_under_memory_pressure(sk)) {
+		tls_tx_pool_trim(ctx);
+		return NULL;
+	}
+
+	for (i = 0; i < TLS_TX_POOL_PAGES; i++) {
+		page = ctx->tx_pool[i];
+		if (!page) {
+			/* Avoid direct reclaim, sk_alloc_sg() is the fallback.
+			 * The socket is only charged for the records in a pool
+			 * page, so charge the whole page to the memcg.
+			 */
+			page = alloc_pages((sk->sk_allocation &
+					    ~__GFP_DIRECT_RECLAIM) |
+					   __GFP_COMP | __GFP_NOWARN |
+					   __GFP_NORETRY | __GFP_ACCOUNT,
+					   order);
+			ctx->tx_pool[i] = page;
+			return page;
+		}
+
+		if (page_ref_count(page) == 1)
+			return page;
+	}
+
+	return NULL;
+}
+
+static void tls_tx_pool_free(struct tls_sw_context_tx *ctx)
+{
+	int i;
+
+	for (i = 0; i < TLS_TX_POOL_PAGES; i++) {
+		if (ctx->tx_pool[i])
+			put_page(ctx->tx_pool[i]);
+		ctx->tx_pool[i] = NULL;
+	}
+}
+
 static int alloc_encrypted_sg(struct sock *sk, int len)
 {
 	struct tls_context *tls_ctx = tls_get_ctx(sk);
 	struct tls_sw_context_tx *ctx = tls_sw_ctx_tx(tls_ctx);
-	int rc = 0;
+	struct scatterlist *sg = ctx->sg_encrypted_data;
+	unsigned int order;
+	struct page *page;
+	int use, rc = 0;
+
+	/* The record grows in place inside its pool page */
+	if (ctx->tx_pool_record && ctx->sg_encrypted_num_elem == 1) {
+		use = len - ctx->sg_encrypted_size;
+		if (use <= 0)
+			return 0;
+
+		if (!sk_wmem_schedule(sk, use))
+			return -ENOMEM;
+
+		sk_mem_charge(sk, use);
+		sg[0].length += use;
+		ctx->sg_encrypted_size += use;
+		return 0;
+	}
+
+	ctx->tx_pool_record = false;
+	if (!ctx->sg_encrypted_num_elem) {
+		order = get_order(TLS_MAX_PAYLOAD_SIZE +
+				  tls_ctx->tx.overhead_size);
+		page = tls_tx_pool_get(sk, ctx, order);
+		if (page) {
+			if (!sk_wmem_schedule(sk, len))
+				return -ENOMEM;
+
+			sk_mem_charge(sk, len);
+			get_page(page);
+			sg_unmark_end(&sg[0]);
+			sg_set_page(&sg[0], page, len, 0);
+			ctx->sg_encrypted_num_elem = 1;
+			ctx->sg_encrypted_size = len;
+			ctx->tx_pool_record = true;
+			return 0;
+		}
+	}
 
 	rc = sk_alloc_sg(sk, len,
 			 ctx->sg_encrypted_data, 0,
@@ -227,14 +328,9 @@ static int tls_push_record(struct sock *sk, int flags,
 {
 	struct tls_context *tls_ctx = tls_get_ctx(sk);
 	struct tls_sw_context_tx *ctx = tls_sw_ctx_tx(tls_ctx);
-	struct aead_request *req;
+	struct aead_request *req = ctx->aead_req;
 	int rc;
 
-	req = kzalloc(sizeof(struct aead_request) +
-		      crypto_aead_reqsize(ctx->aead_send), sk->sk_allocation);
-	if (!req)
-		return -ENOMEM;
-
 	sg_mark_end(ctx->sg_plaintext_data + ctx->sg_plaintext_num_elem - 1);
 	sg_mark_end(ctx->sg_encrypted_data + ctx->sg_encrypted_num_elem - 1);
 
@@ -257,7 +353,7 @@ static int tls_push_record(struct sock *sk, int flags,
 		 * to trigger another write_space in the future.
 		 */
 		set_bit(SOCK_NOSPACE, &sk->sk_socket->flags);
-		goto out_req;
+		return rc;
 	}
 
 	free_sg(sk, ctx->sg_plaintext_data, &ctx->sg_plaintext_num_elem,
@@ -272,8 +368,6 @@ static int tls_push_record(struct sock *sk, int flags,
 		tls_err_abort(sk, EBADMSG);
 
 	tls_advance_record_sn(sk, &tls_ctx->tx);
-out_req:
-	kfree(req);
 	return rc;
 }
 
@@ -681,6 +775,38 @@ static struct sk_buff *tls_wait_data(struct sock *sk, int flags,
 	return skb;
 }
 
+/* TLS 1.3 hides the real record type behind the plaintext, optionally
+ * followed by zero padding (RFC 8446, section 5.4).  Strip both and
+ * report the inner type.
+ */
+static int tls13_parse_inner_type(struct sk_buff *skb, u8 *control)
+{
+	struct strp_msg *rxm = strp_msg(skb);
+	int len = rxm->full_len;
+	char tail[16];
+
+	while (len > 0) {
+		int chunk = min_t(int, len, sizeof(tail));
+		int i, err;
+
+		err = skb_copy_bits(skb, rxm->offset + len - chunk,
+				    tail, chunk);
+		if (err < 0)
+			return err;
+
+		for (i = chunk - 1; i >= 0; i--) {
+			if (tail[i]) {
+				*control = tail[i];
+				rxm->full_len = len - chunk + i;
+				return 0;
+			}
+		}
+		len -= chunk;
+	}
+
+	return -EBADMSG;
+}
+
 static int decrypt_skb(struct sock *sk, struct sk_buff *skb,
 		       struct scatterlist *sgout)
 {
@@ -691,15 +817,28 @@ static int decrypt_skb(struct sock *sk, struct sk_buff *skb,
 	struct scatterlist *sgin = &sgin_arr[0];
 	struct strp_msg *rxm = strp_msg(skb);
 	int ret, nsg = ARRAY_SIZE(sgin_arr);
+	bool tls13 = tls_ctx->rx.version == TLS_1_3_VERSION;
+	bool zc = !!sgout;
 	struct sk_buff *unused;
+	int i;
+
+	if (tls13) {
+		/* nonce = static IV ^ record sequence number */
+		memcpy(iv, tls_ctx->rx.iv,
+		       TLS_CIPHER_AES_GCM_128_SALT_SIZE + tls_ctx->rx.iv_size);
+		for (i = 0; i < tls_ctx->rx.rec_seq_size; i++)
+			iv[TLS_CIPHER_AES_GCM_128_SALT_SIZE + i] ^=
+				tls_ctx->rx.rec_seq[i];
+	} else {
+		ret = skb_copy_bits(skb, rxm->offset + TLS_HEADER_SIZE,
+				    iv + TLS_CIPHER_AES_GCM_128_SALT_SIZE,
+				    tls_ctx->rx.iv_size);
+		if (ret < 0)
+			return ret;
 
-	ret = skb_copy_bits(skb, rxm->offset + TLS_HEADER_SIZE,
-			    iv + TLS_CIPHER_AES_GCM_128_SALT_SIZE,
-			    tls_ctx->rx.iv_size);
-	if (ret < 0)
-		return ret;
+		memcpy(iv, tls_ctx->rx.iv, TLS_CIPHER_AES_GCM_128_SALT_SIZE);
+	}
 
-	memcpy(iv, tls_ctx->rx.iv, TLS_CIPHER_AES_GCM_128_SALT_SIZE);
 	if (!sgout) {
 		nsg = skb_cow_data(skb, 0, &unused) + 1;
 		sgin = kmalloc_array(nsg, sizeof(*sgin), sk->sk_allocation);
@@ -707,7 +846,7 @@ static int decrypt_skb(struct sock *sk, struct sk_buff *skb,
 	}
 
 	sg_init_table(sgin, nsg);
-	sg_set_buf(&sgin[0], ctx->rx_aad_ciphertext, TLS_AAD_SPACE_SIZE);
+	sg_set_buf(&sgin[0], ctx->rx_aad_ciphertext, tls_ctx->rx.aad_size);
 
 	nsg = skb_to_sgvec(skb, &sgin[1],
 			   rxm->offset + tls_ctx->rx.prepend_size,
@@ -717,15 +856,35 @@ static int decrypt_skb(struct sock *sk, struct sk_buff *skb,
 		goto out;
 	}
 
-	tls_make_aad(ctx->rx_aad_ciphertext,
-		     rxm->full_len - tls_ctx->rx.overhead_size,
-		     tls_ctx->rx.rec_seq,
-		     tls_ctx->rx.rec_seq_size,
-		     ctx->control);
+	if (tls13)
+		tls13_make_aad(ctx->rx_aad_ciphertext,
+			       rxm->full_len - tls_ctx->rx.prepend_size);
+	else
+		tls_make_aad(ctx->rx_aad_ciphertext,
+			     rxm->full_len - tls_ctx->rx.overhead_size,
+			     tls_ctx->rx.rec_seq,
+			     tls_ctx->rx.rec_seq_size,
+			     ctx->control);
 
 	ret = tls_do_decryption(sk, sgin, sgout, iv,
 				rxm->full_len - tls_ctx->rx.overhead_size,
 				skb, sk->sk_allocation);
+	if (ret < 0)
+		goto out;
+
+	if (tls13) {
+		ret = tls13_parse_inner_type(skb, &ctx->control);
+		if (ret < 0)
+			goto out;
+	}
+
+	if (zc) {
+		ctx->stats.zerocopy_records++;
+		ctx->stats.zerocopy_bytes += rxm->full_len;
+	} else {
+		ctx->stats.copy_records++;
+		ctx->stats.copy_bytes += rxm->full_len;
+	}
 
 out:
 	if (sgin != &sgin_arr[0])
@@ -791,6 +950,32 @@ int tls_sw_recvmsg(struct sock *sk,
 			goto recv_end;
 
 		rxm = strp_msg(skb);
+
+		/* Decrypt straight into the user buffer when the whole
+		 * record fits.  TLS 1.3 records only learn their type once
+		 * decrypted, so those always take the copy path.
+		 */
+		if (!ctx->decrypted) {
+			int page_count;
+			int to_copy;
+
+			page_count = iov_iter_npages(&msg->msg_iter,
+						     MAX_SKB_FRAGS);
+			to_copy = rxm->full_len - tls_ctx->rx.overhead_size;
+			if (to_copy <= len && page_count < MAX_SKB_FRAGS &&
+			    tls_ctx->rx.version != TLS_1_3_VERSION &&
+			    likely(!(flags & MSG_PEEK))) {
+				zc = true;
+			} else {
+				err = decrypt_skb(sk, skb, NULL);
+				if (err < 0) {
+					tls_err_abort(sk, EBADMSG);
+					goto recv_end;
+				}
+				ctx->decrypted = true;
+			}
+		}
+
 		if (!cmsg) {
 			int cerr;
 
@@ -808,44 +993,32 @@ int tls_sw_recvmsg(struct sock *sk,
 			goto recv_end;
 		}
 
-		if (!ctx->decrypted) {
-			int page_count;
+		if (zc) {
+			struct scatterlist sgin[MAX_SKB_FRAGS + 1];
 			int to_copy;
+			int pages = 0;
 
-			page_count = iov_iter_npages(&msg->msg_iter,
-						     MAX_SKB_FRAGS);
 			to_copy = rxm->full_len - tls_ctx->rx.overhead_size;
-			if (to_copy <= len && page_count < MAX_SKB_FRAGS &&
-			    likely(!(flags & MSG_PEEK)))  {
-				struct scatterlist sgin[MAX_SKB_FRAGS + 1];
-				int pages = 0;
-
-				zc = true;
-				sg_init_table(sgin, MAX_SKB_FRAGS + 1);
-				sg_set_buf(&sgin[0], ctx->rx_aad_plaintext,
-					   TLS_AAD_SPACE_SIZE);
-
-				err = zerocopy_from_iter(sk, &msg->msg_iter,
-							 to_copy, &pages,
-							 &chunk, &sgin[1],
-							 MAX_SKB_FRAGS,	false, true);
-				if (err < 0)
-					goto fallback_to_reg_recv;
-
-				err = decrypt_skb(sk, skb, sgin);
-				for (; pages > 0; pages--)
-					put_page(sg_page(&sgin[pages]));
-				if (err < 0) {
-					tls_err_abort(sk, EBADMSG);
-					goto recv_end;
-				}
-			} else {
-fallback_to_reg_recv:
+			sg_init_table(sgin, MAX_SKB_FRAGS + 1);
+			sg_set_buf(&sgin[0], ctx->rx_aad_plaintext,
+				   tls_ctx->rx.aad_size);
+
+			err = zerocopy_from_iter(sk, &msg->msg_iter,
+						 to_copy, &pages,
+						 &chunk, &sgin[1],
+						 MAX_SKB_FRAGS,	false, true);
+			if (err < 0) {
+				zc = false;
+				chunk = 0;
 				err = decrypt_skb(sk, skb, NULL);
-				if (err < 0) {
-					tls_err_abort(sk, EBADMSG);
-					goto recv_end;
-				}
+			} else {
+				err = decrypt_skb(sk, skb, sgin);
+			}
+			for (; pages > 0; pages--)
+				put_page(sg_page(&sgin[pages]));
+			if (err < 0) {
+				tls_err_abort(sk, EBADMSG);
+				goto recv_end;
 			}
 			ctx->decrypted = true;
 		}
@@ -913,12 +1086,6 @@ ssize_t tls_sw_splice_read(struct socket *sock,  loff_t *ppos,
 	if (!skb)
 		goto splice_read_end;
 
-	/* splice does not support reading control messages */
-	if (ctx->control != TLS_RECORD_TYPE_DATA) {
-		err = -ENOTSUPP;
-		goto splice_read_end;
-	}
-
 	if (!ctx->decrypted) {
 		err = decrypt_skb(sk, skb, NULL);
 
@@ -928,6 +1095,12 @@ ssize_t tls_sw_splice_read(struct socket *sock,  loff_t *ppos,
 		}
 		ctx->decrypted = true;
 	}
+
+	/* splice does not support reading control messages */
+	if (ctx->control != TLS_RECORD_TYPE_DATA) {
+		err = -ENOTSUPP;
+		goto splice_read_end;
+	}
 	rxm = strp_msg(skb);
 
 	chunk = min_t(unsigned int, rxm->full_len, len);
@@ -968,8 +1141,9 @@ static int tls_read_size(struct strparser *strp, struct sk_buff *skb)
 	struct tls_sw_context_rx *ctx = tls_sw_ctx_rx(tls_ctx);
 	char header[tls_ctx->rx.prepend_size];
 	struct strp_msg *rxm = strp_msg(skb);
-	size_t cipher_overhead;
+	size_t cipher_overhead, max_len, min_len;
 	size_t data_len = 0;
+	u16 version;
 	int ret;
 
 	/* Verify that we have a full TLS header, or wait for more data */
@@ -986,19 +1160,36 @@ static int tls_read_size(struct strparser *strp, struct sk_buff *skb)
 
 	data_len = ((header[4] & 0xFF) | (header[3] << 8));
 
-	cipher_overhead = tls_ctx->rx.tag_size + tls_ctx->rx.iv_size;
+	cipher_overhead = tls_ctx->rx.overhead_size - TLS_HEADER_SIZE;
+
+	if (tls_ctx->rx.version == TLS_1_3_VERSION) {
+		/* Encrypted records masquerade as TLS 1.2 application
+		 * data and carry at least the inner content type.
+		 */
+		max_len = TLS_MAX_PAYLOAD_SIZE + TLS13_MAX_EXPANSION;
+		min_len = cipher_overhead + 1;
+		version = TLS_1_2_VERSION;
+		if (ctx->control != TLS_RECORD_TYPE_DATA) {
+			ret = -EINVAL;
+			goto read_failure;
+		}
+	} else {
+		max_len = TLS_MAX_PAYLOAD_SIZE + cipher_overhead;
+		min_len = cipher_overhead;
+		version = tls_ctx->crypto_recv.info.version;
+	}
 
-	if (data_len > TLS_MAX_PAYLOAD_SIZE + cipher_overhead) {
+	if (data_len > max_len) {
 		ret = -EMSGSIZE;
 		goto read_failure;
 	}
-	if (data_len < cipher_overhead) {
+	if (data_len < min_len) {
 		ret = -EBADMSG;
 		goto read_failure;
 	}
 
-	if (header[1] != TLS_VERSION_MINOR(tls_ctx->crypto_recv.info.version) ||
-	    header[2] != TLS_VERSION_MAJOR(tls_ctx->crypto_recv.info.version)) {
+	if (header[1] != TLS_VERSION_MINOR(version) ||
+	    header[2] != TLS_VERSION_MAJOR(version)) {
 		ret = -EINVAL;
 		goto read_failure;
 	}
@@ -1042,7 +1233,9 @@ void tls_sw_free_resources_tx(struct sock *sk)
 
 	if (ctx->aead_send)
 		crypto_free_aead(ctx->aead_send);
+	kfree(ctx->aead_req);
 	tls_free_both_sg(sk);
+	tls_tx_pool_free(ctx);
 
 	kfree(ctx);
 }
@@ -1118,7 +1311,11 @@ int tls_set_sw_offload(struct sock *sk, struct tls_context *ctx, int tx)
 
 	switch (crypto_info->cipher_type) {
 	case TLS_CIPHER_AES_GCM_128: {
-		nonce_size = TLS_CIPHER_AES_GCM_128_IV_SIZE;
+		/* TLS 1.3 has no explicit nonce on the wire */
+		if (crypto_info->version == TLS_1_3_VERSION)
+			nonce_size = 0;
+		else
+			nonce_size = TLS_CIPHER_AES_GCM_128_IV_SIZE;
 		tag_size = TLS_CIPHER_AES_GCM_128_TAG_SIZE;
 		iv_size = TLS_CIPHER_AES_GCM_128_IV_SIZE;
 		iv = ((struct tls12_crypto_info_aes_gcm_128 *)crypto_info)->iv;
@@ -1140,9 +1337,14 @@ int tls_set_sw_offload(struct sock *sk, struct tls_context *ctx, int tx)
 		goto free_priv;
 	}
 
+	cctx->version = crypto_info->version;
 	cctx->prepend_size = TLS_HEADER_SIZE + nonce_size;
 	cctx->tag_size = tag_size;
 	cctx->overhead_size = cctx->prepend_size + cctx->tag_size;
+	if (cctx->version == TLS_1_3_VERSION)
+		cctx->aad_size = TLS_HEADER_SIZE;
+	else
+		cctx->aad_size = TLS_AAD_SPACE_SIZE;
 	cctx->iv_size = iv_size;
 	cctx->iv = kmalloc(iv_size + TLS_CIPHER_AES_GCM_128_SALT_SIZE,
 			   GFP_KERNEL);
@@ -1200,6 +1402,19 @@ int tls_set_sw_offload(struct sock *sk, struct tls_context *ctx, int tx)
 	if (rc)
 		goto free_aead;
 
+	if (sw_ctx_tx) {
+		/* One request serves every record, they are encrypted
+		 * synchronously under the socket lock.
+		 */
+		sw_ctx_tx->aead_req = kzalloc(sizeof(struct aead_request) +
+					      crypto_aead_reqsize(*aead),
+					      GFP_KERNEL);
+		if (!sw_ctx_tx->aead_req) {
+			rc = -ENOMEM;
+			goto free_aead;
+		}
+	}
+
 	if (sw_ctx_rx) {
 		/* Set up strparser */
 		memset(&cb, 0, sizeof(cb));
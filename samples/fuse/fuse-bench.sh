@@ -0,0 +1,79 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Sequential read and write throughput through fuse-passthrough, once for
+# every max_pages given on the command line (default: 0, the kernel's
+# default of 32 pages, and 256).
+#
+#   # ./fuse-bench.sh [-d daemon] [-s size_mb] [-r runs] [max_pages...]
+#
+# The backing files live in a scratch directory below $TMPDIR and stay in
+# the page cache, so what is measured is the FUSE path itself.  The daemon
+# doesn't set FOPEN_KEEP_CACHE, so every read starts with a cold FUSE page
+# cache.  The best of all runs is reported.
+
+daemon=$(dirname "$0")/fuse-passthrough
+size_mb=1024
+runs=5
+
+while getopts "d:s:r:" opt; do
+	case $opt in
+	d) daemon=$OPTARG ;;
+	s) size_mb=$OPTARG ;;
+	r) runs=$OPTARG ;;
+	*) echo "usage: $0 [-d daemon] [-s size_mb] [-r runs] [max_pages...]" >&2
+	   exit 1 ;;
+	esac
+done
+shift $((OPTIND - 1))
+[ $# -gt 0 ] || set -- 0 256
+
+if [ "$(id -u)" != "0" ]; then
+	echo "$0: must be run as root" >&2
+	exit 1
+fi
+
+dir=$(mktemp -d)
+trap 'umount "$dir/mnt" 2>/dev/null; rm -rf "$dir"' EXIT
+mkdir "$dir/back" "$dir/mnt"
+dd if=/dev/urandom of="$dir/back/file" bs=1M count="$size_mb" status=none
+
+# Run "$@" and print its throughput in MB/s
+mbps()
+{
+	local start end
+
+	start=$(date +%s%N)
+	"$@" status=none || exit 1
+	end=$(date +%s%N)
+	echo $((size_mb * 1000000000 / (end - start)))
+}
+
+best()
+{
+	local b=0 i r
+
+	for ((i = 0; i < runs; i++)); do
+		r=$(mbps "$@")
+		[ "$r" -gt "$b" ] && b=$r
+	done
+	echo "$b"
+}
+
+printf "%10s %12s %12s\n" max_pages "read MB/s" "write MB/s"
+for pages in "$@"; do
+	"$daemon" -m "$pages" "$dir/back" "$dir/mnt" &
+	while ! mountpoint -q "$dir/mnt"; do
+		kill -0 $! 2>/dev/null || exit 1
+		sleep 0.1
+	done
+
+	read=$(best dd if="$dir/mnt/file" of=/dev/null bs=4M)
+	write=$(best dd if="$dir/back/file" of="$dir/mnt/out" bs=4M \
+		conv=fsync)
+	printf "%10s %12s %12s\n" "$pages" "$read" "$write"
+
+	umount "$dir/mnt"
+	wait
+	rm -f "$dir/back/out"
+done
@@ -0,0 +1,734 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * fuse-passthrough: a minimal FUSE daemon mirroring a directory
+ *
+ * It talks to /dev/fuse directly, without libfuse, and serves every request
+ * from the matching file below the backing directory.  There is no caching
+ * or cleverness in the daemon, so it is a good baseline for measuring FUSE
+ * itself.  fuse-bench.sh uses it to compare sequential I/O with different
+ * max_pages:
+ *
+ *   # fuse-passthrough -m 256 /srv/data /mnt/fuse
+ *
+ * Options:
+ *   -m pages	max_pages to negotiate (default 256), 0 for the kernel default
+ *   -t threads	number of worker threads, each on a cloned device fd
+ *   -w		enable the writeback cache
+ *   -p		pass read, write and mmap through to the backing files
+ *
+ * The daemon mounts the filesystem itself, so it must run as root.  It
+ * stays in the foreground and exits once the filesystem is unmounted.
+ */
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/uio.h>
+#include <linux/fuse.h>
+
+#define NODE_HASH_SIZE	4096
+/* requests the kernel may keep in flight for readahead */
+#define READAHEAD_REQS	4
+
+struct node {
+	int fd;			/* O_PATH descriptor of the backing object */
+	dev_t dev;
+	ino_t ino;
+	uint64_t nlookup;
+	struct node *next;
+};
+
+struct dir {
+	DIR *dp;
+	long offset;
+	struct dirent *entry;
+};
+
+struct worker {
+	pthread_t thread;
+	int fd;
+	char *in;
+	char *out;
+};
+
+static const char *backing_path;
+static unsigned int max_pages = 256, nthreads = 1;
+static bool writeback, passthrough;
+static size_t page_size, buf_size;
+
+static struct node root;
+static struct node *node_hash[NODE_HASH_SIZE];
+static pthread_mutex_t node_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct node *get_node(uint64_t nodeid)
+{
+	if (nodeid == FUSE_ROOT_ID)
+		return &root;
+	return (struct node *)(uintptr_t)nodeid;
+}
+
+static uint64_t node_id(struct node *node)
+{
+	if (node == &root)
+		return FUSE_ROOT_ID;
+	return (uintptr_t)node;
+}
+
+static unsigned int node_hashfn(dev_t dev, ino_t ino)
+{
+	return (ino ^ dev) % NODE_HASH_SIZE;
+}
+
+/* Find or add the node for a looked up object, takes over fd */
+static struct node *node_lookup(int fd, const struct stat *st)
+{
+	unsigned int h = node_hashfn(st->st_dev, st->st_ino);
+	struct node *node;
+
+	pthread_mutex_lock(&node_lock);
+	if (st->st_dev == root.dev && st->st_ino == root.ino) {
+		node = &root;
+		goto found;
+	}
+	for (node = node_hash[h]; node; node = node->next)
+		if (node->dev == st->st_dev && node->ino == st->st_ino)
+			goto found;
+
+	node = calloc(1, sizeof(*node));
+	if (!node) {
+		pthread_mutex_unlock(&node_lock);
+		close(fd);
+		return NULL;
+	}
+	node->fd = fd;
+	node->dev = st->st_dev;
+	node->ino = st->st_ino;
+	node->next = node_hash[h];
+	node_hash[h] = node;
+	fd = -1;
+found:
+	node->nlookup++;
+	pthread_mutex_unlock(&node_lock);
+	if (fd >= 0)
+		close(fd);
+	return node;
+}
+
+static void node_forget(struct node *node, uint64_t nlookup)
+{
+	struct node **pp;
+
+	pthread_mutex_lock(&node_lock);
+	node->nlookup -= nlookup;
+	if (node->nlookup || node == &root) {
+		pthread_mutex_unlock(&node_lock);
+		return;
+	}
+	pp = &node_hash[node_hashfn(node->dev, node->ino)];
+	while (*pp != node)
+		pp = &(*pp)->next;
+	*pp = node->next;
+	pthread_mutex_unlock(&node_lock);
+
+	close(node->fd);
+	free(node);
+}
+
+static void proc_path(char *buf, int fd)
+{
+	sprintf(buf, "/proc/self/fd/%d", fd);
+}
+
+static int reply(struct worker *w, uint64_t unique, int error,
+		 const void *arg, size_t size)
+{
+	struct fuse_out_header out = {
+		.len	= sizeof(out) + (error ? 0 : size),
+		.error	= -error,
+		.unique	= unique,
+	};
+	struct iovec iov[2] = {
+		{ .iov_base = &out,		.iov_len = sizeof(out) },
+		{ .iov_base = (void *)arg,	.iov_len = size },
+	};
+
+	/* ENOENT means the request was interrupted meanwhile */
+	if (writev(w->fd, iov, error || !size ? 1 : 2) < 0 && errno != ENOENT)
+		warn("reply to request %llu", (unsigned long long)unique);
+	return 0;
+}
+
+static void fill_attr(struct fuse_attr *attr, const struct stat *st)
+{
+	attr->ino	= st->st_ino;
+	attr->size	= st->st_size;
+	attr->blocks	= st->st_blocks;
+	attr->atime	= st->st_atim.tv_sec;
+	attr->mtime	= st->st_mtim.tv_sec;
+	attr->ctime	= st->st_ctim.tv_sec;
+	attr->atimensec	= st->st_atim.tv_nsec;
+	attr->mtimensec	= st->st_mtim.tv_nsec;
+	attr->ctimensec	= st->st_ctim.tv_nsec;
+	attr->mode	= st->st_mode;
+	attr->nlink	= st->st_nlink;
+	attr->uid	= st->st_uid;
+	attr->gid	= st->st_gid;
+	attr->rdev	= st->st_rdev;
+	attr->blksize	= st->st_blksize;
+}
+
+/* Look up name in parent and fill in the entry, 0 or an errno */
+static int do_entry(struct node *parent, const char *name,
+		    struct fuse_entry_out *entry)
+{
+	struct node *node;
+	struct stat st;
+	int fd;
+
+	fd = openat(parent->fd, name, O_PATH | O_NOFOLLOW);
+	if (fd < 0)
+		return errno;
+	if (fstatat(fd, "", &st, AT_EMPTY_PATH | AT_SYMLINK_NOFOLLOW) < 0) {
+		close(fd);
+		return errno;
+	}
+	node = node_lookup(fd, &st);
+	if (!node)
+		return ENOMEM;
+
+	memset(entry, 0, sizeof(*entry));
+	entry->nodeid = node_id(node);
+	entry->entry_valid = 1;
+	entry->attr_valid = 1;
+	fill_attr(&entry->attr, &st);
+	return 0;
+}
+
+static int open_flags(int flags)
+{
+	flags &= ~(O_CREAT | O_EXCL | O_NOCTTY);
+	/* the writeback cache may read pages of write-only files ... */
+	if (writeback && (flags & O_ACCMODE) == O_WRONLY)
+		flags = (flags & ~O_ACCMODE) | O_RDWR;
+	/* ... and does appends itself */
+	if (writeback)
+		flags &= ~O_APPEND;
+	return flags;
+}
+
+static void fill_open(struct worker *w, struct fuse_open_out *open, int fd)
+{
+	memset(open, 0, sizeof(*open));
+	open->fh = fd;
+	if (passthrough) {
+		uint32_t fd32 = fd;
+		int id = ioctl(w->fd, FUSE_DEV_IOC_PASSTHROUGH_OPEN, &fd32);
+
+		if (id > 0) {
+			open->open_flags |= FOPEN_PASSTHROUGH;
+			open->passthrough_fh = id;
+		}
+	}
+	if (writeback)
+		open->open_flags |= FOPEN_KEEP_CACHE;
+}
+
+static int do_init(struct worker *w, struct fuse_in_header *in,
+		   struct fuse_init_in *arg)
+{
+	uint64_t wanted = FUSE_ASYNC_READ | FUSE_BIG_WRITES |
+			  FUSE_PARALLEL_DIROPS | FUSE_ASYNC_DIO;
+	uint64_t flags = arg->flags;
+	struct fuse_init_out out = {
+		.major			= FUSE_KERNEL_VERSION,
+		.minor			= FUSE_KERNEL_MINOR_VERSION,
+		.max_readahead		= arg->max_readahead,
+		.max_background		= 64,
+		.congestion_threshold	= 48,
+		.max_write		= 32 * page_size,
+		.time_gran		= 1,
+	};
+
+	/* time_gran is the newest field used here */
+	if (arg->major != FUSE_KERNEL_VERSION || arg->minor < 23)
+		errx(EXIT_FAILURE, "unsupported protocol version %u.%u",
+		     arg->major, arg->minor);
+	if (arg->minor < out.minor)
+		out.minor = arg->minor;
+
+	if (writeback)
+		wanted |= FUSE_WRITEBACK_CACHE;
+	if (max_pages)
+		wanted |= FUSE_MAX_PAGES;
+	if (passthrough)
+		wanted |= FUSE_INIT_EXT | FUSE_PASSTHROUGH;
+	if (flags & FUSE_INIT_EXT)
+		flags |= (uint64_t)arg->flags2 << 32;
+	flags &= wanted;
+	out.flags = flags;
+	out.flags2 = flags >> 32;
+
+	if (passthrough && !(flags & FUSE_PASSTHROUGH))
+		errx(EXIT_FAILURE, "the kernel does not support passthrough");
+	if (flags & FUSE_MAX_PAGES) {
+		out.max_pages = max_pages;
+		out.max_write = max_pages * page_size;
+		/* never more than the kernel offered */
+		if (out.max_readahead > READAHEAD_REQS * max_pages * page_size)
+			out.max_readahead = READAHEAD_REQS * max_pages *
+					    page_size;
+	} else if (max_pages) {
+		warnx("the kernel does not support max_pages");
+	}
+
+	return reply(w, in->unique, 0, &out, sizeof(out));
+}
+
+static int do_readdir(struct worker *w, struct fuse_in_header *in,
+		      struct fuse_read_in *arg)
+{
+	struct dir *d = (struct dir *)(uintptr_t)arg->fh;
+	size_t size = arg->size < buf_size ? arg->size : buf_size;
+	char *p = w->out;
+
+	if (arg->offset != (uint64_t)d->offset) {
+		seekdir(d->dp, arg->offset);
+		d->offset = arg->offset;
+		d->entry = NULL;
+	}
+
+	for (;;) {
+		struct fuse_dirent *dirent = (struct fuse_dirent *)p;
+		size_t namelen, reclen;
+
+		if (!d->entry) {
+			errno = 0;
+			d->entry = readdir(d->dp);
+			if (!d->entry) {
+				if (errno && p == w->out)
+					return reply(w, in->unique, errno,
+						     NULL, 0);
+				break;
+			}
+		}
+
+		namelen = strlen(d->entry->d_name);
+		reclen = FUSE_DIRENT_ALIGN(FUSE_NAME_OFFSET + namelen);
+		/* keep the entry for the next call if it doesn't fit */
+		if (p + reclen > w->out + size)
+			break;
+
+		memset(dirent, 0, reclen);
+		dirent->ino = d->entry->d_ino;
+		dirent->off = telldir(d->dp);
+		dirent->namelen = namelen;
+		dirent->type = d->entry->d_type;
+		memcpy(dirent->name, d->entry->d_name, namelen);
+
+		d->offset = dirent->off;
+		d->entry = NULL;
+		p += reclen;
+	}
+
+	return reply(w, in->unique, 0, w->out, p - w->out);
+}
+
+static int do_setattr(struct worker *w, struct fuse_in_header *in,
+		      struct node *node, struct fuse_setattr_in *arg)
+{
+	struct fuse_attr_out out;
+	char path[64];
+	struct stat st;
+
+	proc_path(path, node->fd);
+
+	if (arg->valid & FATTR_MODE && chmod(path, arg->mode) < 0)
+		return reply(w, in->unique, errno, NULL, 0);
+
+	if (arg->valid & (FATTR_UID | FATTR_GID)) {
+		uid_t uid = arg->valid & FATTR_UID ? arg->uid : (uid_t)-1;
+		gid_t gid = arg->valid & FATTR_GID ? arg->gid : (gid_t)-1;
+
+		if (fchownat(node->fd, "", uid, gid,
+			     AT_EMPTY_PATH | AT_SYMLINK_NOFOLLOW) < 0)
+			return reply(w, in->unique, errno, NULL, 0);
+	}
+
+	if (arg->valid & FATTR_SIZE) {
+		int ret;
+
+		if (arg->valid & FATTR_FH)
+			ret = ftruncate(arg->fh, arg->size);
+		else
+			ret = truncate(path, arg->size);
+		if (ret < 0)
+			return reply(w, in->unique, errno, NULL, 0);
+	}
+
+	if (arg->valid & (FATTR_ATIME | FATTR_MTIME)) {
+		struct timespec ts[2] = {
+			{ .tv_nsec = UTIME_OMIT }, { .tv_nsec = UTIME_OMIT },
+		};
+
+		if (arg->valid & FATTR_ATIME_NOW)
+			ts[0].tv_nsec = UTIME_NOW;
+		else if (arg->valid & FATTR_ATIME)
+			ts[0] = (struct timespec){ arg->atime, arg->atimensec };
+		if (arg->valid & FATTR_MTIME_NOW)
+			ts[1].tv_nsec = UTIME_NOW;
+		else if (arg->valid & FATTR_MTIME)
+			ts[1] = (struct timespec){ arg->mtime, arg->mtimensec };
+		if (utimensat(AT_FDCWD, path, ts, 0) < 0)
+			return reply(w, in->unique, errno, NULL, 0);
+	}
+
+	if (fstatat(node->fd, "", &st, AT_EMPTY_PATH | AT_SYMLINK_NOFOLLOW) < 0)
+		return reply(w, in->unique, errno, NULL, 0);
+	memset(&out, 0, sizeof(out));
+	out.attr_valid = 1;
+	fill_attr(&out.attr, &st);
+	return reply(w, in->unique, 0, &out, sizeof(out));
+}
+
+static int handle_request(struct worker *w, struct fuse_in_header *in)
+{
+	struct node *node = get_node(in->nodeid);
+	void *arg = in + 1;
+	char path[64];
+	int fd, ret;
+
+	switch (in->opcode) {
+	case FUSE_INIT:
+		return do_init(w, in, arg);
+
+	case FUSE_LOOKUP: {
+		struct fuse_entry_out entry;
+
+		ret = do_entry(node, arg, &entry);
+		return reply(w, in->unique, ret, &entry, sizeof(entry));
+	}
+
+	case FUSE_FORGET: {
+		struct fuse_forget_in *forget = arg;
+
+		/* no reply */
+		node_forget(node, forget->nlookup);
+		return 0;
+	}
+
+	case FUSE_BATCH_FORGET: {
+		struct fuse_batch_forget_in *batch = arg;
+		struct fuse_forget_one *one = (void *)(batch + 1);
+		unsigned int i;
+
+		for (i = 0; i < batch->count; i++)
+			node_forget(get_node(one[i].nodeid), one[i].nlookup);
+		return 0;
+	}
+
+	case FUSE_GETATTR: {
+		struct fuse_attr_out out;
+		struct stat st;
+
+		if (fstatat(node->fd, "", &st,
+			    AT_EMPTY_PATH | AT_SYMLINK_NOFOLLOW) < 0)
+			return reply(w, in->unique, errno, NULL, 0);
+		memset(&out, 0, sizeof(out));
+		out.attr_valid = 1;
+		fill_attr(&out.attr, &st);
+		return reply(w, in->unique, 0, &out, sizeof(out));
+	}
+
+	case FUSE_SETATTR:
+		return do_setattr(w, in, node, arg);
+
+	case FUSE_OPEN: {
+		struct fuse_open_in *open_in = arg;
+		struct fuse_open_out out;
+
+		proc_path(path, node->fd);
+		fd = open(path, open_flags(open_in->flags));
+		if (fd < 0)
+			return reply(w, in->unique, errno, NULL, 0);
+		fill_open(w, &out, fd);
+		return reply(w, in->unique, 0, &out, sizeof(out));
+	}
+
+	case FUSE_CREATE: {
+		struct fuse_create_in *create = arg;
+		const char *name = (const char *)(create + 1);
+		struct {
+			struct fuse_entry_out entry;
+			struct fuse_open_out open;
+		} out;
+
+		fd = openat(node->fd, name, open_flags(create->flags) | O_CREAT,
+			    create->mode);
+		if (fd < 0)
+			return reply(w, in->unique, errno, NULL, 0);
+		ret = do_entry(node, name, &out.entry);
+		if (ret) {
+			close(fd);
+			return reply(w, in->unique, ret, NULL, 0);
+		}
+		fill_open(w, &out.open, fd);
+		return reply(w, in->unique, 0, &out, sizeof(out));
+	}
+
+	case FUSE_MKDIR: {
+		struct fuse_mkdir_in *mkdir_in = arg;
+		const char *name = (const char *)(mkdir_in + 1);
+		struct fuse_entry_out entry;
+
+		if (mkdirat(node->fd, name, mkdir_in->mode) < 0)
+			return reply(w, in->unique, errno, NULL, 0);
+		ret = do_entry(node, name, &entry);
+		return reply(w, in->unique, ret, &entry, sizeof(entry));
+	}
+
+	case FUSE_UNLINK:
+	case FUSE_RMDIR:
+		ret = unlinkat(node->fd, arg,
+			       in->opcode == FUSE_RMDIR ? AT_REMOVEDIR : 0);
+		return reply(w, in->unique, ret < 0 ? errno : 0, NULL, 0);
+
+	case FUSE_READ: {
+		struct fuse_read_in *read_in = arg;
+		ssize_t n;
+
+		if (read_in->size > buf_size)
+			return reply(w, in->unique, EINVAL, NULL, 0);
+		n = pread(read_in->fh, w->out, read_in->size, read_in->offset);
+		if (n < 0)
+			return reply(w, in->unique, errno, NULL, 0);
+		return reply(w, in->unique, 0, w->out, n);
+	}
+
+	case FUSE_WRITE: {
+		struct fuse_write_in *write_in = arg;
+		struct fuse_write_out out = { 0 };
+		ssize_t n;
+
+		n = pwrite(write_in->fh, write_in + 1, write_in->size,
+			   write_in->offset);
+		if (n < 0)
+			return reply(w, in->unique, errno, NULL, 0);
+		out.size = n;
+		return reply(w, in->unique, 0, &out, sizeof(out));
+	}
+
+	case FUSE_FLUSH:
+		return reply(w, in->unique, 0, NULL, 0);
+
+	case FUSE_FSYNC: {
+		struct fuse_fsync_in *fsync_in = arg;
+
+		if (fsync_in->fsync_flags & 1)
+			ret = fdatasync(fsync_in->fh);
+		else
+			ret = fsync(fsync_in->fh);
+		return reply(w, in->unique, ret < 0 ? errno : 0, NULL, 0);
+	}
+
+	case FUSE_RELEASE: {
+		struct fuse_release_in *release = arg;
+
+		close(release->fh);
+		return reply(w, in->unique, 0, NULL, 0);
+	}
+
+	case FUSE_OPENDIR: {
+		struct fuse_open_out out;
+		struct dir *d;
+
+		d = calloc(1, sizeof(*d));
+		if (!d)
+			return reply(w, in->unique, ENOMEM, NULL, 0);
+		fd = openat(node->fd, ".", O_RDONLY | O_DIRECTORY);
+		if (fd >= 0)
+			d->dp = fdopendir(fd);
+		if (!d->dp) {
+			ret = errno;
+			if (fd >= 0)
+				close(fd);
+			free(d);
+			return reply(w, in->unique, ret, NULL, 0);
+		}
+		memset(&out, 0, sizeof(out));
+		out.fh = (uintptr_t)d;
+		return reply(w, in->unique, 0, &out, sizeof(out));
+	}
+
+	case FUSE_READDIR:
+		return do_readdir(w, in, arg);
+
+	case FUSE_RELEASEDIR: {
+		struct fuse_release_in *release = arg;
+		struct dir *d = (struct dir *)(uintptr_t)release->fh;
+
+		closedir(d->dp);
+		free(d);
+		return reply(w, in->unique, 0, NULL, 0);
+	}
+
+	case FUSE_STATFS: {
+		struct fuse_statfs_out out;
+		struct statvfs st;
+
+		if (statvfs(backing_path, &st) < 0)
+			return reply(w, in->unique, errno, NULL, 0);
+		memset(&out, 0, sizeof(out));
+		out.st.blocks	= st.f_blocks;
+		out.st.bfree	= st.f_bfree;
+		out.st.bavail	= st.f_bavail;
+		out.st.files	= st.f_files;
+		out.st.ffree	= st.f_ffree;
+		out.st.bsize	= st.f_bsize;
+		out.st.frsize	= st.f_frsize;
+		out.st.namelen	= st.f_namemax;
+		return reply(w, in->unique, 0, &out, sizeof(out));
+	}
+
+	case FUSE_INTERRUPT:
+		/* requests are never waited on here, nothing to interrupt */
+		return 0;
+
+	default:
+		return reply(w, in->unique, ENOSYS, NULL, 0);
+	}
+}
+
+/* Returns false once the filesystem is gone */
+static bool process_one(struct worker *w)
+{
+	ssize_t n = read(w->fd, w->in, buf_size);
+
+	if (n < 0) {
+		/* ENOENT: the request was interrupted before we got it */
+		if (errno == EINTR || errno == EAGAIN || errno == ENOENT)
+			return true;
+		if (errno == ENODEV)
+			return false;
+		err(EXIT_FAILURE, "read /dev/fuse");
+	}
+	if ((size_t)n < sizeof(struct fuse_in_header))
+		errx(EXIT_FAILURE, "short read from /dev/fuse");
+
+	handle_request(w, (struct fuse_in_header *)w->in);
+	return true;
+}
+
+static void *worker_fn(void *arg)
+{
+	struct worker *w = arg;
+
+	while (process_one(w))
+		;
+	return NULL;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-m max_pages] [-t threads] [-w] [-p] <backing dir> <mountpoint>\n",
+		prog);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+	struct worker *workers;
+	char opts[256];
+	struct stat st;
+	unsigned int i;
+	int opt, fd;
+
+	while ((opt = getopt(argc, argv, "m:t:wp")) != -1) {
+		switch (opt) {
+		case 'm':
+			max_pages = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			nthreads = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			writeback = true;
+			break;
+		case 'p':
+			passthrough = true;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (argc - optind != 2 || !nthreads || max_pages > UINT16_MAX)
+		usage(argv[0]);
+	backing_path = argv[optind];
+
+	page_size = sysconf(_SC_PAGESIZE);
+	/* room for the largest WRITE request, headers included */
+	buf_size = ((max_pages > 32 ? max_pages : 32) + 1) * page_size;
+
+	root.fd = open(backing_path, O_PATH | O_DIRECTORY);
+	if (root.fd < 0 || fstat(root.fd, &st) < 0)
+		err(EXIT_FAILURE, "%s", backing_path);
+	root.dev = st.st_dev;
+	root.ino = st.st_ino;
+
+	fd = open("/dev/fuse", O_RDWR | O_CLOEXEC);
+	if (fd < 0)
+		err(EXIT_FAILURE, "/dev/fuse");
+	snprintf(opts, sizeof(opts),
+		 "fd=%d,rootmode=%o,user_id=0,group_id=0,allow_other,default_permissions",
+		 fd, st.st_mode & S_IFMT);
+	if (mount("fuse-passthrough", argv[optind + 1], "fuse",
+		  MS_NOSUID | MS_NODEV, opts) < 0)
+		err(EXIT_FAILURE, "mount %s", argv[optind + 1]);
+
+	workers = calloc(nthreads, sizeof(*workers));
+	if (!workers)
+		err(EXIT_FAILURE, "calloc");
+	for (i = 0; i < nthreads; i++) {
+		struct worker *w = &workers[i];
+
+		w->in = malloc(buf_size);
+		w->out = malloc(buf_size);
+		if (!w->in || !w->out)
+			err(EXIT_FAILURE, "malloc");
+		w->fd = fd;
+		if (!i) {
+			/* INIT must be answered before anything else */
+			if (!process_one(w))
+				return EXIT_FAILURE;
+			continue;
+		}
+
+		/* every thread gets its own device fd */
+		w->fd = open("/dev/fuse", O_RDWR | O_CLOEXEC);
+		if (w->fd < 0)
+			err(EXIT_FAILURE, "/dev/fuse");
+		if (ioctl(w->fd, FUSE_DEV_IOC_CLONE, &fd) < 0)
+			err(EXIT_FAILURE, "FUSE_DEV_IOC_CLONE");
+		if (pthread_create(&w->thread, NULL, worker_fn, w))
+			errx(EXIT_FAILURE, "pthread_create");
+	}
+
+	worker_fn(&workers[0]);
+	for (i = 1; i < nthreads; i++)
+		pthread_join(workers[i].thread, NULL);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,313 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * epoll-ctl: Stress epoll_ctl(2) add/mod/del operations.
+ *
+ * Every worker owns a set of eventfds and keeps adding, modifying and
+ * removing them from an epoll instance, picking the operation at random.
+ * Half of the fds are kept readable so that insertions and modifications
+ * also go through the ready list. By default all workers share a single
+ * epoll instance, --multiq gives each of them its own.
+ */
+
+/* For the CLR_() macros */
+#include <string.h>
+#include <pthread.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <linux/compiler.h>
+#include <linux/kernel.h>
+#include <sys/time.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "../util/stat.h"
+#include <subcmd/parse-options.h>
+#include "bench.h"
+#include "cpumap.h"
+
+#include <err.h>
+
+enum {
+	OP_EPOLL_ADD,
+	OP_EPOLL_MOD,
+	OP_EPOLL_DEL,
+	EPOLL_NR_OPS,
+};
+
+static const char * const op_names[EPOLL_NR_OPS] = {
+	"ADD", "MOD", "DEL",
+};
+
+static unsigned int nthreads = 0;
+static unsigned int nsecs    = 8;
+/* amount of eventfds per thread */
+static unsigned int nfds     = 64;
+static bool done = false, silent = false, multiq = false;
+static int epollfd;
+
+struct timeval start, end, runtime;
+static pthread_mutex_t thread_lock;
+static unsigned int threads_starting;
+static struct stats all_stats[EPOLL_NR_OPS];
+static pthread_cond_t thread_parent, thread_worker;
+
+struct worker {
+	int tid;
+	int epollfd;
+	int *fdmap;
+	bool *added;
+	pthread_t thread;
+	unsigned long ops[EPOLL_NR_OPS];
+};
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &nthreads, "Specify amount of threads"),
+	OPT_UINTEGER('r', "runtime", &nsecs,    "Specify runtime (in seconds)"),
+	OPT_UINTEGER('f', "nfds",    &nfds,     "Specify amount of file descriptors per thread"),
+	OPT_BOOLEAN( 'm', "multiq",  &multiq,   "Use an epoll instance per thread"),
+	OPT_BOOLEAN( 's', "silent",  &silent,   "Silent mode: do not display data/details"),
+	OPT_END()
+};
+
+static const char * const bench_epoll_ctl_usage[] = {
+	"perf bench epoll ctl <options>",
+	NULL
+};
+
+static void do_epoll_op(struct worker *w, int op, unsigned int i)
+{
+	struct epoll_event ev;
+	int fd = w->fdmap[i];
+
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+
+	switch (op) {
+	case OP_EPOLL_ADD:
+		if (w->added[i])
+			return;
+		if (epoll_ctl(w->epollfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+			err(EXIT_FAILURE, "epoll_ctl ADD");
+		w->added[i] = true;
+		break;
+	case OP_EPOLL_MOD:
+		if (!w->added[i])
+			return;
+		ev.events |= EPOLLOUT;
+		if (epoll_ctl(w->epollfd, EPOLL_CTL_MOD, fd, &ev) < 0)
+			err(EXIT_FAILURE, "epoll_ctl MOD");
+		break;
+	case OP_EPOLL_DEL:
+		if (!w->added[i])
+			return;
+		if (epoll_ctl(w->epollfd, EPOLL_CTL_DEL, fd, NULL) < 0)
+			err(EXIT_FAILURE, "epoll_ctl DEL");
+		w->added[i] = false;
+		break;
+	default:
+		return;
+	}
+
+	w->ops[op]++;
+}
+
+static void *workerfn(void *arg)
+{
+	struct worker *w = (struct worker *) arg;
+	unsigned int seed = w->tid;
+
+	pthread_mutex_lock(&thread_lock);
+	threads_starting--;
+	if (!threads_starting)
+		pthread_cond_signal(&thread_parent);
+	pthread_cond_wait(&thread_worker, &thread_lock);
+	pthread_mutex_unlock(&thread_lock);
+
+	do {
+		do_epoll_op(w, rand_r(&seed) % EPOLL_NR_OPS,
+			    rand_r(&seed) % nfds);
+	} while (!done);
+
+	return NULL;
+}
+
+static void setup_worker(struct worker *w)
+{
+	uint64_t val = 1;
+	unsigned int i;
+
+	w->fdmap = calloc(nfds, sizeof(int));
+	w->added = calloc(nfds, sizeof(bool));
+	if (!w->fdmap || !w->added)
+		err(EXIT_FAILURE, "calloc");
+
+	if (multiq) {
+		w->epollfd = epoll_create1(0);
+		if (w->epollfd < 0)
+			err(EXIT_FAILURE, "epoll_create1");
+	} else {
+		w->epollfd = epollfd;
+	}
+
+	for (i = 0; i < nfds; i++) {
+		w->fdmap[i] = eventfd(0, EFD_NONBLOCK);
+		if (w->fdmap[i] < 0)
+			err(EXIT_FAILURE, "eventfd");
+
+		/* make every other fd readable, hitting the ready list */
+		if ((i & 1) && write(w->fdmap[i], &val, sizeof(val)) != sizeof(val))
+			err(EXIT_FAILURE, "write");
+	}
+}
+
+static void toggle_done(int sig __maybe_unused,
+			siginfo_t *info __maybe_unused,
+			void *uc __maybe_unused)
+{
+	/* inform all threads that we're done for the day */
+	done = true;
+	gettimeofday(&end, NULL);
+	timersub(&end, &start, &runtime);
+}
+
+static void print_summary(void)
+{
+	int i;
+
+	if (!silent)
+		printf("\n");
+
+	for (i = 0; i < EPOLL_NR_OPS; i++) {
+		unsigned long avg = avg_stats(&all_stats[i]);
+		double stddev = stddev_stats(&all_stats[i]);
+
+		printf("Averaged %ld %s operations/sec (+- %.2f%%), total secs = %d\n",
+		       avg, op_names[i], rel_stddev_stats(stddev, avg),
+		       (int) runtime.tv_sec);
+	}
+}
+
+int bench_epoll_ctl(int argc, const char **argv)
+{
+	int ret = 0;
+	cpu_set_t cpuset;
+	struct sigaction act;
+	unsigned int i, j;
+	pthread_attr_t thread_attr;
+	struct worker *worker = NULL;
+	struct cpu_map *cpu;
+
+	argc = parse_options(argc, argv, options, bench_epoll_ctl_usage, 0);
+	if (argc) {
+		usage_with_options(bench_epoll_ctl_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	cpu = cpu_map__new(NULL);
+	if (!cpu)
+		goto errmem;
+
+	sigfillset(&act.sa_mask);
+	act.sa_sigaction = toggle_done;
+	sigaction(SIGINT, &act, NULL);
+
+	if (!nthreads) /* default to the number of CPUs */
+		nthreads = cpu->nr;
+
+	worker = calloc(nthreads, sizeof(*worker));
+	if (!worker)
+		goto errmem;
+
+	if (!multiq) {
+		epollfd = epoll_create1(0);
+		if (epollfd < 0)
+			err(EXIT_FAILURE, "epoll_create1");
+	}
+
+	printf("Run summary [PID %d]: %d threads doing epoll_ctl ops on %s with %d fds each for %d secs.\n\n",
+	       getpid(), nthreads, multiq ? "per-thread epoll instances" : "a shared epoll instance",
+	       nfds, nsecs);
+
+	for (i = 0; i < EPOLL_NR_OPS; i++)
+		init_stats(&all_stats[i]);
+	pthread_mutex_init(&thread_lock, NULL);
+	pthread_cond_init(&thread_parent, NULL);
+	pthread_cond_init(&thread_worker, NULL);
+
+	threads_starting = nthreads;
+	pthread_attr_init(&thread_attr);
+	for (i = 0; i < nthreads; i++) {
+		worker[i].tid = i;
+		setup_worker(&worker[i]);
+
+		CPU_ZERO(&cpuset);
+		CPU_SET(cpu->map[i % cpu->nr], &cpuset);
+
+		ret = pthread_attr_setaffinity_np(&thread_attr, sizeof(cpu_set_t), &cpuset);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_attr_setaffinity_np");
+
+		ret = pthread_create(&worker[i].thread, &thread_attr, workerfn,
+				     (void *)(struct worker *) &worker[i]);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_create");
+	}
+	pthread_attr_destroy(&thread_attr);
+
+	pthread_mutex_lock(&thread_lock);
+	while (threads_starting)
+		pthread_cond_wait(&thread_parent, &thread_lock);
+	gettimeofday(&start, NULL);
+	pthread_cond_broadcast(&thread_worker);
+	pthread_mutex_unlock(&thread_lock);
+
+	sleep(nsecs);
+	toggle_done(0, NULL, NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		ret = pthread_join(worker[i].thread, NULL);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_join");
+	}
+
+	/* cleanup & report results */
+	pthread_cond_destroy(&thread_parent);
+	pthread_cond_destroy(&thread_worker);
+	pthread_mutex_destroy(&thread_lock);
+
+	for (i = 0; i < nthreads; i++) {
+		unsigned long t[EPOLL_NR_OPS];
+
+		for (j = 0; j < EPOLL_NR_OPS; j++) {
+			t[j] = worker[i].ops[j] / runtime.tv_sec;
+			update_stats(&all_stats[j], t[j]);
+		}
+
+		if (!silent)
+			printf("[thread %2d] fdmap: %p [ add: %ld mod: %ld del: %ld ops/sec ]\n",
+			       worker[i].tid, worker[i].fdmap,
+			       t[OP_EPOLL_ADD], t[OP_EPOLL_MOD], t[OP_EPOLL_DEL]);
+
+		for (j = 0; j < nfds; j++)
+			close(worker[i].fdmap[j]);
+		if (multiq)
+			close(worker[i].epollfd);
+		free(worker[i].fdmap);
+		free(worker[i].added);
+	}
+	if (!multiq)
+		close(epollfd);
+
+	print_summary();
+
+	free(worker);
+	free(cpu);
+	return ret;
+errmem:
+	err(EXIT_FAILURE, "calloc");
+}
@@ -0,0 +1,327 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * epoll-wait: Stress epoll_wait(2) wakeups and ready list handling.
+ *
+ * A single writer thread keeps signaling eventfds while a bunch of
+ * worker threads sit in epoll_wait(2) and consume the events. By default
+ * all workers share one epoll instance, which is the case where the
+ * kernel's ready list and poll callback contend the most; --multiq gives
+ * every worker its own epoll instance instead.
+ */
+
+/* For the CLR_() macros */
+#include <string.h>
+#include <pthread.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <linux/compiler.h>
+#include <linux/kernel.h>
+#include <sys/time.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "../util/stat.h"
+#include <subcmd/parse-options.h>
+#include "bench.h"
+#include "cpumap.h"
+
+#include <err.h>
+
+static unsigned int nthreads = 0;
+static unsigned int nsecs    = 8;
+/* amount of eventfds per thread */
+static unsigned int nfds     = 64;
+static bool done = false, silent = false;
+static bool multiq = false, et = false, oneshot = false, exclusive = false;
+static int epollfd;
+
+struct timeval start, end, runtime;
+static pthread_mutex_t thread_lock;
+static unsigned int threads_starting;
+static struct stats throughput_stats;
+static pthread_cond_t thread_parent, thread_worker;
+
+struct worker {
+	int tid;
+	int epollfd;
+	int *fdmap;
+	pthread_t thread;
+	unsigned long ops;
+};
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &nthreads, "Specify amount of threads"),
+	OPT_UINTEGER('r', "runtime", &nsecs,    "Specify runtime (in seconds)"),
+	OPT_UINTEGER('f', "nfds",    &nfds,     "Specify amount of file descriptors per thread"),
+	OPT_BOOLEAN( 'm', "multiq",  &multiq,   "Use an epoll instance per thread"),
+	OPT_BOOLEAN( 'E', "edge",    &et,       "Use edge-triggered events"),
+	OPT_BOOLEAN( 'o', "oneshot", &oneshot,  "Use EPOLLONESHOT and rearm after each event"),
+	OPT_BOOLEAN( 'x', "exclusive", &exclusive, "Use EPOLLEXCLUSIVE wakeups"),
+	OPT_BOOLEAN( 's', "silent",  &silent,   "Silent mode: do not display data/details"),
+	OPT_END()
+};
+
+static const char * const bench_epoll_wait_usage[] = {
+	"perf bench epoll wait <options>",
+	NULL
+};
+
+static void *workerfn(void *arg)
+{
+	struct worker *w = (struct worker *) arg;
+	unsigned long ops = w->ops; /* avoid cacheline bouncing */
+	struct epoll_event ev;
+	uint64_t val;
+	int ret, fd;
+
+	pthread_mutex_lock(&thread_lock);
+	threads_starting--;
+	if (!threads_starting)
+		pthread_cond_signal(&thread_parent);
+	pthread_cond_wait(&thread_worker, &thread_lock);
+	pthread_mutex_unlock(&thread_lock);
+
+	do {
+		/* timeout so that we notice the end of the run */
+		ret = epoll_wait(w->epollfd, &ev, 1, 100);
+		if (ret < 0) {
+			if (errno != EINTR)
+				err(EXIT_FAILURE, "epoll_wait");
+			continue;
+		}
+		if (!ret)
+			continue;
+
+		fd = ev.data.fd;
+		/* another waiter may have consumed it already */
+		if (read(fd, &val, sizeof(val)) == sizeof(val))
+			ops++;
+
+		if (oneshot) {
+			ev.events = EPOLLIN | EPOLLONESHOT;
+			if (et)
+				ev.events |= EPOLLET;
+			if (epoll_ctl(w->epollfd, EPOLL_CTL_MOD, fd, &ev) < 0)
+				err(EXIT_FAILURE, "epoll_ctl");
+		}
+	} while (!done);
+
+	w->ops = ops;
+	return NULL;
+}
+
+/* Keep kicking every eventfd, round-robin, until told to stop. */
+static void *writerfn(void *arg)
+{
+	struct worker *worker = (struct worker *) arg;
+	uint64_t val = 1;
+	unsigned int i, j;
+
+	do {
+		for (i = 0; i < nthreads; i++) {
+			for (j = 0; j < nfds; j++) {
+				if (write(worker[i].fdmap[j], &val,
+					  sizeof(val)) != sizeof(val))
+					err(EXIT_FAILURE, "write");
+			}
+		}
+	} while (!done);
+
+	return NULL;
+}
+
+static void setup_worker(struct worker *w)
+{
+	struct epoll_event ev;
+	unsigned int i;
+
+	w->fdmap = calloc(nfds, sizeof(int));
+	if (!w->fdmap)
+		err(EXIT_FAILURE, "calloc");
+
+	if (multiq) {
+		w->epollfd = epoll_create1(0);
+		if (w->epollfd < 0)
+			err(EXIT_FAILURE, "epoll_create1");
+	} else {
+		w->epollfd = epollfd;
+	}
+
+	ev.events = EPOLLIN;
+	if (et)
+		ev.events |= EPOLLET;
+	if (oneshot)
+		ev.events |= EPOLLONESHOT;
+	if (exclusive)
+		ev.events |= EPOLLEXCLUSIVE;
+
+	for (i = 0; i < nfds; i++) {
+		w->fdmap[i] = eventfd(0, EFD_NONBLOCK);
+		if (w->fdmap[i] < 0)
+			err(EXIT_FAILURE, "eventfd");
+
+		ev.data.fd = w->fdmap[i];
+		if (epoll_ctl(w->epollfd, EPOLL_CTL_ADD, w->fdmap[i], &ev) < 0)
+			err(EXIT_FAILURE, "epoll_ctl");
+	}
+}
+
+static void toggle_done(int sig __maybe_unused,
+			siginfo_t *info __maybe_unused,
+			void *uc __maybe_unused)
+{
+	/* inform all threads that we're done for the day */
+	done = true;
+	gettimeofday(&end, NULL);
+	timersub(&end, &start, &runtime);
+}
+
+static void print_summary(void)
+{
+	unsigned long avg = avg_stats(&throughput_stats);
+	double stddev = stddev_stats(&throughput_stats);
+
+	printf("%sAveraged %ld operations/sec (+- %.2f%%), total secs = %d\n",
+	       !silent ? "\n" : "", avg, rel_stddev_stats(stddev, avg),
+	       (int) runtime.tv_sec);
+}
+
+int bench_epoll_wait(int argc, const char **argv)
+{
+	int ret = 0;
+	cpu_set_t cpuset;
+	struct sigaction act;
+	unsigned int i, j;
+	pthread_attr_t thread_attr;
+	struct worker *worker = NULL;
+	struct cpu_map *cpu;
+	pthread_t writer;
+
+	argc = parse_options(argc, argv, options, bench_epoll_wait_usage, 0);
+	if (argc) {
+		usage_with_options(bench_epoll_wait_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	if (exclusive && multiq)
+		errx(EXIT_FAILURE, "--exclusive only makes sense with a shared epoll instance");
+	if (exclusive && oneshot)
+		errx(EXIT_FAILURE, "EPOLLEXCLUSIVE cannot be combined with EPOLLONESHOT");
+
+	cpu = cpu_map__new(NULL);
+	if (!cpu)
+		goto errmem;
+
+	sigfillset(&act.sa_mask);
+	act.sa_sigaction = toggle_done;
+	sigaction(SIGINT, &act, NULL);
+
+	if (!nthreads) /* default to the number of CPUs, minus the writer */
+		nthreads = cpu->nr > 1 ? cpu->nr - 1 : 1;
+
+	worker = calloc(nthreads, sizeof(*worker));
+	if (!worker)
+		goto errmem;
+
+	if (!multiq) {
+		epollfd = epoll_create1(0);
+		if (epollfd < 0)
+			err(EXIT_FAILURE, "epoll_create1");
+	}
+
+	printf("Run summary [PID %d]: %d threads waiting on %s with %d %s%s%sfds each for %d secs.\n\n",
+	       getpid(), nthreads, multiq ? "per-thread epoll instances" : "a shared epoll instance",
+	       nfds, et ? "edge-triggered " : "", oneshot ? "oneshot " : "",
+	       exclusive ? "exclusive " : "", nsecs);
+
+	init_stats(&throughput_stats);
+	pthread_mutex_init(&thread_lock, NULL);
+	pthread_cond_init(&thread_parent, NULL);
+	pthread_cond_init(&thread_worker, NULL);
+
+	threads_starting = nthreads;
+	pthread_attr_init(&thread_attr);
+	for (i = 0; i < nthreads; i++) {
+		worker[i].tid = i;
+		setup_worker(&worker[i]);
+
+		CPU_ZERO(&cpuset);
+		CPU_SET(cpu->map[(i + 1) % cpu->nr], &cpuset);
+
+		ret = pthread_attr_setaffinity_np(&thread_attr, sizeof(cpu_set_t), &cpuset);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_attr_setaffinity_np");
+
+		ret = pthread_create(&worker[i].thread, &thread_attr, workerfn,
+				     (void *)(struct worker *) &worker[i]);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_create");
+	}
+
+	pthread_mutex_lock(&thread_lock);
+	while (threads_starting)
+		pthread_cond_wait(&thread_parent, &thread_lock);
+	pthread_cond_broadcast(&thread_worker);
+	pthread_mutex_unlock(&thread_lock);
+
+	/* the writer gets the first CPU to itself */
+	CPU_ZERO(&cpuset);
+	CPU_SET(cpu->map[0], &cpuset);
+	ret = pthread_attr_setaffinity_np(&thread_attr, sizeof(cpu_set_t), &cpuset);
+	if (ret)
+		err(EXIT_FAILURE, "pthread_attr_setaffinity_np");
+
+	gettimeofday(&start, NULL);
+	ret = pthread_create(&writer, &thread_attr, writerfn, worker);
+	if (ret)
+		err(EXIT_FAILURE, "pthread_create");
+	pthread_attr_destroy(&thread_attr);
+
+	sleep(nsecs);
+	toggle_done(0, NULL, NULL);
+
+	ret = pthread_join(writer, NULL);
+	if (ret)
+		err(EXIT_FAILURE, "pthread_join");
+
+	for (i = 0; i < nthreads; i++) {
+		ret = pthread_join(worker[i].thread, NULL);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_join");
+	}
+
+	/* cleanup & report results */
+	pthread_cond_destroy(&thread_parent);
+	pthread_cond_destroy(&thread_worker);
+	pthread_mutex_destroy(&thread_lock);
+
+	for (i = 0; i < nthreads; i++) {
+		unsigned long t = worker[i].ops / runtime.tv_sec;
+
+		update_stats(&throughput_stats, t);
+		if (!silent)
+			printf("[thread %2d] fdmap: %p [ %ld ops/sec ]\n",
+			       worker[i].tid, worker[i].fdmap, t);
+
+		for (j = 0; j < nfds; j++)
+			close(worker[i].fdmap[j]);
+		if (multiq)
+			close(worker[i].epollfd);
+		free(worker[i].fdmap);
+	}
+	if (!multiq)
+		close(epollfd);
+
+	print_summary();
+
+	free(worker);
+	free(cpu);
+	return ret;
+errmem:
+	err(EXIT_FAILURE, "calloc");
+}
@@ -0,0 +1,349 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * fs-dirops: Stress create and unlink of files in a single directory.
+ *
+ * Every worker keeps a window of files in one shared directory, creating a
+ * new one with open(O_CREAT|O_EXCL) and unlinking the oldest one once the
+ * window is full. This is what mail spools and object stores keeping lots
+ * of files in one directory do, and it mostly measures how much the workers
+ * serialize on the directory. With --contended all workers pick from the
+ * same set of names, so they also race on individual entries. With
+ * --private-dirs every worker gets a directory of its own, like fs_mark
+ * runs do, which leaves only the contention inside the filesystem itself,
+ * e.g. on its journal. With --write every new file also gets some data,
+ * which adds the extent and checksum updates of small file writes to the
+ * metadata work; on btrfs all of it goes through the same subvolume tree,
+ * whose lock contention shows up in /proc/lock_stat.
+ */
+
+/* For the CLR_() macros */
+#include <string.h>
+#include <pthread.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <linux/compiler.h>
+#include <linux/kernel.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "../util/stat.h"
+#include <subcmd/parse-options.h>
+#include "bench.h"
+#include "cpumap.h"
+
+#include <err.h>
+
+enum {
+	OP_CREATE,
+	OP_UNLINK,
+	DIROPS_NR_OPS,
+};
+
+static const char * const op_names[DIROPS_NR_OPS] = {
+	"create", "unlink",
+};
+
+static unsigned int nthreads = 0;
+static unsigned int nsecs    = 8;
+/* amount of files each thread keeps around */
+static unsigned int nfiles   = 1024;
+/* bytes written to each new file */
+static unsigned int wsize    = 0;
+static const char *dirname;
+static bool done = false, silent = false, contended = false, private_dirs = false;
+static int dirfd;
+
+struct timeval start, end, runtime;
+static pthread_mutex_t thread_lock;
+static unsigned int threads_starting;
+static struct stats all_stats[DIROPS_NR_OPS];
+static pthread_cond_t thread_parent, thread_worker;
+
+struct worker {
+	int tid;
+	int dirfd;
+	pthread_t thread;
+	unsigned long ops[DIROPS_NR_OPS];
+	unsigned long failed;
+};
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &nthreads, "Specify amount of threads"),
+	OPT_UINTEGER('r', "runtime", &nsecs,    "Specify runtime (in seconds)"),
+	OPT_UINTEGER('n', "nfiles",  &nfiles,   "Specify amount of files per thread"),
+	OPT_UINTEGER('w', "write",   &wsize,    "Specify bytes written to every new file"),
+	OPT_STRING(  'd', "dir",     &dirname,  "path", "Create the files in a new directory below path"),
+	OPT_BOOLEAN( 'c', "contended", &contended, "Have all threads use the same file names"),
+	OPT_BOOLEAN( 'p', "private-dirs", &private_dirs, "Give every thread a directory of its own"),
+	OPT_BOOLEAN( 's', "silent",  &silent,   "Silent mode: do not display data/details"),
+	OPT_END()
+};
+
+static const char * const bench_fs_dirops_usage[] = {
+	"perf bench fs dirops <options>",
+	NULL
+};
+
+static void file_name(char *buf, struct worker *w, unsigned long i)
+{
+	if (contended)
+		sprintf(buf, "f%lu", i % nfiles);
+	else
+		sprintf(buf, "t%d-%lu", w->tid, i % nfiles);
+}
+
+static void fill_file(int fd, const char *buf)
+{
+	if (wsize && write(fd, buf, wsize) != (ssize_t)wsize)
+		err(EXIT_FAILURE, "write");
+	close(fd);
+}
+
+static void *workerfn(void *arg)
+{
+	struct worker *w = (struct worker *) arg;
+	unsigned int seed = w->tid;
+	unsigned long head = 0, tail = 0;
+	char name[32];
+	char *buf = NULL;
+	int fd;
+
+	if (wsize) {
+		buf = malloc(wsize);
+		if (!buf)
+			err(EXIT_FAILURE, "malloc");
+		memset(buf, 0x5a, wsize);
+	}
+
+	pthread_mutex_lock(&thread_lock);
+	threads_starting--;
+	if (!threads_starting)
+		pthread_cond_signal(&thread_parent);
+	pthread_cond_wait(&thread_worker, &thread_lock);
+	pthread_mutex_unlock(&thread_lock);
+
+	do {
+		if (contended) {
+			/* racing on the same names, failures are expected */
+			file_name(name, w, rand_r(&seed));
+			if (rand_r(&seed) & 1) {
+				fd = openat(w->dirfd, name, O_CREAT | O_EXCL | O_WRONLY, 0600);
+				if (fd >= 0) {
+					fill_file(fd, buf);
+					w->ops[OP_CREATE]++;
+				} else if (errno == EEXIST) {
+					w->failed++;
+				} else {
+					err(EXIT_FAILURE, "open");
+				}
+			} else {
+				if (!unlinkat(w->dirfd, name, 0))
+					w->ops[OP_UNLINK]++;
+				else if (errno == ENOENT)
+					w->failed++;
+				else
+					err(EXIT_FAILURE, "unlink");
+			}
+			continue;
+		}
+
+		if (head - tail == nfiles) {
+			file_name(name, w, tail++);
+			if (unlinkat(w->dirfd, name, 0))
+				err(EXIT_FAILURE, "unlink");
+			w->ops[OP_UNLINK]++;
+		}
+
+		file_name(name, w, head++);
+		fd = openat(w->dirfd, name, O_CREAT | O_EXCL | O_WRONLY, 0600);
+		if (fd < 0)
+			err(EXIT_FAILURE, "open");
+		fill_file(fd, buf);
+		w->ops[OP_CREATE]++;
+	} while (!done);
+
+	free(buf);
+	return NULL;
+}
+
+static void cleanup_dir(const char *path, struct worker *worker)
+{
+	unsigned int i, j;
+	char name[32];
+
+	/* the names are known, no need for readdir */
+	for (i = 0; i < (contended ? 1 : nthreads); i++) {
+		for (j = 0; j < nfiles; j++) {
+			file_name(name, &worker[i], j);
+			unlinkat(worker[i].dirfd, name, 0);
+		}
+		if (private_dirs) {
+			close(worker[i].dirfd);
+			sprintf(name, "t%d", worker[i].tid);
+			if (unlinkat(dirfd, name, AT_REMOVEDIR))
+				warn("rmdir %s/%s", path, name);
+		}
+	}
+	close(dirfd);
+
+	if (rmdir(path))
+		warn("rmdir %s", path);
+}
+
+static void toggle_done(int sig __maybe_unused,
+			siginfo_t *info __maybe_unused,
+			void *uc __maybe_unused)
+{
+	/* inform all threads that we're done for the day */
+	done = true;
+	gettimeofday(&end, NULL);
+	timersub(&end, &start, &runtime);
+}
+
+static void print_summary(void)
+{
+	int i;
+
+	if (!silent)
+		printf("\n");
+
+	for (i = 0; i < DIROPS_NR_OPS; i++) {
+		unsigned long avg = avg_stats(&all_stats[i]);
+		double stddev = stddev_stats(&all_stats[i]);
+
+		printf("Averaged %ld %s operations/sec (+- %.2f%%), total secs = %d\n",
+		       avg, op_names[i], rel_stddev_stats(stddev, avg),
+		       (int) runtime.tv_sec);
+	}
+}
+
+int bench_fs_dirops(int argc, const char **argv)
+{
+	int ret = 0;
+	cpu_set_t cpuset;
+	struct sigaction act;
+	unsigned int i, j;
+	pthread_attr_t thread_attr;
+	struct worker *worker = NULL;
+	struct cpu_map *cpu;
+	char path[PATH_MAX];
+
+	argc = parse_options(argc, argv, options, bench_fs_dirops_usage, 0);
+	if (argc || !nfiles || (contended && private_dirs)) {
+		usage_with_options(bench_fs_dirops_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	cpu = cpu_map__new(NULL);
+	if (!cpu)
+		goto errmem;
+
+	sigfillset(&act.sa_mask);
+	act.sa_sigaction = toggle_done;
+	sigaction(SIGINT, &act, NULL);
+
+	if (!nthreads) /* default to the number of CPUs */
+		nthreads = cpu->nr;
+
+	worker = calloc(nthreads, sizeof(*worker));
+	if (!worker)
+		goto errmem;
+
+	snprintf(path, sizeof(path), "%s/perf-bench-dirops.XXXXXX",
+		 dirname ?: ".");
+	if (!mkdtemp(path))
+		err(EXIT_FAILURE, "mkdtemp");
+	dirfd = open(path, O_RDONLY | O_DIRECTORY);
+	if (dirfd < 0)
+		err(EXIT_FAILURE, "open %s", path);
+
+	printf("Run summary [PID %d]: %d threads creating and unlinking %s%d files of %d bytes each in %s%s for %d secs.\n\n",
+	       getpid(), nthreads, contended ? "the same " : "", nfiles, wsize,
+	       private_dirs ? "their own directory below " : "", path, nsecs);
+
+	for (i = 0; i < DIROPS_NR_OPS; i++)
+		init_stats(&all_stats[i]);
+	pthread_mutex_init(&thread_lock, NULL);
+	pthread_cond_init(&thread_parent, NULL);
+	pthread_cond_init(&thread_worker, NULL);
+
+	threads_starting = nthreads;
+	pthread_attr_init(&thread_attr);
+	for (i = 0; i < nthreads; i++) {
+		worker[i].tid = i;
+		worker[i].dirfd = dirfd;
+		if (private_dirs) {
+			char name[32];
+
+			sprintf(name, "t%d", i);
+			if (mkdirat(dirfd, name, 0700))
+				err(EXIT_FAILURE, "mkdir");
+			worker[i].dirfd = openat(dirfd, name, O_RDONLY | O_DIRECTORY);
+			if (worker[i].dirfd < 0)
+				err(EXIT_FAILURE, "open");
+		}
+
+		CPU_ZERO(&cpuset);
+		CPU_SET(cpu->map[i % cpu->nr], &cpuset);
+
+		ret = pthread_attr_setaffinity_np(&thread_attr, sizeof(cpu_set_t), &cpuset);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_attr_setaffinity_np");
+
+		ret = pthread_create(&worker[i].thread, &thread_attr, workerfn,
+				     (void *)(struct worker *) &worker[i]);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_create");
+	}
+	pthread_attr_destroy(&thread_attr);
+
+	pthread_mutex_lock(&thread_lock);
+	while (threads_starting)
+		pthread_cond_wait(&thread_parent, &thread_lock);
+	gettimeofday(&start, NULL);
+	pthread_cond_broadcast(&thread_worker);
+	pthread_mutex_unlock(&thread_lock);
+
+	sleep(nsecs);
+	toggle_done(0, NULL, NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		ret = pthread_join(worker[i].thread, NULL);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_join");
+	}
+
+	/* cleanup & report results */
+	pthread_cond_destroy(&thread_parent);
+	pthread_cond_destroy(&thread_worker);
+	pthread_mutex_destroy(&thread_lock);
+
+	for (i = 0; i < nthreads; i++) {
+		unsigned long t[DIROPS_NR_OPS];
+
+		for (j = 0; j < DIROPS_NR_OPS; j++) {
+			t[j] = worker[i].ops[j] / runtime.tv_sec;
+			update_stats(&all_stats[j], t[j]);
+		}
+
+		if (!silent)
+			printf("[thread %2d] [ create: %ld unlink: %ld ops/sec, %ld lost races ]\n",
+			       worker[i].tid, t[OP_CREATE], t[OP_UNLINK],
+			       worker[i].failed);
+	}
+
+	cleanup_dir(path, worker);
+	print_summary();
+
+	free(worker);
+	free(cpu);
+	return ret;
+errmem:
+	err(EXIT_FAILURE, "calloc");
+}
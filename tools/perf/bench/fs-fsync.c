@@ -0,0 +1,247 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * fs-fsync: Measure how many fsync(2)s per second a filesystem sustains.
+ *
+ * Every worker keeps appending a small record to its own file and syncing
+ * it, the way database logs do. With a journaling filesystem all of them
+ * end up waiting for journal commits, so the rate mostly shows how well
+ * commits of concurrent syncs are batched and overlapped.
+ */
+
+/* For the CLR_() macros */
+#include <string.h>
+#include <pthread.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <linux/compiler.h>
+#include <linux/kernel.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "../util/stat.h"
+#include <subcmd/parse-options.h>
+#include "bench.h"
+#include "cpumap.h"
+
+#include <err.h>
+
+static unsigned int nthreads = 0;
+static unsigned int nsecs    = 8;
+/* bytes written before each sync */
+static unsigned int size     = 4096;
+/* restart the files at this many MB, so they don't grow forever */
+static unsigned int max_mb   = 64;
+static const char *dirname;
+static bool done = false, silent = false, datasync = false;
+
+struct timeval start, end, runtime;
+static pthread_mutex_t thread_lock;
+static unsigned int threads_starting;
+static struct stats throughput_stats;
+static pthread_cond_t thread_parent, thread_worker;
+
+struct worker {
+	int tid;
+	int fd;
+	pthread_t thread;
+	unsigned long ops;
+};
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &nthreads, "Specify amount of threads"),
+	OPT_UINTEGER('r', "runtime", &nsecs,    "Specify runtime (in seconds)"),
+	OPT_UINTEGER('b', "size",    &size,     "Specify bytes written per sync"),
+	OPT_UINTEGER('m', "max-mb",  &max_mb,   "Specify MB after which a file is rewritten from the start"),
+	OPT_STRING(  'd', "dir",     &dirname,  "path", "Create the files in a new directory below path"),
+	OPT_BOOLEAN( 'D', "fdatasync", &datasync, "Use fdatasync() instead of fsync()"),
+	OPT_BOOLEAN( 's', "silent",  &silent,   "Silent mode: do not display data/details"),
+	OPT_END()
+};
+
+static const char * const bench_fs_fsync_usage[] = {
+	"perf bench fs fsync <options>",
+	NULL
+};
+
+static void *workerfn(void *arg)
+{
+	struct worker *w = (struct worker *) arg;
+	unsigned long ops = w->ops; /* avoid cacheline bouncing */
+	off_t pos = 0, max = (off_t)max_mb << 20;
+	char *buf = malloc(size);
+
+	if (!buf)
+		err(EXIT_FAILURE, "malloc");
+	memset(buf, 0x5a, size);
+
+	pthread_mutex_lock(&thread_lock);
+	threads_starting--;
+	if (!threads_starting)
+		pthread_cond_signal(&thread_parent);
+	pthread_cond_wait(&thread_worker, &thread_lock);
+	pthread_mutex_unlock(&thread_lock);
+
+	do {
+		if (pwrite(w->fd, buf, size, pos) != (ssize_t)size)
+			err(EXIT_FAILURE, "pwrite");
+		if ((datasync ? fdatasync(w->fd) : fsync(w->fd)) < 0)
+			err(EXIT_FAILURE, "fsync");
+		pos += size;
+		if (pos + size > max)
+			pos = 0;
+		ops++;
+	} while (!done);
+
+	w->ops = ops;
+	free(buf);
+	return NULL;
+}
+
+static void toggle_done(int sig __maybe_unused,
+			siginfo_t *info __maybe_unused,
+			void *uc __maybe_unused)
+{
+	/* inform all threads that we're done for the day */
+	done = true;
+	gettimeofday(&end, NULL);
+	timersub(&end, &start, &runtime);
+}
+
+static void print_summary(void)
+{
+	unsigned long avg = avg_stats(&throughput_stats);
+	double stddev = stddev_stats(&throughput_stats);
+
+	printf("%sAveraged %ld %s/sec per thread (+- %.2f%%), %ld in total, total secs = %d\n",
+	       !silent ? "\n" : "", avg, datasync ? "fdatasyncs" : "fsyncs",
+	       rel_stddev_stats(stddev, avg), avg * nthreads,
+	       (int) runtime.tv_sec);
+}
+
+int bench_fs_fsync(int argc, const char **argv)
+{
+	int ret = 0;
+	cpu_set_t cpuset;
+	struct sigaction act;
+	unsigned int i;
+	pthread_attr_t thread_attr;
+	struct worker *worker = NULL;
+	struct cpu_map *cpu;
+	char path[PATH_MAX];
+	int dirfd;
+
+	argc = parse_options(argc, argv, options, bench_fs_fsync_usage, 0);
+	if (argc || !size || (off_t)size > ((off_t)max_mb << 20)) {
+		usage_with_options(bench_fs_fsync_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	cpu = cpu_map__new(NULL);
+	if (!cpu)
+		goto errmem;
+
+	sigfillset(&act.sa_mask);
+	act.sa_sigaction = toggle_done;
+	sigaction(SIGINT, &act, NULL);
+
+	if (!nthreads) /* default to the number of CPUs */
+		nthreads = cpu->nr;
+
+	worker = calloc(nthreads, sizeof(*worker));
+	if (!worker)
+		goto errmem;
+
+	snprintf(path, sizeof(path), "%s/perf-bench-fsync.XXXXXX",
+		 dirname ?: ".");
+	if (!mkdtemp(path))
+		err(EXIT_FAILURE, "mkdtemp");
+	dirfd = open(path, O_RDONLY | O_DIRECTORY);
+	if (dirfd < 0)
+		err(EXIT_FAILURE, "open %s", path);
+
+	printf("Run summary [PID %d]: %d threads writing %d bytes per %s in %s for %d secs.\n\n",
+	       getpid(), nthreads, size, datasync ? "fdatasync" : "fsync",
+	       path, nsecs);
+
+	init_stats(&throughput_stats);
+	pthread_mutex_init(&thread_lock, NULL);
+	pthread_cond_init(&thread_parent, NULL);
+	pthread_cond_init(&thread_worker, NULL);
+
+	threads_starting = nthreads;
+	pthread_attr_init(&thread_attr);
+	for (i = 0; i < nthreads; i++) {
+		char name[32];
+
+		worker[i].tid = i;
+		sprintf(name, "t%d", i);
+		worker[i].fd = openat(dirfd, name, O_CREAT | O_RDWR, 0600);
+		if (worker[i].fd < 0)
+			err(EXIT_FAILURE, "open");
+
+		CPU_ZERO(&cpuset);
+		CPU_SET(cpu->map[i % cpu->nr], &cpuset);
+
+		ret = pthread_attr_setaffinity_np(&thread_attr, sizeof(cpu_set_t), &cpuset);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_attr_setaffinity_np");
+
+		ret = pthread_create(&worker[i].thread, &thread_attr, workerfn,
+				     (void *)(struct worker *) &worker[i]);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_create");
+	}
+	pthread_attr_destroy(&thread_attr);
+
+	pthread_mutex_lock(&thread_lock);
+	while (threads_starting)
+		pthread_cond_wait(&thread_parent, &thread_lock);
+	gettimeofday(&start, NULL);
+	pthread_cond_broadcast(&thread_worker);
+	pthread_mutex_unlock(&thread_lock);
+
+	sleep(nsecs);
+	toggle_done(0, NULL, NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		ret = pthread_join(worker[i].thread, NULL);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_join");
+	}
+
+	/* cleanup & report results */
+	pthread_cond_destroy(&thread_parent);
+	pthread_cond_destroy(&thread_worker);
+	pthread_mutex_destroy(&thread_lock);
+
+	for (i = 0; i < nthreads; i++) {
+		unsigned long t = worker[i].ops / runtime.tv_sec;
+		char name[32];
+
+		update_stats(&throughput_stats, t);
+		if (!silent)
+			printf("[thread %2d] [ %ld %s/sec ]\n", worker[i].tid, t,
+			       datasync ? "fdatasyncs" : "fsyncs");
+
+		close(worker[i].fd);
+		sprintf(name, "t%d", i);
+		unlinkat(dirfd, name, 0);
+	}
+	close(dirfd);
+	if (rmdir(path))
+		warn("rmdir %s", path);
+
+	print_summary();
+
+	free(worker);
+	free(cpu);
+	return ret;
+errmem:
+	err(EXIT_FAILURE, "calloc");
+}
@@ -18,6 +18,7 @@
 #include <stdlib.h>
 #include <linux/compiler.h>
 #include <linux/kernel.h>
+#include <sys/prctl.h>
 #include <sys/time.h>
 
 #include "../util/stat.h"
@@ -32,6 +33,8 @@ static unsigned int nthreads = 0;
 static unsigned int nsecs    = 10;
 /* amount of futexes per thread */
 static unsigned int nfutexes = 1024;
+/* buckets of the process private futex hash, 0 for the global one */
+static unsigned int nslots   = 0;
 static bool fshared = false, done = false, silent = false;
 static int futex_flag = 0;
 
@@ -54,6 +57,7 @@ static const struct option options[] = {
 	OPT_UINTEGER('f', "futexes", &nfutexes, "Specify amount of futexes per threads"),
 	OPT_BOOLEAN( 's', "silent",  &silent,   "Silent mode: do not display data/details"),
 	OPT_BOOLEAN( 'S', "shared",  &fshared,  "Use shared futexes instead of private ones"),
+	OPT_UINTEGER('b', "buckets", &nslots,   "Use a process private futex hash with this many buckets"),
 	OPT_END()
 };
 
@@ -149,8 +153,20 @@ int bench_futex_hash(int argc, const char **argv)
 	if (!fshared)
 		futex_flag = FUTEX_PRIVATE_FLAG;
 
-	printf("Run summary [PID %d]: %d threads, each operating on %d [%s] futexes for %d secs.\n\n",
+	/* must happen before any worker is created */
+	if (nslots) {
+		if (fshared)
+			errx(EXIT_FAILURE, "--buckets only applies to private futexes");
+		if (prctl(PR_FUTEX_HASH, PR_FUTEX_HASH_SET_SLOTS, nslots, 0, 0))
+			err(EXIT_FAILURE, "prctl(PR_FUTEX_HASH)");
+		nslots = prctl(PR_FUTEX_HASH, PR_FUTEX_HASH_GET_SLOTS, 0, 0, 0);
+	}
+
+	printf("Run summary [PID %d]: %d threads, each operating on %d [%s] futexes for %d secs.\n",
 	       getpid(), nthreads, nfutexes, fshared ? "shared":"private", nsecs);
+	if (nslots)
+		printf("Using a private futex hash with %d buckets.\n", nslots);
+	printf("\n");
 
 	init_stats(&throughput_stats);
 	pthread_mutex_init(&thread_lock, NULL);
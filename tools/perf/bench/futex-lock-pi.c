@@ -12,6 +12,7 @@
 #include <subcmd/parse-options.h>
 #include <linux/compiler.h>
 #include <linux/kernel.h>
+#include <linux/time64.h>
 #include <errno.h>
 #include "bench.h"
 #include "futex.h"
@@ -20,6 +21,7 @@
 #include <err.h>
 #include <stdlib.h>
 #include <sys/time.h>
+#include <time.h>
 
 struct worker {
 	int tid;
@@ -31,6 +33,8 @@ struct worker {
 static u_int32_t global_futex = 0;
 static struct worker *worker;
 static unsigned int nsecs = 10;
+/* usecs to busy-wait with the lock held, 0 to sleep instead */
+static unsigned int nhold = 0;
 static bool silent = false, multi = false;
 static bool done = false, fshared = false;
 static unsigned int nthreads = 0;
@@ -45,6 +49,7 @@ static const struct option options[] = {
 	OPT_UINTEGER('t', "threads",  &nthreads, "Specify amount of threads"),
 	OPT_UINTEGER('r', "runtime", &nsecs,     "Specify runtime (in seconds)"),
 	OPT_BOOLEAN( 'M', "multi",   &multi,     "Use multiple futexes"),
+	OPT_UINTEGER('H', "hold",    &nhold,     "Busy-wait this many usecs with the lock held instead of sleeping"),
 	OPT_BOOLEAN( 's', "silent",  &silent,    "Silent mode: do not display data/details"),
 	OPT_BOOLEAN( 'S', "shared",  &fshared,   "Use shared futexes instead of private ones"),
 	OPT_END()
@@ -75,6 +80,25 @@ static void toggle_done(int sig __maybe_unused,
 	timersub(&end, &start, &runtime);
 }
 
+/*
+ * Keep the CPU busy for the critical section, so that the lock owner stays
+ * on the CPU and waiters get a chance to spin on it.
+ */
+static void busy_wait(unsigned int usecs)
+{
+	struct timespec now, stop;
+
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+	stop.tv_nsec += usecs * NSEC_PER_USEC;
+	stop.tv_sec += stop.tv_nsec / NSEC_PER_SEC;
+	stop.tv_nsec %= NSEC_PER_SEC;
+
+	do {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	} while (now.tv_sec < stop.tv_sec ||
+		 (now.tv_sec == stop.tv_sec && now.tv_nsec < stop.tv_nsec));
+}
+
 static void *workerfn(void *arg)
 {
 	struct worker *w = (struct worker *) arg;
@@ -102,7 +126,10 @@ static void *workerfn(void *arg)
 			goto again;
 		}
 
-		usleep(1);
+		if (nhold)
+			busy_wait(nhold);
+		else
+			usleep(1);
 		ret = futex_unlock_pi(w->futex, futex_flag);
 		if (ret && !silent)
 			warn("thread %d: Could not unlock pi-lock for %p (%d)",
@@ -0,0 +1,261 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * futex-wait-multiple: Measure the cost of FUTEX_WAIT_MULTIPLE setup.
+ *
+ * Every thread keeps calling FUTEX_WAIT_MULTIPLE on its own set of futexes,
+ * where all but the last one hold the expected value. The kernel thus has
+ * to look up, lock and queue every futex of the set before finding the
+ * mismatch and unqueueing them again, without ever blocking. This is the
+ * overhead an event loop pays per call on top of the actual sleep.
+ */
+
+/* For the CLR_() macros */
+#include <string.h>
+#include <pthread.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <linux/compiler.h>
+#include <linux/kernel.h>
+#include <sys/time.h>
+
+#include "../util/stat.h"
+#include <subcmd/parse-options.h>
+#include "bench.h"
+#include "futex.h"
+#include "cpumap.h"
+
+#include <err.h>
+
+static unsigned int nthreads = 0;
+static unsigned int nsecs    = 10;
+/* amount of futexes waited on per call */
+static unsigned int nfutexes = 16;
+/* futex width in bits */
+static unsigned int nbits    = 32;
+static bool fshared = false, done = false, silent = false;
+static int futex_flag = 0;
+
+struct timeval start, end, runtime;
+static pthread_mutex_t thread_lock;
+static unsigned int threads_starting;
+static struct stats throughput_stats;
+static pthread_cond_t thread_parent, thread_worker;
+
+struct worker {
+	int tid;
+	u_int64_t *futex;
+	struct futex_wait_block *wb;
+	pthread_t thread;
+	unsigned long ops;
+};
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &nthreads, "Specify amount of threads"),
+	OPT_UINTEGER('r', "runtime", &nsecs,    "Specify runtime (in seconds)"),
+	OPT_UINTEGER('f', "futexes", &nfutexes, "Specify amount of futexes per call"),
+	OPT_UINTEGER('b', "bits",    &nbits,    "Specify futex width: 8, 16, 32 or 64 bits"),
+	OPT_BOOLEAN( 's', "silent",  &silent,   "Silent mode: do not display data/details"),
+	OPT_BOOLEAN( 'S', "shared",  &fshared,  "Use shared futexes instead of private ones"),
+	OPT_END()
+};
+
+static const char * const bench_futex_wait_multiple_usage[] = {
+	"perf bench futex wait-multiple <options>",
+	NULL
+};
+
+static void setup_worker(struct worker *w, unsigned int size_flag)
+{
+	unsigned int i, size = 1 << size_flag;
+
+	/* futexes are packed, so narrow ones share 32 bit words */
+	w->futex = calloc(nfutexes, sizeof(u_int64_t));
+	w->wb = calloc(nfutexes, sizeof(*w->wb));
+	if (!w->futex || !w->wb)
+		err(EXIT_FAILURE, "calloc");
+
+	for (i = 0; i < nfutexes; i++) {
+		w->wb[i].uaddr = (unsigned long)((char *)w->futex + i * size);
+		w->wb[i].flags = size_flag;
+		w->wb[i].val = 0;
+	}
+	/* the last one never matches, so the call never blocks */
+	w->wb[nfutexes - 1].val = 1;
+}
+
+static void *workerfn(void *arg)
+{
+	int ret;
+	struct worker *w = (struct worker *) arg;
+	unsigned long ops = w->ops; /* avoid cacheline bouncing */
+
+	pthread_mutex_lock(&thread_lock);
+	threads_starting--;
+	if (!threads_starting)
+		pthread_cond_signal(&thread_parent);
+	pthread_cond_wait(&thread_worker, &thread_lock);
+	pthread_mutex_unlock(&thread_lock);
+
+	do {
+		ret = futex_wait_multiple(w->wb, nfutexes, NULL, futex_flag);
+		if (ret >= 0 || errno != EWOULDBLOCK) {
+			if (!silent)
+				warn("Non-expected futex return call");
+			if (errno == ENOSYS || errno == EINVAL)
+				break;
+		}
+		ops++;
+	} while (!done);
+
+	w->ops = ops;
+	return NULL;
+}
+
+static void toggle_done(int sig __maybe_unused,
+			siginfo_t *info __maybe_unused,
+			void *uc __maybe_unused)
+{
+	/* inform all threads that we're done for the day */
+	done = true;
+	gettimeofday(&end, NULL);
+	timersub(&end, &start, &runtime);
+}
+
+static void print_summary(void)
+{
+	unsigned long avg = avg_stats(&throughput_stats);
+	double stddev = stddev_stats(&throughput_stats);
+
+	printf("%sAveraged %ld operations/sec (+- %.2f%%), total secs = %d\n",
+	       !silent ? "\n" : "", avg, rel_stddev_stats(stddev, avg),
+	       (int) runtime.tv_sec);
+}
+
+int bench_futex_wait_multiple(int argc, const char **argv)
+{
+	int ret = 0;
+	cpu_set_t cpuset;
+	struct sigaction act;
+	unsigned int i, size_flag;
+	pthread_attr_t thread_attr;
+	struct worker *worker = NULL;
+	struct cpu_map *cpu;
+
+	argc = parse_options(argc, argv, options, bench_futex_wait_multiple_usage, 0);
+	if (argc) {
+		usage_with_options(bench_futex_wait_multiple_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	switch (nbits) {
+	case 8:
+		size_flag = FUTEX_WAIT_SIZE_U8;
+		break;
+	case 16:
+		size_flag = FUTEX_WAIT_SIZE_U16;
+		break;
+	case 32:
+		size_flag = FUTEX_WAIT_SIZE_U32;
+		break;
+	case 64:
+		size_flag = FUTEX_WAIT_SIZE_U64;
+		break;
+	default:
+		errx(EXIT_FAILURE, "futexes can be 8, 16, 32 or 64 bits wide");
+	}
+
+	if (!nfutexes || nfutexes > FUTEX_WAIT_MULTIPLE_MAX)
+		errx(EXIT_FAILURE, "between 1 and %d futexes can be waited on",
+		     FUTEX_WAIT_MULTIPLE_MAX);
+
+	cpu = cpu_map__new(NULL);
+	if (!cpu)
+		goto errmem;
+
+	sigfillset(&act.sa_mask);
+	act.sa_sigaction = toggle_done;
+	sigaction(SIGINT, &act, NULL);
+
+	if (!nthreads) /* default to the number of CPUs */
+		nthreads = cpu->nr;
+
+	worker = calloc(nthreads, sizeof(*worker));
+	if (!worker)
+		goto errmem;
+
+	if (!fshared)
+		futex_flag = FUTEX_PRIVATE_FLAG;
+
+	printf("Run summary [PID %d]: %d threads, each waiting on %d %d-bit [%s] futexes for %d secs.\n\n",
+	       getpid(), nthreads, nfutexes, nbits, fshared ? "shared":"private", nsecs);
+
+	init_stats(&throughput_stats);
+	pthread_mutex_init(&thread_lock, NULL);
+	pthread_cond_init(&thread_parent, NULL);
+	pthread_cond_init(&thread_worker, NULL);
+
+	threads_starting = nthreads;
+	pthread_attr_init(&thread_attr);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < nthreads; i++) {
+		worker[i].tid = i;
+		setup_worker(&worker[i], size_flag);
+
+		CPU_ZERO(&cpuset);
+		CPU_SET(cpu->map[i % cpu->nr], &cpuset);
+
+		ret = pthread_attr_setaffinity_np(&thread_attr, sizeof(cpu_set_t), &cpuset);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_attr_setaffinity_np");
+
+		ret = pthread_create(&worker[i].thread, &thread_attr, workerfn,
+				     (void *)(struct worker *) &worker[i]);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_create");
+	}
+	pthread_attr_destroy(&thread_attr);
+
+	pthread_mutex_lock(&thread_lock);
+	while (threads_starting)
+		pthread_cond_wait(&thread_parent, &thread_lock);
+	pthread_cond_broadcast(&thread_worker);
+	pthread_mutex_unlock(&thread_lock);
+
+	sleep(nsecs);
+	toggle_done(0, NULL, NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		ret = pthread_join(worker[i].thread, NULL);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_join");
+	}
+
+	/* cleanup & report results */
+	pthread_cond_destroy(&thread_parent);
+	pthread_cond_destroy(&thread_worker);
+	pthread_mutex_destroy(&thread_lock);
+
+	for (i = 0; i < nthreads; i++) {
+		unsigned long t = worker[i].ops/runtime.tv_sec;
+
+		update_stats(&throughput_stats, t);
+		if (!silent)
+			printf("[thread %2d] futexes: %p ... %p [ %ld ops/sec ]\n",
+			       worker[i].tid, worker[i].futex,
+			       (char *)worker[i].futex + (nfutexes - 1) * (nbits / 8), t);
+
+		free(worker[i].futex);
+		free(worker[i].wb);
+	}
+
+	print_summary();
+
+	free(worker);
+	free(cpu);
+	return ret;
+errmem:
+	err(EXIT_FAILURE, "calloc");
+}
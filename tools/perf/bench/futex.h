@@ -13,6 +13,31 @@
 #include <sys/types.h>
 #include <linux/futex.h>
 
+#ifndef FUTEX_WAIT_MULTIPLE
+#define FUTEX_WAIT_MULTIPLE	13
+
+struct futex_wait_block {
+	__u64 uaddr;
+	__u64 val;
+	__u32 flags;
+	__u32 __reserved;
+};
+
+#define FUTEX_WAIT_SIZE_U8	0x00
+#define FUTEX_WAIT_SIZE_U16	0x01
+#define FUTEX_WAIT_SIZE_U32	0x02
+#define FUTEX_WAIT_SIZE_U64	0x03
+#define FUTEX_WAIT_SIZE_MASK	0x03
+
+#define FUTEX_WAIT_MULTIPLE_MAX	128
+#endif
+
+#ifndef PR_FUTEX_HASH
+#define PR_FUTEX_HASH			54
+# define PR_FUTEX_HASH_SET_SLOTS	1
+# define PR_FUTEX_HASH_GET_SLOTS	2
+#endif
+
 /**
  * futex() - SYS_futex syscall wrapper
  * @uaddr:	address of first futex
@@ -87,6 +112,21 @@ futex_cmp_requeue(u_int32_t *uaddr, u_int32_t val, u_int32_t *uaddr2, int nr_wak
 		 val, opflags);
 }
 
+/**
+ * futex_wait_multiple() - block on several futexes at once
+ * @wb:		array of futexes and their expected values
+ * @count:	number of entries in wb
+ * @timeout:	relative timeout
+ *
+ * Returns the index of the futex that was woken up.
+ */
+static inline int
+futex_wait_multiple(struct futex_wait_block *wb, unsigned int count,
+		    struct timespec *timeout, int opflags)
+{
+	return futex(wb, FUTEX_WAIT_MULTIPLE, count, timeout, NULL, 0, opflags);
+}
+
 #ifndef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
 #include <pthread.h>
 #include <linux/compiler.h>
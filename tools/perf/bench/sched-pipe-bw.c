@@ -0,0 +1,195 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ *
+ * sched-pipe-bw.c
+ *
+ * pipe-bw: Benchmark for pipe() bandwidth
+ *
+ * Unlike sched-pipe, which bounces a single int back and forth to measure
+ * wakeup latency, this streams a large amount of data through one pipe in
+ * one direction, the way 'producer | consumer' shell pipelines do.
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include <subcmd/parse-options.h>
+#include "../builtin.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <linux/time64.h>
+
+#include <pthread.h>
+
+#define SIZE_DEFAULT	(64 * 1024)
+#define TOTAL_DEFAULT	(4 * 1024)
+
+/* bytes per read()/write() */
+static	unsigned int		size = SIZE_DEFAULT;
+/* MB to transfer */
+static	unsigned int		total = TOTAL_DEFAULT;
+/* F_SETPIPE_SZ, 0 to keep the default (and let the kernel grow it) */
+static	unsigned int		pipe_size;
+
+/* Use processes by default: */
+static bool			threaded;
+static bool			use_vmsplice;
+
+static const struct option options[] = {
+	OPT_UINTEGER('s', "size",	&size,		"Specify bytes per read/write"),
+	OPT_UINTEGER('t', "total",	&total,		"Specify MB to transfer"),
+	OPT_UINTEGER('p', "pipe-size",	&pipe_size,	"Set the pipe size with F_SETPIPE_SZ"),
+	OPT_BOOLEAN('v', "vmsplice",	&use_vmsplice,	"Write with vmsplice() instead of write()"),
+	OPT_BOOLEAN('T', "threaded",	&threaded,	"Specify threads/process based task setup"),
+	OPT_END()
+};
+
+static const char * const bench_sched_pipe_bw_usage[] = {
+	"perf bench sched pipe-bw <options>",
+	NULL
+};
+
+static int pipe_fds[2];
+
+static void *writer_thread(void *arg __maybe_unused)
+{
+	unsigned long long left = (unsigned long long)total << 20;
+	char *buf = malloc(size);
+	ssize_t ret;
+
+	BUG_ON(!buf);
+	memset(buf, 0x5a, size);
+
+	while (left) {
+		size_t len = left < size ? left : size;
+
+		if (use_vmsplice) {
+			struct iovec iov = {
+				.iov_base	= buf,
+				.iov_len	= len,
+			};
+
+			/* the contents never change, so buf can be reused */
+			ret = vmsplice(pipe_fds[1], &iov, 1, 0);
+		} else {
+			ret = write(pipe_fds[1], buf, len);
+		}
+		BUG_ON(ret <= 0);
+		left -= ret;
+	}
+
+	close(pipe_fds[1]);
+	free(buf);
+	return NULL;
+}
+
+static void *reader_thread(void *arg __maybe_unused)
+{
+	char *buf = malloc(size);
+	ssize_t ret;
+
+	BUG_ON(!buf);
+
+	do {
+		ret = read(pipe_fds[0], buf, size);
+		BUG_ON(ret < 0);
+	} while (ret);
+
+	free(buf);
+	return NULL;
+}
+
+int bench_sched_pipe_bw(int argc, const char **argv)
+{
+	struct timeval start, stop, diff;
+	unsigned long long result_usec;
+	pthread_t reader, writer;
+	double mb_per_sec;
+	int __maybe_unused ret, wait_stat;
+	pid_t pid, retpid __maybe_unused;
+
+	argc = parse_options(argc, argv, options, bench_sched_pipe_bw_usage, 0);
+	if (!size || !total) {
+		usage_with_options(bench_sched_pipe_bw_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	BUG_ON(pipe(pipe_fds));
+	if (pipe_size && fcntl(pipe_fds[1], F_SETPIPE_SZ, pipe_size) < 0) {
+		fprintf(stderr, "F_SETPIPE_SZ: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	gettimeofday(&start, NULL);
+
+	if (threaded) {
+		ret = pthread_create(&reader, NULL, reader_thread, NULL);
+		BUG_ON(ret);
+		ret = pthread_create(&writer, NULL, writer_thread, NULL);
+		BUG_ON(ret);
+
+		ret = pthread_join(writer, NULL);
+		BUG_ON(ret);
+		ret = pthread_join(reader, NULL);
+		BUG_ON(ret);
+	} else {
+		pid = fork();
+		assert(pid >= 0);
+
+		if (!pid) {
+			close(pipe_fds[0]);
+			writer_thread(NULL);
+			exit(0);
+		} else {
+			close(pipe_fds[1]);
+			reader_thread(NULL);
+		}
+
+		retpid = waitpid(pid, &wait_stat, 0);
+		assert((retpid == pid) && WIFEXITED(wait_stat));
+	}
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+	close(pipe_fds[0]);
+
+	result_usec = diff.tv_sec * USEC_PER_SEC;
+	result_usec += diff.tv_usec;
+	mb_per_sec = (double)total / ((double)result_usec / (double)USEC_PER_SEC);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# Transferred %u MB in %u byte chunks between two %s using %s\n\n",
+		       total, size, threaded ? "threads" : "processes",
+		       use_vmsplice ? "vmsplice()" : "write()");
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec / USEC_PER_MSEC));
+
+		printf(" %14lf MB/sec\n", mb_per_sec);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf\n", mb_per_sec);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
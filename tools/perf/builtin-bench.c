@@ -14,6 +14,8 @@
  *  mem   ... memory access performance
  *  numa  ... NUMA scheduling and MM performance
  *  futex ... Futex performance
+ *  epoll ... Event poll performance
+ *  fs    ... Filesystem metadata performance
  */
 #include "perf.h"
 #include "util/util.h"
@@ -45,6 +47,7 @@ static struct bench numa_benchmarks[] = {
 static struct bench sched_benchmarks[] = {
 	{ "messaging",	"Benchmark for scheduling and IPC",		bench_sched_messaging	},
 	{ "pipe",	"Benchmark for pipe() between two processes",	bench_sched_pipe	},
+	{ "pipe-bw",	"Benchmark for pipe() bandwidth",		bench_sched_pipe_bw	},
 	{ "all",	"Run all scheduler benchmarks",		NULL			},
 	{ NULL,		NULL,						NULL			}
 };
@@ -61,12 +64,27 @@ static struct bench futex_benchmarks[] = {
 	{ "wake",	"Benchmark for futex wake calls",               bench_futex_wake	},
 	{ "wake-parallel", "Benchmark for parallel futex wake calls",   bench_futex_wake_parallel },
 	{ "requeue",	"Benchmark for futex requeue calls",            bench_futex_requeue	},
+	{ "wait-multiple", "Benchmark for futex wait on multiple futexes", bench_futex_wait_multiple },
 	/* pi-futexes */
 	{ "lock-pi",	"Benchmark for futex lock_pi calls",            bench_futex_lock_pi	},
 	{ "all",	"Run all futex benchmarks",			NULL			},
 	{ NULL,		NULL,						NULL			}
 };
 
+static struct bench epoll_benchmarks[] = {
+	{ "wait",	"Benchmark epoll concurrent epoll_waits",	bench_epoll_wait	},
+	{ "ctl",	"Benchmark epoll concurrent epoll_ctls",	bench_epoll_ctl		},
+	{ "all",	"Run all epoll benchmarks",			NULL			},
+	{ NULL,		NULL,						NULL			}
+};
+
+static struct bench fs_benchmarks[] = {
+	{ "dirops",	"Benchmark for parallel create/unlink in one directory", bench_fs_dirops },
+	{ "fsync",	"Benchmark for concurrent write+fsync rate",	bench_fs_fsync		},
+	{ "all",	"Run all filesystem benchmarks",		NULL			},
+	{ NULL,		NULL,						NULL			}
+};
+
 struct collection {
 	const char	*name;
 	const char	*summary;
@@ -80,6 +98,8 @@ static struct collection collections[] = {
 	{ "numa",	"NUMA scheduling and MM benchmarks",		numa_benchmarks		},
 #endif
 	{"futex",       "Futex stressing benchmarks",                   futex_benchmarks        },
+	{ "epoll",	"Epoll stressing benchmarks",			epoll_benchmarks	},
+	{ "fs",		"Filesystem metadata benchmarks",		fs_benchmarks		},
 	{ "all",	"All benchmarks",				NULL			},
 	{ NULL,		NULL,						NULL			}
 };
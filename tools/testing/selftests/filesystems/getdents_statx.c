@@ -0,0 +1,193 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Walk a directory tree twice, once with getdents64() + fstatat() per entry
+ * and once with getdents_statx(), check that both saw the same entries with
+ * the same attributes and report how long each walk took.
+ *
+ * Usage: getdents_statx [directory]
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/stat.h>
+
+#include "../kselftest.h"
+
+#ifndef __NR_getdents_statx
+#define __NR_getdents_statx	-1
+#endif
+
+#define BUF_SIZE	(64 * 1024)
+
+struct linux_dirent64 {
+	uint64_t	d_ino;
+	int64_t		d_off;
+	unsigned short	d_reclen;
+	unsigned char	d_type;
+	char		d_name[];
+};
+
+struct walk_stats {
+	unsigned long	entries;
+	unsigned long	errors;
+	/* cheap fingerprint of everything seen, to compare the walks */
+	uint64_t	sum;
+};
+
+static int getdents_statx(int fd, void *buf, unsigned int count,
+			  unsigned int flags, unsigned int mask)
+{
+	return syscall(__NR_getdents_statx, fd, buf, count, flags, mask);
+}
+
+static int is_dot(const char *name)
+{
+	return !strcmp(name, ".") || !strcmp(name, "..");
+}
+
+static void account(struct walk_stats *ws, uint64_t ino, uint64_t size,
+		    unsigned int mode)
+{
+	ws->entries++;
+	ws->sum += ino * 31 + size * 7 + mode;
+}
+
+static int walk_legacy(int dirfd, struct walk_stats *ws)
+{
+	char *buf = malloc(BUF_SIZE);
+	int n;
+
+	if (!buf)
+		ksft_exit_fail_msg("malloc: %s\n", strerror(errno));
+
+	while ((n = syscall(SYS_getdents64, dirfd, buf, BUF_SIZE)) > 0) {
+		int pos;
+
+		for (pos = 0; pos < n; ) {
+			struct linux_dirent64 *d = (void *)(buf + pos);
+			struct stat st;
+
+			pos += d->d_reclen;
+			if (is_dot(d->d_name))
+				continue;
+			if (fstatat(dirfd, d->d_name, &st,
+				    AT_SYMLINK_NOFOLLOW) < 0) {
+				ws->errors++;
+				continue;
+			}
+			account(ws, st.st_ino, st.st_size, st.st_mode);
+			if (S_ISDIR(st.st_mode)) {
+				int fd = openat(dirfd, d->d_name,
+						O_RDONLY | O_DIRECTORY);
+
+				if (fd >= 0) {
+					walk_legacy(fd, ws);
+					close(fd);
+				}
+			}
+		}
+	}
+	free(buf);
+	return n;
+}
+
+static int walk_statx(int dirfd, struct walk_stats *ws)
+{
+	char *buf = malloc(BUF_SIZE);
+	int n;
+
+	if (!buf)
+		ksft_exit_fail_msg("malloc: %s\n", strerror(errno));
+
+	while ((n = getdents_statx(dirfd, buf, BUF_SIZE, 0,
+				   STATX_BASIC_STATS)) > 0) {
+		int pos;
+
+		for (pos = 0; pos < n; ) {
+			struct dirent_statx *d = (void *)(buf + pos);
+
+			pos += d->d_reclen;
+			if (is_dot(d->d_name))
+				continue;
+			if (d->d_stx_err) {
+				ws->errors++;
+				continue;
+			}
+			account(ws, d->d_stx.stx_ino, d->d_stx.stx_size,
+				d->d_stx.stx_mode);
+			if (S_ISDIR(d->d_stx.stx_mode)) {
+				int fd = openat(dirfd, d->d_name,
+						O_RDONLY | O_DIRECTORY);
+
+				if (fd >= 0) {
+					walk_statx(fd, ws);
+					close(fd);
+				}
+			}
+		}
+	}
+	free(buf);
+	return n;
+}
+
+static double walk(const char *path, int (*fn)(int, struct walk_stats *),
+		   struct walk_stats *ws)
+{
+	struct timespec start, end;
+	int fd, ret;
+
+	fd = open(path, O_RDONLY | O_DIRECTORY);
+	if (fd < 0)
+		ksft_exit_fail_msg("open %s: %s\n", path, strerror(errno));
+
+	memset(ws, 0, sizeof(*ws));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	ret = fn(fd, ws);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	close(fd);
+
+	if (ret < 0) {
+		if (errno == ENOSYS)
+			ksft_exit_skip("getdents_statx() not supported\n");
+		ksft_exit_fail_msg("walking %s: %s\n", path, strerror(errno));
+	}
+
+	return (end.tv_sec - start.tv_sec) +
+	       (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = argc > 1 ? argv[1] : ".";
+	struct walk_stats legacy, batched;
+	double t_legacy, t_batched;
+
+	/* warm the caches so both walks start from the same state */
+	walk(path, walk_legacy, &legacy);
+
+	t_batched = walk(path, walk_statx, &batched);
+	t_legacy = walk(path, walk_legacy, &legacy);
+
+	ksft_print_msg("getdents64 + fstatat: %lu entries in %.3f s\n",
+		       legacy.entries, t_legacy);
+	ksft_print_msg("getdents_statx:       %lu entries in %.3f s\n",
+		       batched.entries, t_batched);
+
+	if (legacy.errors || batched.errors)
+		ksft_print_msg("%lu/%lu entries could not be stat'ed\n",
+			       legacy.errors, batched.errors);
+
+	if (legacy.entries != batched.entries || legacy.sum != batched.sum)
+		ksft_exit_fail_msg("walks disagree, was %s modified meanwhile?\n",
+				   path);
+
+	ksft_exit_pass();
+}